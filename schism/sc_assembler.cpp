@@ -30,23 +30,31 @@
 //====================================================================================
 
 #include "sc_assembler.hpp"
+#include "sc_compile_cache.hpp"
+
+#include <cstring>
+#include <cstdlib>
 
 #include <fstream>
-#include <sstream>
 #include <iostream>
 
 #include <schism/sc_operations.hpp>
+#include <schism/sc_texture.hpp>
 
-void scAssembledProgram::WriteToFile(const std::string& path) {
+bool scAssembledProgram::WriteToFile(const std::string& path) const {
     std::ofstream file(path, std::ofstream::binary);
 
+    if (!file.is_open())
+        return false;
+
     scMagicType magic = scMagicType::SC_MAGIC_MODULE;
 
-    file.write(reinterpret_cast<char*>(&magic), sizeof(scMagicType));
-    file.write(reinterpret_cast<char*>(&header), sizeof(scModuleHeader));
-    file.write(reinterpret_cast<char*>(binary.data()), binary.size());
+    file.write(reinterpret_cast<const char*>(&magic), sizeof(scMagicType));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(scModuleHeader));
+    file.write(reinterpret_cast<const char*>(binary.data()), binary.size());
 
     file.close();
+    return !file.fail();
 }
 
 scAssembledProgram::scAssembledProgram(const std::vector<uint8_t>& binary, scModuleType type) {
@@ -58,324 +66,867 @@ scAssembledProgram::scAssembledProgram(const std::vector<uint8_t>& binary, scMod
 }
 
 scModule scAssembledProgram::CreateModule() const {
-    return scModule(binary);
+    return scModule(binary, header.type);
 }
 
-scAssemblerState scAssembler::CompileSourceFile(const std::string& path, scAssembledProgram& outProgram) {
-    std::ifstream file(path, std::ifstream::ate);
+bool scAssembler::ReadSourceFile(const std::string& path, std::string& outText) {
+    std::ifstream file(path, std::ifstream::binary | std::ifstream::ate);
+
+    if (!file.is_open())
+        return false;
 
-    std::string text;
     size_t len = file.tellg();
 
-    text.resize(len + 1);
+    // No room for a terminator, a trailing NUL would end up in the last instruction
+    outText.resize(len);
 
     file.seekg(0);
-    file.read(text.data(), len);
+    file.read(outText.data(), len);
+
+    return true;
+}
+
+scAssemblerState scAssembler::CompileSourceFile(const std::string& path, scAssembledProgram& outProgram) {
+    std::string text;
+
+    if (!ReadSourceFile(path, text))
+        return scAssemblerState::FileNotFound;
 
     return CompileSourceText(text, outProgram);
 }
 
-scAssemblerState scAssembler::CompileSourceText(const std::string& text, scAssembledProgram& outProgram) {
-    std::string line;
-    std::stringstream stream(text);
+scAssemblerState scAssembler::CompileSourceFile(const std::string& path, scModule& outModule) {
+    std::string text;
 
-    std::vector<uint8_t> program;
+    if (!ReadSourceFile(path, text))
+        return scAssemblerState::FileNotFound;
 
-    while (std::getline(stream, line)) {
-        // TODO: Trim the line of whitespace
+    return CompileSourceText(text, outModule);
+}
 
-        for (char& ch: line)
-            ch = std::toupper(ch);
+scAssemblerState scAssembler::CompileSourceText(std::string_view text, scAssembledProgram& outProgram) {
+    if (_cache == nullptr)
+        return Assemble(text, outProgram);
 
-        // TODO: Better check for if the line is empty
-        if (line.empty())
-            continue;
+    uint64_t key = scCompileCache::HashSource(text, _optimizerOptions);
+    scModule cached;
 
-        if (line[0] == ';') // Comment
-            continue;
+    if (_cache->Load(key, cached)) {
+        scSpan<const uint8_t> code = cached.GetCode();
 
-        // Read the operation
-        size_t nextSpace = line.find_first_of(' ');
+        outProgram.binary.assign(code.begin(), code.end());
+        outProgram.header = scModuleHeader { cached.GetType(), (uint32_t)code.size() };
 
-        std::string operation = line.substr(0, nextSpace);
+        return scAssemblerState::OK;
+    }
 
-        bool hasArgs = nextSpace != std::string::npos;
-        std::string afterOperation = "";
+    scAssemblerState state = Assemble(text, outProgram);
 
-        if (hasArgs)
-            afterOperation = line.substr(nextSpace + 1);
+    if (state == scAssemblerState::OK)
+        _cache->Store(key, outProgram);
 
-        std::vector<std::string> args;
+    return state;
+}
 
-        while (hasArgs) {
-            nextSpace = afterOperation.find_first_of(' ');
+scAssemblerState scAssembler::CompileSourceText(std::string_view text, scModule& outModule) {
+    uint64_t key = 0;
 
-            if (nextSpace != std::string::npos) {
-                args.push_back(afterOperation.substr(0, nextSpace));
-                afterOperation = afterOperation.substr(nextSpace + 1);
-            } else {
-                break;
-            }
+    if (_cache != nullptr) {
+        key = scCompileCache::HashSource(text, _optimizerOptions);
+
+        if (_cache->Load(key, outModule))
+            return scAssemblerState::OK;
+    }
+
+    scAssembledProgram program;
+    scAssemblerState state = Assemble(text, program);
+
+    if (state != scAssemblerState::OK)
+        return state;
+
+    if (_cache != nullptr)
+        _cache->Store(key, program);
+
+    outModule = program.CreateModule();
+    return scAssemblerState::OK;
+}
+
+// ===========
+//  Mnemonics
+// ===========
+struct scMnemonicEntry {
+    std::string_view name;
+    scMnemonic mnemonic;
+};
+
+// Names are upper case, lookups fold the source to match
+static constexpr scMnemonicEntry MNEMONICS[] = {
+    { "EXIT", scMnemonic::Exit },
+    { "MOV", scMnemonic::Mov },
+    { "ALU_F32_F32", scMnemonic::AluF32F32 },
+    { "SET_F32", scMnemonic::SetF32 },
+    { "LD_F32", scMnemonic::LoadF32 },
+    { "ABS_F32", scMnemonic::AbsF32 },
+    { "SMP_POINT", scMnemonic::SamplePoint },
+    { "SMP_LINEAR", scMnemonic::SampleLinear },
+    { "MAT_MUL_VEC", scMnemonic::MatMulVec },
+    { "MAT_MUL_MAT", scMnemonic::MatMulMat },
+    { "MAT_TRANSPOSE", scMnemonic::MatTranspose },
+    { "VEC_DOT3", scMnemonic::VecDot3 },
+    { "VEC_DOT4", scMnemonic::VecDot4 },
+    { "VEC_CROSS", scMnemonic::VecCross },
+    { "CMP_F32", scMnemonic::CmpF32 },
+    { "SEL_F32", scMnemonic::SelectF32 },
+    { "JMP", scMnemonic::Jump },
+    { "BRZ", scMnemonic::BranchZero },
+    { "BRNZ", scMnemonic::BranchNotZero },
+    { "LOOP", scMnemonic::Loop },
+    { "DISCARD", scMnemonic::Discard },
+    { "DISCARD_NZ", scMnemonic::DiscardNotZero },
+};
+
+static constexpr int MNEMONIC_COUNT = sizeof(MNEMONICS) / sizeof(MNEMONICS[0]);
+
+// Kept at most a quarter full so nearly every lookup lands on the right slot first
+static constexpr int MNEMONIC_TABLE_SIZE = 128;
+static_assert(MNEMONIC_COUNT * 4 <= MNEMONIC_TABLE_SIZE, "The mnemonic table is too full");
+
+static constexpr char ToUpper(char ch) {
+    return ch >= 'a' && ch <= 'z' ? (char)(ch - 'a' + 'A') : ch;
+}
+
+static constexpr bool EqualsUpper(std::string_view str, std::string_view upper) {
+    if (str.size() != upper.size())
+        return false;
+
+    for (size_t c = 0; c < str.size(); c++) {
+        if (ToUpper(str[c]) != upper[c])
+            return false;
+    }
+
+    return true;
+}
+
+// FNV-1a over the upper case name
+static constexpr uint32_t HashMnemonic(std::string_view name) {
+    uint32_t hash = 2166136261u;
+
+    for (char ch : name)
+        hash = (hash ^ (uint8_t)ToUpper(ch)) * 16777619u;
+
+    return hash;
+}
+
+// Each slot holds an index into MNEMONICS plus one, zero marks an empty slot
+static constexpr std::array<uint8_t, MNEMONIC_TABLE_SIZE> BuildMnemonicTable() {
+    std::array<uint8_t, MNEMONIC_TABLE_SIZE> table {};
+
+    for (int m = 0; m < MNEMONIC_COUNT; m++) {
+        uint32_t slot = HashMnemonic(MNEMONICS[m].name) % MNEMONIC_TABLE_SIZE;
+
+        while (table[slot] != 0)
+            slot = (slot + 1) % MNEMONIC_TABLE_SIZE;
+
+        table[slot] = (uint8_t)(m + 1);
+    }
+
+    return table;
+}
+
+static constexpr std::array<uint8_t, MNEMONIC_TABLE_SIZE> MNEMONIC_TABLE = BuildMnemonicTable();
+
+scMnemonic scFindMnemonic(std::string_view name) {
+    uint32_t slot = HashMnemonic(name) % MNEMONIC_TABLE_SIZE;
+
+    while (MNEMONIC_TABLE[slot] != 0) {
+        const scMnemonicEntry& entry = MNEMONICS[MNEMONIC_TABLE[slot] - 1];
+
+        if (EqualsUpper(name, entry.name))
+            return entry.mnemonic;
+
+        slot = (slot + 1) % MNEMONIC_TABLE_SIZE;
+    }
+
+    return scMnemonic::UNKNOWN;
+}
+
+// ============
+//  Assembling
+// ============
+static bool IsSpace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\v' || ch == '\f';
+}
+
+bool scAssembler::TokenizeLine(std::string_view line, scSourceLine& outLine) {
+    outLine.operandCount = 0;
+
+    size_t cur = 0;
+    bool first = true;
+
+    while (cur < line.size()) {
+        while (cur < line.size() && IsSpace(line[cur]))
+            cur++;
+
+        size_t begin = cur;
+
+        while (cur < line.size() && !IsSpace(line[cur]))
+            cur++;
+
+        if (begin == cur)
+            break;
+
+        std::string_view token = line.substr(begin, cur - begin);
+
+        if (first) {
+            // Comment
+            if (token[0] == ';')
+                return false;
+
+            outLine.operation = token;
+            first = false;
+        } else if (outLine.operandCount < SC_ASSEMBLER_MAX_OPERANDS) {
+            outLine.operands[outLine.operandCount++] = token;
         }
+    }
 
-        // Check if there is still string remaining
-        if (hasArgs && !afterOperation.empty())
-            args.push_back(afterOperation);
+    return !first;
+}
 
-        scAssemblerState state = scAssemblerState::UnknownInstruction;
+scAssemblerState scAssembler::Assemble(std::string_view text, scAssembledProgram& outProgram) {
+    std::vector<uint8_t> program;
 
-        state = AssembleGroupZero(program, operation, args);
+    // No instruction encodes to more bytes than it takes characters to write
+    program.reserve(text.size());
 
-        if (state == scAssemblerState::UnknownInstruction) {
-            std::cout << "[scAssembler]: Unknown group zero instruction (" << operation << ")" << std::endl;
-            return state;
+    size_t cur = 0;
+    scSourceLine line;
+
+    scModuleType type = scModuleType::Fragment;
+
+    std::vector<scLabelReference> labels;
+    std::vector<scLabelReference> targets;
+
+    while (cur < text.size()) {
+        size_t end = text.find('\n', cur);
+
+        if (end == std::string_view::npos)
+            end = text.size();
+
+        std::string_view source = text.substr(cur, end - cur);
+        cur = end + 1;
+
+        if (!TokenizeLine(source, line))
+            continue;
+
+        // Directives start with a period and don't emit anything
+        if (line.operation[0] == '.') {
+            if (EqualsUpper(line.operation, ".VERTEX")) {
+                type = scModuleType::Vertex;
+            } else if (EqualsUpper(line.operation, ".FRAGMENT")) {
+                type = scModuleType::Fragment;
+            } else {
+                std::cout << "[scAssembler]: Unknown directive (" << line.operation << ")" << std::endl;
+                return scAssemblerState::UnknownInstruction;
+            }
+
+            continue;
         }
 
-        if (state != scAssemblerState::OK)
-            state = AssembleGroupOne(program, operation, args);
+        // Labels end in a colon and stand for the offset of the next instruction
+        if (line.operation.back() == ':' && line.operandCount == 0) {
+            std::string_view name = line.operation.substr(0, line.operation.size() - 1);
 
-        if (state == scAssemblerState::UnknownInstruction) {
-            std::cout << "[scAssembler]: Unknown group one instruction (" << operation << ")" << std::endl;
-            return state;
+            for (const scLabelReference& label : labels) {
+                if (label.name == name) {
+                    std::cout << "[scAssembler]: Label defined twice (" << name << ")" << std::endl;
+                    return scAssemblerState::UnknownLabel;
+                }
+            }
+
+            labels.push_back({ name, (uint32_t)program.size() });
+            continue;
         }
 
-        if (state != scAssemblerState::OK)
-            state = AssembleGroupTwo(program, operation, args);
+        scMnemonic mnemonic = scFindMnemonic(line.operation);
+        scAssemblerState state;
 
-        if (state == scAssemblerState::UnknownInstruction) {
-            std::cout << "[scAssembler]: Unknown group two instruction (" << operation << ")" << std::endl;
-            return state;
+        switch (mnemonic) {
+            case scMnemonic::Exit:
+            case scMnemonic::Discard:
+                state = AssembleGroupZero(program, mnemonic);
+                break;
+
+            case scMnemonic::Mov:
+            case scMnemonic::AluF32F32:
+                state = AssembleGroupOne(program, mnemonic, line);
+                break;
+
+            case scMnemonic::SetF32:
+            case scMnemonic::LoadF32:
+            case scMnemonic::AbsF32:
+            case scMnemonic::SamplePoint:
+            case scMnemonic::SampleLinear:
+                state = AssembleGroupTwo(program, mnemonic, line);
+                break;
+
+            case scMnemonic::MatMulVec:
+            case scMnemonic::MatMulMat:
+            case scMnemonic::MatTranspose:
+            case scMnemonic::VecDot3:
+            case scMnemonic::VecDot4:
+            case scMnemonic::VecCross:
+                state = AssembleGroupThree(program, mnemonic, line);
+                break;
+
+            case scMnemonic::CmpF32:
+            case scMnemonic::SelectF32:
+            case scMnemonic::Jump:
+            case scMnemonic::BranchZero:
+            case scMnemonic::BranchNotZero:
+            case scMnemonic::Loop:
+            case scMnemonic::DiscardNotZero:
+                state = AssembleGroupFour(program, mnemonic, line, targets);
+                break;
+
+            default:
+                std::cout << "[scAssembler]: Unknown instruction (" << line.operation << ")" << std::endl;
+                return scAssemblerState::NoInstructionFound;
         }
 
-        if (state == scAssemblerState::NoInstructionFound) {
-            std::cout << "[scAssembler]: Unknown instruction (" << operation << ")" << std::endl;
+        if (state != scAssemblerState::OK) {
+            std::cout << "[scAssembler]: Invalid arguments (" << source << ")" << std::endl;
             return state;
         }
     }
 
-    outProgram = scAssembledProgram(program, scModuleType::Fragment);
-    return scAssemblerState::OK;
-}
+    // Branch words hold their label's name until here, labels are usually few enough that a linear search wins
+    for (const scLabelReference& target : targets) {
+        const scLabelReference* pLabel = nullptr;
 
-uint8_t scAssembler::DecodeRegister(const std::string& name) {
-    // First char must be %
-    if (name.empty())
-        return -1;
+        for (const scLabelReference& label : labels) {
+            if (label.name == target.name)
+                pLabel = &label;
+        }
 
-    if (name[0] != '%')
-        return -1;
+        if (pLabel == nullptr) {
+            std::cout << "[scAssembler]: Unknown label (" << target.name << ")" << std::endl;
+            return scAssemblerState::UnknownLabel;
+        }
 
-    // Determine the group first by removing anything not a number
-    size_t alphaEnd = 0;
+        std::memcpy(program.data() + target.offset, &pLabel->offset, sizeof(uint32_t));
+    }
 
-    // TODO: this is hard to read
-    for (; alphaEnd < name.size(); alphaEnd++)
-        if (std::isdigit(name[alphaEnd]))
-            break;
+    outProgram.binary = std::move(program);
+    outProgram.header = scModuleHeader {
+        type,
+        static_cast<uint32_t>(outProgram.binary.size())
+    };
 
-    std::string ident = name.substr(1, alphaEnd - 1);
+    if (_optimizerOptions.has_value()) {
+        scOptimizer optimizer(_optimizerOptions.value());
+        optimizer.Optimize(outProgram);
+    }
 
-    for (char& c : ident)
-        c = std::toupper(c);
+    return scAssemblerState::OK;
+}
 
-    std::string numbers = name.substr(alphaEnd);
-    uint32_t index;
+uint8_t scAssembler::DecodeRegister(std::string_view name) {
+    constexpr uint8_t INVALID = (uint8_t)scRegister::UNKNOWN;
 
-    if (!TryParseU32(numbers, index))
-        return -1;
+    // First char must be %
+    if (name.empty() || name[0] != '%')
+        return INVALID;
 
-    if (ident == "FB") {
-        if (index >= 4)
-            return -1;
+    // The group is everything up to the first digit, the index everything after
+    size_t digit = 1;
 
-        return ((uint8_t)scRegister::FB0) + index;
-    }
+    while (digit < name.size() && !(name[digit] >= '0' && name[digit] <= '9'))
+        digit++;
 
-    if (ident == "S") {
-        if (index >= 32)
-            return -1;
+    std::string_view ident = name.substr(1, digit - 1);
+    uint32_t index;
 
-        return ((uint8_t)scRegister::S0) + index;
-    }
+    if (!TryParseU32(name.substr(digit), index))
+        return INVALID;
 
-    if (ident == "V") {
-        if (index >= 8)
-            return -1;
+    if (EqualsUpper(ident, "FB"))
+        return index < 4 ? (uint8_t)scRegister::FB0 + index : INVALID;
 
-        return ((uint8_t)scRegister::V0) + index;
-    }
+    if (EqualsUpper(ident, "S"))
+        return index < 32 ? (uint8_t)scRegister::S0 + index : INVALID;
 
-    if (ident == "M") {
-        if (index >= 2)
-            return -1;
+    if (EqualsUpper(ident, "V"))
+        return index < 8 ? (uint8_t)scRegister::V0 + index : INVALID;
 
-        return ((uint8_t)scRegister::M0) + index;
-    }
+    if (EqualsUpper(ident, "M"))
+        return index < 2 ? (uint8_t)scRegister::M0 + index : INVALID;
 
-    return -1;
+    return INVALID;
 }
 
-scAssemblerState scAssembler::AssembleGroupZero(std::vector<uint8_t>& program,
-                                                const std::string& op,
-                                                const std::vector<std::string>& args) {
+scAssemblerState scAssembler::AssembleGroupZero(std::vector<uint8_t>& program, scMnemonic mnemonic) {
     uint32_t encoded = 0x0000;
 
     SetGroup(scInstructionGroup::GroupZero, encoded);
 
-    if (op == "EXIT") {
-        SetInstruction(scGroupZeroOperations::OpExitProgram, encoded);
+    switch (mnemonic) {
+        case scMnemonic::Exit:
+            SetInstruction(scGroupZeroOperations::OpExitProgram, encoded);
+            break;
 
-        Emit(program, encoded);
-        return scAssemblerState::OK;
+        case scMnemonic::Discard:
+            SetInstruction(scGroupZeroOperations::OpDiscard, encoded);
+            break;
+
+        default:
+            return scAssemblerState::NoInstructionFound;
     }
 
-    return scAssemblerState::NoInstructionFound;
+    Emit(program, encoded);
+    return scAssemblerState::OK;
 }
 
-scAssemblerState scAssembler::AssembleGroupOne(std::vector<uint8_t>& program,
-                                                const std::string& op,
-                                                const std::vector<std::string>& args) {
+scAssemblerState scAssembler::AssembleGroupOne(std::vector<uint8_t>& program, scMnemonic mnemonic, const scSourceLine& line) {
     uint32_t encoded = 0x0000;
 
     SetGroup(scInstructionGroup::GroupOne, encoded);
 
-    if (op == "MOV") {
-        scGroupOneSubOperations subOp;
-        SetInstruction(scGroupOneOperations::OpMOV, encoded);
+    // Both take their registers as the last two operands
+    int firstRegister;
+
+    switch (mnemonic) {
+        case scMnemonic::Mov:
+            SetInstruction(scGroupOneOperations::OpMOV, encoded);
+            firstRegister = 0;
+            break;
+
+        case scMnemonic::AluF32F32: {
+            SetInstruction(scGroupOneOperations::OpALUF32F32, encoded);
+            firstRegister = 1;
+
+            if (line.operandCount < 1)
+                return scAssemblerState::InvalidArgument;
+
+            const std::string_view subOps[] = { "ADD", "SUB", "MUL", "DIV", "MOD", "POW" };
+            int subOp = 0;
 
-        uint8_t aRegister = DecodeRegister(args[0]);
-        uint8_t bRegister = DecodeRegister(args[1]);
+            while (subOp < 6 && !EqualsUpper(line.operands[0], subOps[subOp]))
+                subOp++;
 
-        if (aRegister == -1 || bRegister == -1)
-            return scAssemblerState::InvalidArgument; // TODO: Invalid register
+            if (subOp == 6)
+                return scAssemblerState::InvalidArgument;
 
-        for (int b = 0; b < 8; b++) {
-            SetBit(encoded, 16 + b, aRegister & (1 << b));
-            SetBit(encoded, 24 + b, bRegister & (1 << b));
+            encoded |= (uint32_t)subOp << 12;
+            break;
         }
 
-        Emit(program, encoded);
-        return scAssemblerState::OK;
+        default:
+            return scAssemblerState::NoInstructionFound;
     }
 
-    // TODO: Refactor this
-    if (op == "ALU_F32_F32") {
-        scGroupOneSubOperations subOp;
-        SetInstruction(scGroupOneOperations::OpALUF32F32, encoded);
-
-        // Parse the subop
-        if (args[0] == "ADD") {
-            subOp = scGroupOneSubOperations::SubOpAdd;
-        } else if (args[0] == "SUB") {
-            subOp = scGroupOneSubOperations::SubOpSub;
-        } else if (args[0] == "MUL") {
-            subOp = scGroupOneSubOperations::SubOpMul;
-        } else if (args[0] == "DIV") {
-            subOp = scGroupOneSubOperations::SubOpDiv;
-        } else if (args[0] == "MOD") {
-            subOp = scGroupOneSubOperations::SubOpMod;
-        } else if (args[0] == "POW") {
-            subOp = scGroupOneSubOperations::SubOpPow;
-        } else {
-            return scAssemblerState::InvalidArgument;
+    if (line.operandCount < firstRegister + 2)
+        return scAssemblerState::InvalidArgument;
+
+    uint8_t aRegister = DecodeRegister(line.operands[firstRegister]);
+    uint8_t bRegister = DecodeRegister(line.operands[firstRegister + 1]);
+
+    if (aRegister == (uint8_t)scRegister::UNKNOWN || bRegister == (uint8_t)scRegister::UNKNOWN)
+        return scAssemblerState::InvalidArgument;
+
+    encoded |= (uint32_t)aRegister << 16;
+    encoded |= (uint32_t)bRegister << 24;
+
+    Emit(program, encoded);
+    return scAssemblerState::OK;
+}
+
+scAssemblerState scAssembler::AssembleGroupTwo(std::vector<uint8_t>& program, scMnemonic mnemonic, const scSourceLine& line) {
+    uint32_t encoded = 0x0000;
+
+    SetGroup(scInstructionGroup::GroupTwo, encoded);
+
+    if (line.operandCount < 1)
+        return scAssemblerState::InvalidArgument;
+
+    uint8_t targetRegister = DecodeRegister(line.operands[0]);
+
+    if (targetRegister == (uint8_t)scRegister::UNKNOWN)
+        return scAssemblerState::InvalidArgument;
+
+    encoded |= (uint32_t)targetRegister << 12;
+
+    switch (mnemonic) {
+        case scMnemonic::SetF32: {
+            SetInstruction(scGroupTwoOperations::OpSetF32, encoded);
+
+            float arg = 0;
+
+            if (line.operandCount < 2 || !TryParseFloat(line.operands[1], arg))
+                return scAssemblerState::InvalidArgument;
+
+            Emit(program, encoded);
+            Emit(program, arg);
+
+            return scAssemblerState::OK;
         }
 
-        uint8_t aRegister = DecodeRegister(args[1]);
-        uint8_t bRegister = DecodeRegister(args[2]);
+        case scMnemonic::LoadF32: {
+            SetInstruction(scGroupTwoOperations::OpLoadF32, encoded);
+
+            uint32_t arg = 0;
+
+            if (line.operandCount < 2 || !TryParseHex(line.operands[1], arg))
+                return scAssemblerState::InvalidArgument;
 
-        if (aRegister == -1 || bRegister == -1)
-            return scAssemblerState::InvalidArgument; // TODO: Invalid register
+            Emit(program, encoded);
+            Emit(program, arg);
 
-        for (int b = 0; b < 4; b++) {
-            SetBit(encoded, 12 + b, ((int)subOp) & (1 << b));
+            return scAssemblerState::OK;
         }
 
-        for (int b = 0; b < 8; b++) {
-            SetBit(encoded, 16 + b, aRegister & (1 << b));
-            SetBit(encoded, 24 + b, bRegister & (1 << b));
+        case scMnemonic::AbsF32:
+            SetInstruction(scGroupTwoOperations::OpABSF32, encoded);
+
+            Emit(program, encoded);
+            return scAssemblerState::OK;
+
+        // SMP_POINT / SMP_LINEAR <RGBA V register> <U / V register> <LOD register> <slot>
+        case scMnemonic::SamplePoint:
+        case scMnemonic::SampleLinear: {
+            SetInstruction(mnemonic == scMnemonic::SamplePoint ? scGroupTwoOperations::OpSamplePoint : scGroupTwoOperations::OpSampleLinear, encoded);
+
+            if (line.operandCount < 4)
+                return scAssemblerState::InvalidArgument;
+
+            if (targetRegister < (uint8_t)scRegister::V0 || targetRegister > (uint8_t)scRegister::V7)
+                return scAssemblerState::InvalidArgument;
+
+            // The coordinate is a scalar register and the one after it, or the first two components of a V register
+            uint8_t coordRegister = DecodeRegister(line.operands[1]);
+            uint8_t lodRegister = DecodeRegister(line.operands[2]);
+
+            bool coordValid = coordRegister < (uint8_t)scRegister::REGISTER_COUNT - 1
+                              || (coordRegister >= (uint8_t)scRegister::V0 && coordRegister <= (uint8_t)scRegister::V7);
+
+            uint32_t slot = 0;
+
+            if (!coordValid || lodRegister >= (uint8_t)scRegister::REGISTER_COUNT)
+                return scAssemblerState::InvalidArgument;
+
+            if (!TryParseU32(line.operands[3], slot) || slot >= SC_TEXTURE_SLOT_COUNT)
+                return scAssemblerState::InvalidArgument;
+
+            encoded |= (uint32_t)coordRegister << 20;
+
+            Emit(program, encoded);
+            Emit(program, scPackSampleOperand((scRegister)lodRegister, slot));
+
+            return scAssemblerState::OK;
         }
 
-        Emit(program, encoded);
-        return scAssemblerState::OK;
+        default:
+            return scAssemblerState::NoInstructionFound;
     }
+}
+
+static bool IsVectorRegister(uint8_t reg) {
+    return reg >= (uint8_t)scRegister::V0 && reg <= (uint8_t)scRegister::V7;
+}
 
-    return scAssemblerState::NoInstructionFound;
+static bool IsMatrixRegister(uint8_t reg) {
+    return reg >= (uint8_t)scRegister::M0 && reg <= (uint8_t)scRegister::M1;
 }
 
-scAssemblerState scAssembler::AssembleGroupTwo(std::vector<uint8_t>& program,
-                                               const std::string& op,
-                                                const std::vector<std::string>& args) {
+scAssemblerState scAssembler::AssembleGroupThree(std::vector<uint8_t>& program, scMnemonic mnemonic, const scSourceLine& line) {
     uint32_t encoded = 0x0000;
 
-    SetGroup(scInstructionGroup::GroupTwo, encoded);
+    SetGroup(scInstructionGroup::GroupThree, encoded);
+
+    // Which kind of register each operand has to be, transposes only take one
+    bool (*isA)(uint8_t) = IsVectorRegister;
+    bool (*isB)(uint8_t) = IsVectorRegister;
+
+    switch (mnemonic) {
+        // MAT_MUL_VEC <V register> <M register>
+        case scMnemonic::MatMulVec:
+            SetInstruction(scGroupThreeOperations::OpMatMulVec, encoded);
+            isB = IsMatrixRegister;
+            break;
+
+        // MAT_MUL_MAT <M register> <M register>
+        case scMnemonic::MatMulMat:
+            SetInstruction(scGroupThreeOperations::OpMatMulMat, encoded);
+            isA = IsMatrixRegister;
+            isB = IsMatrixRegister;
+            break;
+
+        // MAT_TRANSPOSE <M register>
+        case scMnemonic::MatTranspose:
+            SetInstruction(scGroupThreeOperations::OpMatTranspose, encoded);
+            isA = IsMatrixRegister;
+            isB = nullptr;
+            break;
 
-    if (args.size() < 1)
-        return scAssemblerState::NoInstructionFound;
+        // VEC_DOT3 / VEC_DOT4 / VEC_CROSS <V register> <V register>
+        case scMnemonic::VecDot3:
+            SetInstruction(scGroupThreeOperations::OpVecDot3, encoded);
+            break;
+
+        case scMnemonic::VecDot4:
+            SetInstruction(scGroupThreeOperations::OpVecDot4, encoded);
+            break;
 
-    uint8_t targetRegister = DecodeRegister(args[0]);
+        case scMnemonic::VecCross:
+            SetInstruction(scGroupThreeOperations::OpVecCross, encoded);
+            break;
 
-    for (int b = 0; b < 8; b++) {
-        SetBit(encoded, 12 + b, targetRegister & (1 << b));
+        default:
+            return scAssemblerState::NoInstructionFound;
     }
 
-    if (op == "SET_F32") {
-        SetInstruction(scGroupTwoOperations::OpSetF32, encoded);
+    if (line.operandCount < (isB != nullptr ? 2 : 1))
+        return scAssemblerState::InvalidArgument;
 
-        float arg = 0;
+    uint8_t aRegister = DecodeRegister(line.operands[0]);
 
-        if (!TryParseFloat(args[1], arg))
-            return scAssemblerState::InvalidArgument;
+    if (!isA(aRegister))
+        return scAssemblerState::InvalidArgument;
 
-        Emit(program, encoded);
-        Emit(program, arg);
+    encoded |= (uint32_t)aRegister << 16;
 
-        return scAssemblerState::OK;
+    if (isB != nullptr) {
+        uint8_t bRegister = DecodeRegister(line.operands[1]);
+
+        if (!isB(bRegister))
+            return scAssemblerState::InvalidArgument;
+
+        encoded |= (uint32_t)bRegister << 24;
     }
 
-    if (op == "LD_F32") {
-        SetInstruction(scGroupTwoOperations::OpLoadF32, encoded);
+    Emit(program, encoded);
+    return scAssemblerState::OK;
+}
+
+static bool IsScalarRegister(uint8_t reg) {
+    return reg < (uint8_t)scRegister::REGISTER_COUNT;
+}
+
+scAssemblerState scAssembler::AssembleGroupFour(std::vector<uint8_t>& program, scMnemonic mnemonic, const scSourceLine& line, std::vector<scLabelReference>& outTargets) {
+    uint32_t encoded = 0x0000;
+
+    SetGroup(scInstructionGroup::GroupFour, encoded);
 
-        for (int b = 0; b < 8; b++) {
-            SetBit(encoded, 12 + b, targetRegister & (1 << b));
+    // Operands up to the registers, how many registers follow and whether a label comes last
+    int firstRegister = 0;
+    int registerCount;
+    bool hasLabel = true;
+
+    switch (mnemonic) {
+        // CMP_F32 <LT|LE|GT|GE|EQ|NE> <A register> <B register>
+        case scMnemonic::CmpF32: {
+            if (line.operandCount < 1)
+                return scAssemblerState::InvalidArgument;
+
+            const std::string_view subOps[] = { "LT", "LE", "GT", "GE", "EQ", "NE" };
+            int subOp = 0;
+
+            while (subOp < 6 && !EqualsUpper(line.operands[0], subOps[subOp]))
+                subOp++;
+
+            if (subOp == 6)
+                return scAssemblerState::InvalidArgument;
+
+            SetInstruction((int)scGroupFourOperations::OpCmpLt + subOp, encoded);
+
+            firstRegister = 1;
+            registerCount = 2;
+            hasLabel = false;
+            break;
         }
 
-        Emit(program, encoded);
+        // SEL_F32 <A register> <B register> <condition register>
+        case scMnemonic::SelectF32:
+            SetInstruction(scGroupFourOperations::OpSelect, encoded);
+            registerCount = 3;
+            hasLabel = false;
+            break;
+
+        // JMP <label>
+        case scMnemonic::Jump:
+            SetInstruction(scGroupFourOperations::OpJump, encoded);
+            registerCount = 0;
+            break;
 
-        uint32_t arg = 0;
+        // BRZ / BRNZ / LOOP <A register> <label>
+        case scMnemonic::BranchZero:
+            SetInstruction(scGroupFourOperations::OpBranchZero, encoded);
+            registerCount = 1;
+            break;
 
-        if (!TryParseHex(args[1], arg))
-            return scAssemblerState::InvalidArgument;
+        case scMnemonic::BranchNotZero:
+            SetInstruction(scGroupFourOperations::OpBranchNotZero, encoded);
+            registerCount = 1;
+            break;
 
-        Emit(program, arg);
+        case scMnemonic::Loop:
+            SetInstruction(scGroupFourOperations::OpLoop, encoded);
+            registerCount = 1;
+            break;
 
-        return scAssemblerState::OK;
+        // DISCARD_NZ <A register>
+        case scMnemonic::DiscardNotZero:
+            SetInstruction(scGroupFourOperations::OpDiscardNotZero, encoded);
+            registerCount = 1;
+            hasLabel = false;
+            break;
+
+        default:
+            return scAssemblerState::NoInstructionFound;
+    }
+
+    if (line.operandCount < firstRegister + registerCount + (hasLabel ? 1 : 0))
+        return scAssemblerState::InvalidArgument;
+
+    uint8_t registers[3] {};
+
+    for (int r = 0; r < registerCount; r++) {
+        registers[r] = DecodeRegister(line.operands[firstRegister + r]);
+
+        if (!IsScalarRegister(registers[r]))
+            return scAssemblerState::InvalidArgument;
     }
 
-    if (op == "ABS_F32") {
-        SetInstruction(scGroupTwoOperations::OpABSF32, encoded);
+    encoded |= (uint32_t)registers[0] << 12;
+    encoded |= (uint32_t)registers[1] << 20;
+
+    Emit(program, encoded);
 
-        Emit(program, encoded);
+    if (!hasLabel) {
+        if (mnemonic == scMnemonic::SelectF32)
+            Emit(program, (uint32_t)registers[2]);
 
         return scAssemblerState::OK;
     }
 
-    return scAssemblerState::NoInstructionFound;
+    outTargets.push_back({ line.operands[firstRegister + registerCount], (uint32_t)program.size() });
+    Emit(program, (uint32_t)0);
+
+    return scAssemblerState::OK;
+}
+
+// =========
+//  Parsing
+// =========
+
+// strtod and strtoul need a terminator, tokens are views into the middle of the source
+static bool CopyToken(std::string_view str, char (&buffer)[64]) {
+    if (str.empty() || str.size() >= sizeof(buffer))
+        return false;
+
+    std::memcpy(buffer, str.data(), str.size());
+    buffer[str.size()] = '\0';
+
+    return true;
 }
 
-bool scAssembler::TryParseFloat(const std::string& str, float& out) {
+bool scAssembler::TryParseFloat(std::string_view str, float& out) {
+    // Plain decimals with up to 15 digits are exact as a double, as is any power of ten up to 1e22. Dividing the two
+    // gives the same correctly rounded double strtod would, everything else (exponents, hex, inf) goes to strtod
+    static constexpr double POWERS_OF_TEN[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+
+    size_t cur = 0;
+    bool negative = false;
+
+    if (cur < str.size() && (str[cur] == '-' || str[cur] == '+'))
+        negative = str[cur++] == '-';
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fractionDigits = 0;
+    bool fraction = false;
+
+    for (; cur < str.size(); cur++) {
+        char ch = str[cur];
+
+        if (ch == '.' && !fraction) {
+            fraction = true;
+            continue;
+        }
+
+        if (ch < '0' || ch > '9')
+            break;
+
+        mantissa = mantissa * 10 + (ch - '0');
+        digits++;
+
+        if (fraction)
+            fractionDigits++;
+    }
+
+    if (cur == str.size() && digits > 0 && digits <= 15) {
+        double value = (double)mantissa / POWERS_OF_TEN[fractionDigits];
+        out = (float)(negative ? -value : value);
+
+        return true;
+    }
+
+    char buffer[64];
+
+    if (!CopyToken(str, buffer))
+        return false;
+
     char* end;
-    out = std::strtod(str.c_str(), &end);
+    out = std::strtod(buffer, &end);
 
-    return end != str.c_str();
+    return end != buffer;
 }
 
-bool scAssembler::TryParseHex(const std::string& str, uint32_t& out) {
+bool scAssembler::TryParseHex(std::string_view str, uint32_t& out) {
     return TryParseU32(str, out, 16);
 }
 
-bool scAssembler::TryParseU32(const std::string& str, uint32_t& out, int radix) {
+bool scAssembler::TryParseU32(std::string_view str, uint32_t& out, int radix) {
+    // Digits only, anything else (signs, whitespace, unusual radices) goes to strtoul
+    size_t cur = 0;
+
+    if (radix == 16 && str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+        cur = 2;
+
+    uint32_t value = 0;
+    size_t begin = cur;
+
+    for (; cur < str.size(); cur++) {
+        char ch = str[cur];
+        int digit;
+
+        if (ch >= '0' && ch <= '9')
+            digit = ch - '0';
+        else if (ch >= 'a' && ch <= 'z')
+            digit = ch - 'a' + 10;
+        else if (ch >= 'A' && ch <= 'Z')
+            digit = ch - 'A' + 10;
+        else
+            break;
+
+        if (digit >= radix)
+            break;
+
+        value = value * radix + digit;
+    }
+
+    // Short enough that it can't have overflowed
+    if (cur > begin && (radix == 10 || radix == 16) && cur - begin <= (radix == 10 ? 9u : 8u)) {
+        out = value;
+        return true;
+    }
+
+    char buffer[64];
+
+    if (!CopyToken(str, buffer))
+        return false;
+
     char* end;
-    out = std::strtoul(str.c_str(), &end, radix);
+    out = std::strtoul(buffer, &end, radix);
 
-    return end != str.c_str();
+    return end != buffer;
 }
@@ -33,12 +33,21 @@
 #define SCHISM_SC_ASSEMBLER_HPP
 
 #include <string>
+#include <string_view>
+#include <array>
 #include <vector>
+#include <memory>
 #include <optional>
 #include <bitset>
 
 #include <schism/sc_operations.hpp>
 #include <schism/sc_module.hpp>
+#include <schism/sc_optimizer.hpp>
+
+// Bumped whenever the same source would assemble to different bytes, cached modules from older versions are reassembled
+constexpr uint32_t SC_ASSEMBLER_VERSION = 3;
+
+class scCompileCache;
 
 enum class scAssemblerState {
     OK,
@@ -47,6 +56,11 @@ enum class scAssemblerState {
     InvalidArgument,
 
     NoInstructionFound,
+
+    // A branch names a label that is never defined, or a label is defined twice
+    UnknownLabel,
+
+    FileNotFound,
 };
 
 class scAssembledProgram {
@@ -57,20 +71,89 @@ public:
     scAssembledProgram() = default;
     scAssembledProgram(const std::vector<uint8_t>& binary, scModuleType type);
 
-    void WriteToFile(const std::string& path);
+    // Returns false if the file couldn't be written completely
+    bool WriteToFile(const std::string& path) const;
 
     scModule CreateModule() const;
 };
 
+// enum scMnemonic
+//   - Every instruction the assembler understands, mnemonics are case insensitive
+enum class scMnemonic : uint8_t {
+    Exit,
+    Mov,
+    AluF32F32,
+    SetF32,
+    LoadF32,
+    AbsF32,
+    SamplePoint,
+    SampleLinear,
+    MatMulVec,
+    MatMulMat,
+    MatTranspose,
+    VecDot3,
+    VecDot4,
+    VecCross,
+    CmpF32,
+    SelectF32,
+    Jump,
+    BranchZero,
+    BranchNotZero,
+    Loop,
+    Discard,
+    DiscardNotZero,
+
+    UNKNOWN
+};
+
+// Looks the mnemonic up in a hash table built at compile time, returns UNKNOWN if there is no such instruction
+extern scMnemonic scFindMnemonic(std::string_view name);
+
+// Anything past this many operands is ignored
+constexpr int SC_ASSEMBLER_MAX_OPERANDS = 8;
+
+// struct scSourceLine
+//   - A single tokenized line of assembly, every token is a view into the source text
+struct scSourceLine {
+    std::string_view operation;
+
+    std::array<std::string_view, SC_ASSEMBLER_MAX_OPERANDS> operands;
+    int operandCount;
+};
+
+// struct scLabelReference
+//   - A label and the byte offset it stands for, or a branch target waiting for its label to be defined
+struct scLabelReference {
+    std::string_view name;
+    uint32_t offset;
+};
+
 class scAssembler {
+protected:
+    std::optional<scOptimizerOptions> _optimizerOptions;
+
+    std::shared_ptr<const scCompileCache> _cache;
+
+    // Assembles text without going through the cache
+    scAssemblerState Assemble(std::string_view text, scAssembledProgram& outProgram);
+
+    static bool ReadSourceFile(const std::string& path, std::string& outText);
+
 public:
+    // Every program compiled afterwards is run through scOptimizer, std::nullopt turns it off again
+    void SetOptimizer(const std::optional<scOptimizerOptions>& options) {
+        _optimizerOptions = options;
+    }
+
+    // Sources are looked up in cache before they're assembled, and stored in it afterwards, null turns caching off
+    void SetCache(std::shared_ptr<const scCompileCache> cache) {
+        _cache = std::move(cache);
+    }
+
     template<class T>
     void Emit(std::vector<uint8_t>& program, T value) {
-        uint8_t* valPtr = (uint8_t*)&value;
-
-        for (int x = 0; x < sizeof(T); x++) {
-            program.emplace_back(valPtr[x]);
-        }
+        const uint8_t* valPtr = (const uint8_t*)&value;
+        program.insert(program.end(), valPtr, valPtr + sizeof(T));
     }
 
     void EmitBitset(std::vector<uint8_t>& program, const std::bitset<32>& bits) {
@@ -78,50 +161,51 @@ public:
     }
 
     void SetBit(uint32_t& encoded, int bit, bool value) {
-        encoded = (encoded & ~((int)1 << bit)) | (value << bit);
+        encoded = (encoded & ~((uint32_t)1 << bit)) | ((uint32_t)value << bit);
     }
 
     void SetGroup(scInstructionGroup group, uint32_t& encoded) {
-        int rawGroup = (int)group;
-
-        for (int b = 0; b < 4; b++) {
-            SetBit(encoded, b, rawGroup & (1 << b));
-        }
+        encoded = (encoded & ~0xFu) | ((uint32_t)group & 0xF);
     }
 
     template<typename T>
     void SetInstruction(T operation, uint32_t& encoded) {
-        int raw = (int)operation;
-
-        for (int b = 0; b < 8; b++) {
-            SetBit(encoded, 4 + b, raw & (1 << b));
-        }
+        encoded = (encoded & ~0xFF0u) | (((uint32_t)operation & 0xFF) << 4);
     }
 
     scAssemblerState CompileSourceFile(const std::string& path, scAssembledProgram& outProgram);
 
-    scAssemblerState CompileSourceText(const std::string& text, scAssembledProgram& outProgram);
+    // Single pass over text, branches to labels further down are patched once the whole text was read
+    scAssemblerState CompileSourceText(std::string_view text, scAssembledProgram& outProgram);
+
+    // Same as above, but cache hits are mapped straight from the cache instead of being copied
+    scAssemblerState CompileSourceFile(const std::string& path, scModule& outModule);
+
+    scAssemblerState CompileSourceText(std::string_view text, scModule& outModule);
+
+    // Returns false if the line is blank or a comment
+    static bool TokenizeLine(std::string_view line, scSourceLine& outLine);
+
+    // Returns scRegister::UNKNOWN if name isn't a register
+    static uint8_t DecodeRegister(std::string_view name);
+
+    scAssemblerState AssembleGroupZero(std::vector<uint8_t>& program, scMnemonic mnemonic);
 
-    uint8_t DecodeRegister(const std::string& name);
+    scAssemblerState AssembleGroupOne(std::vector<uint8_t>& program, scMnemonic mnemonic, const scSourceLine& line);
 
-    scAssemblerState AssembleGroupZero(std::vector<uint8_t>& program,
-                                       const std::string& op,
-                                       const std::vector<std::string>& args);
+    scAssemblerState AssembleGroupTwo(std::vector<uint8_t>& program, scMnemonic mnemonic, const scSourceLine& line);
 
-    scAssemblerState AssembleGroupOne(std::vector<uint8_t>& program,
-                                      const std::string& op,
-                                      const std::vector<std::string>& args);
+    scAssemblerState AssembleGroupThree(std::vector<uint8_t>& program, scMnemonic mnemonic, const scSourceLine& line);
 
-    scAssemblerState AssembleGroupTwo(std::vector<uint8_t>& program,
-                                      const std::string& op,
-                                      const std::vector<std::string>& args);
+    // Every branch adds the offset of its target word to outTargets, it's filled in by Assemble
+    scAssemblerState AssembleGroupFour(std::vector<uint8_t>& program, scMnemonic mnemonic, const scSourceLine& line, std::vector<scLabelReference>& outTargets);
 
 public:
-    static bool TryParseFloat(const std::string& str, float& out);
+    static bool TryParseFloat(std::string_view str, float& out);
 
-    static bool TryParseHex(const std::string& str, uint32_t& out);
+    static bool TryParseHex(std::string_view str, uint32_t& out);
 
-    static bool TryParseU32(const std::string& str, uint32_t& out, int radix = 10);
+    static bool TryParseU32(std::string_view str, uint32_t& out, int radix = 10);
 };
 
 #endif //SCHISM_SC_ASSEMBLER_HPP
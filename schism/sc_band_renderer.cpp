@@ -0,0 +1,134 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_band_renderer.hpp"
+
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <condition_variable>
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scBandRenderer::scBandRenderer(scRenderer& renderer) : _renderer(renderer) {
+
+}
+
+void scBandRenderer::SetBandHeight(int rows) {
+    _bandHeight = std::max(rows, 1);
+}
+
+void scBandRenderer::SetBufferCount(int count) {
+    _bufferCount = std::max(count, 2);
+}
+
+// ===========
+//  Rendering
+// ===========
+bool scBandRenderer::Render(int width, int height, scPixelFormat format, const scBandSink& sink, bool bottomUp) {
+    if (width <= 0 || height <= 0)
+        return true;
+
+    int bandCount = (height + _bandHeight - 1) / _bandHeight;
+    int bufferCount = std::min(_bufferCount, bandCount);
+
+    size_t pitch = (size_t)width * scGetPixelSize(format);
+    std::vector<std::vector<uint8_t>> buffers(bufferCount, std::vector<uint8_t>(pitch * _bandHeight));
+
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    // Bands [written, rendered) are waiting on the writer, band b always lives in buffer b % bufferCount
+    int rendered = 0;
+    int written = 0;
+    bool stopped = false;
+
+    auto getRows = [&](int band, int& y0, int& y1) {
+        int slot = bottomUp ? bandCount - 1 - band : band;
+
+        y0 = slot * _bandHeight;
+        y1 = std::min(y0 + _bandHeight, height);
+    };
+
+    std::thread writer([&]() {
+        for (int band = 0; band < bandCount; band++) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return rendered > band; });
+            }
+
+            int y0, y1;
+            getRows(band, y0, y1);
+
+            bool accepted = sink(y0, y1, buffers[band % bufferCount].data(), pitch);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                written = band + 1;
+                stopped = !accepted;
+            }
+
+            changed.notify_all();
+
+            if (!accepted)
+                return;
+        }
+    });
+
+    for (int band = 0; band < bandCount; band++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return stopped || band - written < bufferCount; });
+
+            if (stopped)
+                break;
+        }
+
+        int y0, y1;
+        getRows(band, y0, y1);
+
+        _renderer.RenderBand(width, height, y0, y1, buffers[band % bufferCount].data(), pitch, format);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            rendered = band + 1;
+        }
+
+        changed.notify_all();
+    }
+
+    // A writer that stopped the render has already returned, it never waits on a band that isn't rendered
+    writer.join();
+
+    return !stopped;
+}
@@ -0,0 +1,88 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_BAND_RENDERER_HPP
+#define SCHISM_SC_BAND_RENDERER_HPP
+
+#include <cstdint>
+
+#include <vector>
+#include <functional>
+
+#include <schism/sc_renderer.hpp>
+
+// Receives a finished band, pPixels holds rows [y0, y1) top to bottom
+//   - Returning false stops the render, no further bands are handed out
+typedef std::function<bool(int y0, int y1, const uint8_t* pPixels, size_t pitch)> scBandSink;
+
+// Renders surfaces too large to keep in memory one band of rows at a time
+//   - Bands are handed to the sink on a writer thread while the next band renders, so disk and compute overlap
+//   - At most the buffer count of bands is alive at once, memory doesn't depend on the height of the surface
+//   - The renderer belongs to Render until it returns
+class scBandRenderer {
+protected:
+    scRenderer& _renderer;
+
+    int _bandHeight = 64;
+    int _bufferCount = 3;
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    explicit scBandRenderer(scRenderer& renderer);
+
+    scBandRenderer(const scBandRenderer&) = delete;
+    scBandRenderer& operator=(const scBandRenderer&) = delete;
+
+public:
+    void SetBandHeight(int rows);
+
+    // Two buffers are the minimum to overlap rendering and writing, more absorb an uneven sink
+    void SetBufferCount(int count);
+
+    [[nodiscard]]
+    int GetBandHeight() const {
+        return _bandHeight;
+    }
+
+    [[nodiscard]]
+    int GetBufferCount() const {
+        return _bufferCount;
+    }
+
+    // Renders a width x height surface, handing bands to the sink in order
+    //   - bottomUp hands out the last band first, for formats that store the bottom row first
+    //   - Returns false if the sink stopped the render
+    bool Render(int width, int height, scPixelFormat format, const scBandSink& sink, bool bottomUp = false);
+};
+
+#endif //SCHISM_SC_BAND_RENDERER_HPP
@@ -0,0 +1,127 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_compile_cache.hpp"
+
+#include <cstdio>
+
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <functional>
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scCompileCache::scCompileCache(std::string directory) {
+    _directory = std::move(directory);
+}
+
+// =========
+//  Hashing
+// =========
+
+// FNV-1a
+static uint64_t HashBytes(uint64_t hash, const void* pData, size_t size) {
+    const uint8_t* pBytes = (const uint8_t*)pData;
+
+    for (size_t b = 0; b < size; b++)
+        hash = (hash ^ pBytes[b]) * 1099511628211ull;
+
+    return hash;
+}
+
+uint64_t scCompileCache::HashSource(std::string_view text, const std::optional<scOptimizerOptions>& optimizerOptions) {
+    uint32_t versions[] = { SC_ASSEMBLER_VERSION, SC_ISA_VERSION };
+
+    // Bit 0 marks the optimizer as enabled, the rest are its passes
+    uint8_t optimizer = 0;
+
+    if (optimizerOptions.has_value()) {
+        optimizer = 1;
+        optimizer |= optimizerOptions->constantFolding ? 2 : 0;
+        optimizer |= optimizerOptions->copyPropagation ? 4 : 0;
+        optimizer |= optimizerOptions->deadCodeElimination ? 8 : 0;
+    }
+
+    uint64_t length = text.size();
+    uint64_t hash = 14695981039346656037ull;
+
+    hash = HashBytes(hash, versions, sizeof(versions));
+    hash = HashBytes(hash, &optimizer, sizeof(optimizer));
+    hash = HashBytes(hash, &length, sizeof(length));
+    hash = HashBytes(hash, text.data(), text.size());
+
+    return hash;
+}
+
+std::string scCompileCache::GetPath(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.scsm", (unsigned long long)key);
+
+    return (std::filesystem::path(_directory) / name).string();
+}
+
+// =========
+//  Entries
+// =========
+bool scCompileCache::Load(uint64_t key, scModule& outModule) const {
+    return outModule.LoadFromFile(GetPath(key)) == scModuleState::OK;
+}
+
+bool scCompileCache::Store(uint64_t key, const scAssembledProgram& program) const {
+    std::error_code error;
+    std::filesystem::create_directories(_directory, error);
+
+    std::string path = GetPath(key);
+
+    // Unique per writer, two processes storing the same entry both rename a complete file into place
+    uint64_t salt = std::hash<std::thread::id>()(std::this_thread::get_id()) ^ (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%016llx.tmp", (unsigned long long)salt);
+
+    std::string tempPath = path + suffix;
+
+    if (!program.WriteToFile(tempPath)) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    std::filesystem::rename(tempPath, path, error);
+
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,78 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_COMPILE_CACHE_HPP
+#define SCHISM_SC_COMPILE_CACHE_HPP
+
+#include <cstdint>
+
+#include <string>
+#include <string_view>
+#include <optional>
+
+#include <schism/sc_module.hpp>
+#include <schism/sc_assembler.hpp>
+
+// A directory of assembled modules, named after a hash of everything that decides what the source assembles to
+//   - Entries are written to a temporary file and renamed into place, so readers only ever see complete modules
+//   - Hits are mapped with scModule::LoadFromFile
+//   - Any number of processes can share a directory, entries are never modified once they exist
+class scCompileCache {
+protected:
+    std::string _directory;
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    // The directory is created on the first store
+    explicit scCompileCache(std::string directory);
+
+public:
+    // Hashes the source together with SC_ASSEMBLER_VERSION, SC_ISA_VERSION and the optimizer options
+    static uint64_t HashSource(std::string_view text, const std::optional<scOptimizerOptions>& optimizerOptions);
+
+    [[nodiscard]]
+    std::string GetPath(uint64_t key) const;
+
+    // Returns false on a miss, or if the cached file is unreadable and should be replaced
+    bool Load(uint64_t key, scModule& outModule) const;
+
+    // Returns false if the module couldn't be written, a failed store only costs a later recompile
+    bool Store(uint64_t key, const scAssembledProgram& program) const;
+
+    [[nodiscard]]
+    const std::string& GetDirectory() const {
+        return _directory;
+    }
+};
+
+#endif //SCHISM_SC_COMPILE_CACHE_HPP
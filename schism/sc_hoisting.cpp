@@ -0,0 +1,150 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_hoisting.hpp"
+
+#include <array>
+#include <algorithm>
+
+static constexpr int REGISTER_COUNT = (int)scRegister::REGISTER_COUNT;
+
+bool scHoistUniforms(const scModule& module, size_t memorySize, scHoistedProgram& outProgram) {
+    // Registers start zeroed, so until an invocation writes them they hold the same value everywhere
+    std::array<bool, REGISTER_COUNT> uniform {};
+    uniform.fill(true);
+
+    // Registers the body has read or written, moving a write to them ahead of the body would reorder the two
+    std::array<bool, REGISTER_COUNT> touched {};
+
+    std::vector<scInstruction> prologue;
+    std::vector<scInstruction> body;
+
+    bool hoisting = true;
+
+    scSpan<const scInstruction> instructions = module.GetInstructions();
+
+    // Nothing at or past the first branch or branch target can move, as a branch may run it any number of times. Only
+    // instructions before it are dropped from the body, so branch displacements stay the same
+    size_t fixed = instructions.size();
+
+    for (size_t i = 0; i < instructions.size(); i++) {
+        if (scIsBranchOpcode(instructions[i].opcode))
+            fixed = std::min(fixed, std::min(i, (size_t)(i + scGetBranchDisplacement(instructions[i]))));
+    }
+
+    for (size_t i = 0; i < instructions.size(); i++) {
+        const scInstruction& instruction = instructions[i];
+
+        if (i >= fixed) {
+            prologue.push_back(instructions[instructions.size() - 1]);
+            body.insert(body.end(), instructions.begin() + i, instructions.end());
+            break;
+        }
+
+        if (instruction.opcode == scOpcode::Exit) {
+            prologue.push_back(instruction);
+            body.push_back(instruction);
+            break;
+        }
+
+        if (instruction.opcode == scOpcode::Nop)
+            continue;
+
+        scRegisterAccess access {};
+        bool known = scGetRegisterAccess(instruction, access);
+
+        bool load = instruction.opcode == scOpcode::LoadF32 || instruction.opcode == scOpcode::LoadF32Unchecked;
+
+        if (load && instruction.immediate.u32 + sizeof(float) > memorySize)
+            known = false;
+
+        hoisting = hoisting && known;
+
+        // Textures are bound separately from uniform memory, rebinding one doesn't rerun the prologue
+        bool sample = instruction.opcode == scOpcode::SamplePoint || instruction.opcode == scOpcode::SampleLinear;
+
+        // Discards write nothing, but have to stop the invocation they run in
+        bool discard = instruction.opcode == scOpcode::Discard || instruction.opcode == scOpcode::DiscardNotZero;
+
+        bool hoist = hoisting && !sample && !discard;
+
+        for (int r = 0; hoist && r < access.readCount; r++) {
+            for (int d = 0; d < access.readWidths[r]; d++)
+                hoist = hoist && uniform[access.reads[r] + d];
+        }
+
+        for (int d = 0; hoist && d < access.width; d++)
+            hoist = hoist && !touched[access.write + d];
+
+        if (hoist && load) {
+            uint32_t address = instruction.immediate.u32;
+            hoist = address >= SC_UNIFORM_MEMORY_BEGIN && address + sizeof(float) <= SC_UNIFORM_MEMORY_END;
+        }
+
+        if (hoist) {
+            prologue.push_back(instruction);
+            continue;
+        }
+
+        body.push_back(instruction);
+
+        if (!hoisting)
+            continue;
+
+        for (int r = 0; r < access.readCount; r++) {
+            for (int d = 0; d < access.readWidths[r]; d++)
+                touched[access.reads[r] + d] = true;
+        }
+
+        for (int d = 0; d < access.width; d++) {
+            touched[access.write + d] = true;
+            uniform[access.write + d] = false;
+        }
+    }
+
+    // Only the EXIT
+    if (prologue.size() <= 1)
+        return false;
+
+    outProgram.prologue = scModule(module, prologue);
+    outProgram.body = scModule(module, body);
+
+    return true;
+}
+
+scHoistedProgramRef scHoistUniforms(const scModule& module, size_t memorySize) {
+    std::shared_ptr<scHoistedProgram> hoisted = std::make_shared<scHoistedProgram>();
+
+    if (!scHoistUniforms(module, memorySize, *hoisted))
+        return nullptr;
+
+    return hoisted;
+}
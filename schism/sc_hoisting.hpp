@@ -0,0 +1,70 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_HOISTING_HPP
+#define SCHISM_SC_HOISTING_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+#include <schism/sc_module.hpp>
+
+// Memory the host writes once per surface rather than once per invocation, (width - 1) / (height - 1) at 0x08 / 0x0C
+constexpr uint32_t SC_UNIFORM_MEMORY_BEGIN = 0x08;
+constexpr uint32_t SC_UNIFORM_MEMORY_END = 0x10;
+
+// struct scHoistedProgram
+//   - A module split into a prologue that only depends on uniform memory and constants, and the body that's left
+//   - Running the prologue from zeroed registers followed by the body gives the same result as the original module
+//   - Both keep the code and byte offsets of the original module
+struct scHoistedProgram {
+    scModule prologue;
+    scModule body;
+};
+
+typedef std::shared_ptr<const scHoistedProgram> scHoistedProgramRef;
+
+// Moves every instruction that computes the same value for every invocation into the prologue
+//   - memorySize is the memory size of the context the program will run in, loads are only hoisted if they can't fail
+//   - Hoisting stops at the first instruction it doesn't understand, a load that always fails or the first branch or
+//     branch target
+//   - Returns false if nothing could be hoisted
+extern bool scHoistUniforms(const scModule& module, size_t memorySize, scHoistedProgram& outProgram);
+
+// Same as above but shareable between contexts, returns null if nothing could be hoisted
+extern scHoistedProgramRef scHoistUniforms(const scModule& module, size_t memorySize);
+
+// Returns true if writing size bytes at index changes what the prologue computes
+inline bool scIsUniformMemory(uint32_t index, size_t size) {
+    return index < SC_UNIFORM_MEMORY_END && index + size > SC_UNIFORM_MEMORY_BEGIN;
+}
+
+#endif //SCHISM_SC_HOISTING_HPP
@@ -0,0 +1,657 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_jit.hpp"
+
+#ifdef SCHISM_HAS_JIT
+
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// =================
+//  x86-64 Emitter
+// =================
+
+// Only what the compiler below needs, every memory operand is [base + disp32]
+class scX64Emitter {
+public:
+    enum : uint8_t {
+        RAX = 0,
+        RBX = 3,
+        RSP = 4,
+        RSI = 6,
+        RDI = 7,
+        R13 = 13,
+    };
+
+protected:
+    std::vector<uint8_t> _code {};
+
+    void Rex(bool w, int reg, int base) {
+        uint8_t rex = 0x40 | (w ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((base & 8) ? 0x01 : 0);
+
+        if (rex != 0x40)
+            Byte(rex);
+    }
+
+    void ModRMDisp32(int reg, int base, int32_t disp) {
+        Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        Value(disp);
+    }
+
+    void ModRMReg(int reg, int rm) {
+        Byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+public:
+    [[nodiscard]]
+    const std::vector<uint8_t>& GetCode() const {
+        return _code;
+    }
+
+    [[nodiscard]]
+    size_t GetPosition() const {
+        return _code.size();
+    }
+
+    void Byte(uint8_t value) {
+        _code.push_back(value);
+    }
+
+    template<typename T>
+    void Value(T value) {
+        uint8_t bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+
+        _code.insert(_code.end(), bytes, bytes + sizeof(T));
+    }
+
+    // ====================
+    //  General Purpose
+    // ====================
+    void Push(int reg) {
+        Rex(false, 0, reg);
+        Byte(0x50 + (reg & 7));
+    }
+
+    void Pop(int reg) {
+        Rex(false, 0, reg);
+        Byte(0x58 + (reg & 7));
+    }
+
+    // mov dst, src (64-bit)
+    void MovRR64(int dst, int src) {
+        Rex(true, src, dst);
+        Byte(0x89);
+        ModRMReg(src, dst);
+    }
+
+    // add / sub rsp, imm8
+    void AdjustStack(int8_t amount) {
+        Byte(0x48);
+        Byte(0x83);
+        Byte(amount < 0 ? 0xEC : 0xC4);
+        Byte(amount < 0 ? -amount : amount);
+    }
+
+    void MovEaxImm32(uint32_t value) {
+        Byte(0xB8);
+        Value(value);
+    }
+
+    void MovRaxImm64(uint64_t value) {
+        Byte(0x48);
+        Byte(0xB8);
+        Value(value);
+    }
+
+    void CallRax() {
+        Byte(0xFF);
+        Byte(0xD0);
+    }
+
+    void Ret() {
+        Byte(0xC3);
+    }
+
+    // mov eax, dword [base + disp]
+    void LoadEax(int base, int32_t disp) {
+        Rex(false, 0, base);
+        Byte(0x8B);
+        ModRMDisp32(RAX, base, disp);
+    }
+
+    // mov dword [base + disp], eax
+    void StoreEax(int base, int32_t disp) {
+        Rex(false, 0, base);
+        Byte(0x89);
+        ModRMDisp32(RAX, base, disp);
+    }
+
+    // mov dword [base + disp], imm32
+    void StoreImm32(int base, int32_t disp, uint32_t value) {
+        Rex(false, 0, base);
+        Byte(0xC7);
+        ModRMDisp32(0, base, disp);
+        Value(value);
+    }
+
+    // and dword [base + disp], imm32
+    void AndImm32(int base, int32_t disp, uint32_t value) {
+        Rex(false, 0, base);
+        Byte(0x81);
+        ModRMDisp32(4, base, disp);
+        Value(value);
+    }
+
+    // jmp rel32, returns the position of the displacement so it can be patched
+    size_t Jmp() {
+        Byte(0xE9);
+        Value<int32_t>(0);
+
+        return _code.size() - sizeof(int32_t);
+    }
+
+    void PatchJmp(size_t at, size_t target) {
+        int32_t rel = (int32_t)(target - (at + sizeof(int32_t)));
+        std::memcpy(_code.data() + at, &rel, sizeof(int32_t));
+    }
+
+    // =====
+    //  SSE
+    // =====
+    enum : uint8_t {
+        SSE_MOV_LOAD = 0x10,
+        SSE_MOV_STORE = 0x11,
+        SSE_AND = 0x54,
+        SSE_ADD = 0x58,
+        SSE_MUL = 0x59,
+        SSE_SUB = 0x5C,
+        SSE_DIV = 0x5E,
+    };
+
+    // <op>ss xmm, dword [base + disp]
+    void ScalarMem(uint8_t op, int xmm, int base, int32_t disp) {
+        Byte(0xF3);
+        Rex(false, xmm, base);
+        Byte(0x0F);
+        Byte(op);
+        ModRMDisp32(xmm, base, disp);
+    }
+
+    // <op>ss dst, src
+    void ScalarReg(uint8_t op, int dst, int src) {
+        Byte(0xF3);
+        Rex(false, dst, src);
+        Byte(0x0F);
+        Byte(op);
+        ModRMReg(dst, src);
+    }
+
+    // andps dst, src
+    void AndPs(int dst, int src) {
+        Rex(false, dst, src);
+        Byte(0x0F);
+        Byte(SSE_AND);
+        ModRMReg(dst, src);
+    }
+
+    // movd xmm, eax
+    void MovdXmmEax(int xmm) {
+        Byte(0x66);
+        Rex(false, xmm, RAX);
+        Byte(0x0F);
+        Byte(0x6E);
+        ModRMReg(xmm, RAX);
+    }
+};
+
+// ==========
+//  Compiler
+// ==========
+
+// xmm0 and xmm1 are scratch and carry the arguments of libm calls, the rest hold pinned registers
+static constexpr int FIRST_PINNED_XMM = 2;
+static constexpr int PINNED_XMM_COUNT = 14;
+
+static constexpr int REGISTER_COUNT = (int)scRegister::REGISTER_COUNT;
+
+static constexpr int REGISTERS_BASE = scX64Emitter::RBX;
+static constexpr int MEMORY_BASE = scX64Emitter::R13;
+
+class scJitCompiler {
+protected:
+    scX64Emitter _emitter;
+
+    size_t _memorySize;
+
+    // XMM register each VM register is pinned to, or -1 if it lives in the register file
+    std::array<int, REGISTER_COUNT> _pinned {};
+    std::vector<int> _pinnedRegisters {};
+
+    std::vector<size_t> _exitPatches {};
+
+    static int32_t Disp(int reg) {
+        return reg * (int32_t)sizeof(scValue_u);
+    }
+
+    void PinRegisters(scSpan<const scInstruction> instructions);
+
+    void SpillPinned();
+
+    void ReloadPinned();
+
+    void EmitExit(uint32_t ip);
+
+    void EmitMov(int a, int b);
+
+    void EmitArithmetic(uint8_t op, int a, int b);
+
+    void EmitLibmCall(float (*pFunction)(float, float), int a, int b);
+
+    void EmitSet(int a, uint32_t bits);
+
+    void EmitLoad(int a, uint32_t address);
+
+    void EmitAbs(int a);
+
+    bool EmitInstruction(const scInstruction& instruction, uint32_t ip);
+
+public:
+    explicit scJitCompiler(size_t memorySize) : _memorySize(memorySize) {
+        _pinned.fill(-1);
+    }
+
+    bool Compile(const scModule& module);
+
+    [[nodiscard]]
+    const std::vector<uint8_t>& GetCode() const {
+        return _emitter.GetCode();
+    }
+};
+
+static int GetInstructionWidth(scOpcode opcode) {
+    return opcode >= scOpcode::AddV4F32 && opcode <= scOpcode::PowV4F32 ? 4 : 1;
+}
+
+// Register fields are only meaningful for operations that use them
+static bool UsesRegisterA(scOpcode opcode) {
+    return opcode != scOpcode::Exit && opcode != scOpcode::Nop;
+}
+
+static bool UsesRegisterB(scOpcode opcode) {
+    return UsesRegisterA(opcode) && opcode <= scOpcode::PowV4F32;
+}
+
+static bool HasValidRegisters(const scInstruction& instruction) {
+    int width = GetInstructionWidth(instruction.opcode);
+
+    if (UsesRegisterA(instruction.opcode) && (int)instruction.a + width > REGISTER_COUNT)
+        return false;
+
+    if (UsesRegisterB(instruction.opcode) && (int)instruction.b + width > REGISTER_COUNT)
+        return false;
+
+    return true;
+}
+
+void scJitCompiler::PinRegisters(scSpan<const scInstruction> instructions) {
+    std::array<int, REGISTER_COUNT> uses {};
+
+    for (const scInstruction& instruction : instructions) {
+        int width = GetInstructionWidth(instruction.opcode);
+
+        for (int d = 0; d < width; d++) {
+            if (UsesRegisterA(instruction.opcode))
+                uses[(int)instruction.a + d]++;
+
+            if (UsesRegisterB(instruction.opcode))
+                uses[(int)instruction.b + d]++;
+        }
+    }
+
+    // SP and IP are never pinned, the rest go in order of use
+    std::vector<int> candidates;
+
+    for (int r = (int)scRegister::FB0; r < REGISTER_COUNT; r++) {
+        if (uses[r] > 0)
+            candidates.push_back(r);
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [&](int lhs, int rhs) {
+        return uses[lhs] > uses[rhs];
+    });
+
+    if (candidates.size() > PINNED_XMM_COUNT)
+        candidates.resize(PINNED_XMM_COUNT);
+
+    for (int r : candidates) {
+        _pinned[r] = FIRST_PINNED_XMM + (int)_pinnedRegisters.size();
+        _pinnedRegisters.push_back(r);
+    }
+}
+
+void scJitCompiler::SpillPinned() {
+    for (int r : _pinnedRegisters)
+        _emitter.ScalarMem(scX64Emitter::SSE_MOV_STORE, _pinned[r], REGISTERS_BASE, Disp(r));
+}
+
+void scJitCompiler::ReloadPinned() {
+    for (int r : _pinnedRegisters)
+        _emitter.ScalarMem(scX64Emitter::SSE_MOV_LOAD, _pinned[r], REGISTERS_BASE, Disp(r));
+}
+
+void scJitCompiler::EmitExit(uint32_t ip) {
+    _emitter.MovEaxImm32(ip);
+    _exitPatches.push_back(_emitter.Jmp());
+}
+
+void scJitCompiler::EmitMov(int a, int b) {
+    int xmmA = _pinned[a];
+    int xmmB = _pinned[b];
+
+    if (xmmA >= 0 && xmmB >= 0) {
+        _emitter.ScalarReg(scX64Emitter::SSE_MOV_LOAD, xmmA, xmmB);
+    } else if (xmmA >= 0) {
+        _emitter.ScalarMem(scX64Emitter::SSE_MOV_LOAD, xmmA, REGISTERS_BASE, Disp(b));
+    } else if (xmmB >= 0) {
+        _emitter.ScalarMem(scX64Emitter::SSE_MOV_STORE, xmmB, REGISTERS_BASE, Disp(a));
+    } else {
+        _emitter.LoadEax(REGISTERS_BASE, Disp(b));
+        _emitter.StoreEax(REGISTERS_BASE, Disp(a));
+    }
+}
+
+void scJitCompiler::EmitArithmetic(uint8_t op, int a, int b) {
+    int xmmA = _pinned[a] >= 0 ? _pinned[a] : 0;
+    int xmmB = _pinned[b];
+
+    if (_pinned[a] < 0)
+        _emitter.ScalarMem(scX64Emitter::SSE_MOV_LOAD, xmmA, REGISTERS_BASE, Disp(a));
+
+    // b is read after a is loaded, so a == b still sees the same value twice
+    if (xmmB >= 0)
+        _emitter.ScalarReg(op, xmmA, xmmB);
+    else
+        _emitter.ScalarMem(op, xmmA, REGISTERS_BASE, Disp(b));
+
+    if (_pinned[a] < 0)
+        _emitter.ScalarMem(scX64Emitter::SSE_MOV_STORE, xmmA, REGISTERS_BASE, Disp(a));
+}
+
+void scJitCompiler::EmitLibmCall(float (*pFunction)(float, float), int a, int b) {
+    // Every XMM register is caller saved, so the pinned ones go back to the register file around the call
+    SpillPinned();
+
+    _emitter.ScalarMem(scX64Emitter::SSE_MOV_LOAD, 0, REGISTERS_BASE, Disp(a));
+    _emitter.ScalarMem(scX64Emitter::SSE_MOV_LOAD, 1, REGISTERS_BASE, Disp(b));
+
+    _emitter.MovRaxImm64(reinterpret_cast<uint64_t>(pFunction));
+    _emitter.CallRax();
+
+    _emitter.ScalarMem(scX64Emitter::SSE_MOV_STORE, 0, REGISTERS_BASE, Disp(a));
+
+    ReloadPinned();
+}
+
+void scJitCompiler::EmitSet(int a, uint32_t bits) {
+    if (_pinned[a] >= 0) {
+        _emitter.MovEaxImm32(bits);
+        _emitter.MovdXmmEax(_pinned[a]);
+    } else {
+        _emitter.StoreImm32(REGISTERS_BASE, Disp(a), bits);
+    }
+}
+
+void scJitCompiler::EmitLoad(int a, uint32_t address) {
+    int xmmA = _pinned[a] >= 0 ? _pinned[a] : 0;
+
+    _emitter.ScalarMem(scX64Emitter::SSE_MOV_LOAD, xmmA, MEMORY_BASE, (int32_t)address);
+
+    if (_pinned[a] < 0)
+        _emitter.ScalarMem(scX64Emitter::SSE_MOV_STORE, xmmA, REGISTERS_BASE, Disp(a));
+}
+
+void scJitCompiler::EmitAbs(int a) {
+    if (_pinned[a] >= 0) {
+        _emitter.MovEaxImm32(0x7FFFFFFF);
+        _emitter.MovdXmmEax(0);
+        _emitter.AndPs(_pinned[a], 0);
+    } else {
+        _emitter.AndImm32(REGISTERS_BASE, Disp(a), 0x7FFFFFFF);
+    }
+}
+
+static float JitFmod(float a, float b) {
+    return std::fmod(a, b);
+}
+
+static float JitPow(float a, float b) {
+    return powf(a, b);
+}
+
+bool scJitCompiler::EmitInstruction(const scInstruction& instruction, uint32_t ip) {
+    int a = (int)instruction.a;
+    int b = (int)instruction.b;
+
+    int width = GetInstructionWidth(instruction.opcode);
+
+    switch (instruction.opcode) {
+        case scOpcode::Exit:
+            EmitExit(ip + 1);
+            return true;
+
+        case scOpcode::Nop:
+            return true;
+
+        case scOpcode::Mov:
+            EmitMov(a, b);
+            return true;
+
+        case scOpcode::AddF32:
+        case scOpcode::AddV4F32:
+            for (int d = 0; d < width; d++)
+                EmitArithmetic(scX64Emitter::SSE_ADD, a + d, b + d);
+
+            return true;
+
+        case scOpcode::SubF32:
+        case scOpcode::SubV4F32:
+            for (int d = 0; d < width; d++)
+                EmitArithmetic(scX64Emitter::SSE_SUB, a + d, b + d);
+
+            return true;
+
+        case scOpcode::MulF32:
+        case scOpcode::MulV4F32:
+            for (int d = 0; d < width; d++)
+                EmitArithmetic(scX64Emitter::SSE_MUL, a + d, b + d);
+
+            return true;
+
+        case scOpcode::DivF32:
+        case scOpcode::DivV4F32:
+            for (int d = 0; d < width; d++)
+                EmitArithmetic(scX64Emitter::SSE_DIV, a + d, b + d);
+
+            return true;
+
+        case scOpcode::ModF32:
+        case scOpcode::ModV4F32:
+            for (int d = 0; d < width; d++)
+                EmitLibmCall(JitFmod, a + d, b + d);
+
+            return true;
+
+        case scOpcode::PowF32:
+        case scOpcode::PowV4F32:
+            for (int d = 0; d < width; d++)
+                EmitLibmCall(JitPow, a + d, b + d);
+
+            return true;
+
+        case scOpcode::SetF32:
+            EmitSet(a, instruction.immediate.u32);
+            return true;
+
+        case scOpcode::LoadF32:
+        case scOpcode::LoadF32Unchecked: {
+            // Bound checked here once instead of on every execution
+            if ((uint64_t)instruction.immediate.u32 + sizeof(float) > _memorySize || instruction.immediate.u32 > INT32_MAX) {
+                EmitExit(ip + 1);
+                return true;
+            }
+
+            EmitLoad(a, instruction.immediate.u32);
+            return true;
+        }
+
+        case scOpcode::AbsF32:
+            EmitAbs(a);
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool scJitCompiler::Compile(const scModule& module) {
+    scSpan<const scInstruction> instructions = module.GetInstructions();
+
+    // Anything touching a register outside the register file is left to the interpreter
+    for (const scInstruction& instruction : instructions) {
+        if (!HasValidRegisters(instruction))
+            return false;
+    }
+
+    PinRegisters(instructions);
+
+    // rbx holds the register file and r13 the memory, both survive libm calls
+    // Two pushes and 8 bytes realign the stack to 16 for those calls
+    _emitter.Push(scX64Emitter::RBX);
+    _emitter.Push(scX64Emitter::R13);
+    _emitter.AdjustStack(-8);
+
+    _emitter.MovRR64(REGISTERS_BASE, scX64Emitter::RDI);
+    _emitter.MovRR64(MEMORY_BASE, scX64Emitter::RSI);
+
+    ReloadPinned();
+
+    for (uint32_t ip = 0; ip < instructions.size(); ip++) {
+        if (!EmitInstruction(instructions[ip], ip))
+            return false;
+    }
+
+    // Everything leaves through here with the final IP in eax
+    size_t epilogue = _emitter.GetPosition();
+
+    for (size_t patch : _exitPatches)
+        _emitter.PatchJmp(patch, epilogue);
+
+    SpillPinned();
+
+    _emitter.AdjustStack(8);
+    _emitter.Pop(scX64Emitter::R13);
+    _emitter.Pop(scX64Emitter::RBX);
+    _emitter.Ret();
+
+    return true;
+}
+
+#endif
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scJitProgram::~scJitProgram() {
+#ifdef SCHISM_HAS_JIT
+    if (_pCode != nullptr)
+        munmap(_pCode, _mappingSize);
+#endif
+}
+
+// =============
+//  Compilation
+// =============
+bool scJitProgram::IsSupported() {
+#ifdef SCHISM_HAS_JIT
+    return scGetCpuFeatures().sse2;
+#else
+    return false;
+#endif
+}
+
+std::shared_ptr<const scJitProgram> scJitProgram::Compile(const scModule& module, size_t memorySize) {
+#ifdef SCHISM_HAS_JIT
+    if (!IsSupported())
+        return nullptr;
+
+    scJitCompiler compiler(memorySize);
+
+    if (!compiler.Compile(module))
+        return nullptr;
+
+    const std::vector<uint8_t>& code = compiler.GetCode();
+
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mappingSize = (code.size() + pageSize - 1) / pageSize * pageSize;
+
+    void* pCode = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (pCode == MAP_FAILED)
+        return nullptr;
+
+    std::memcpy(pCode, code.data(), code.size());
+
+    // Never writable and executable at the same time
+    if (mprotect(pCode, mappingSize, PROT_READ | PROT_EXEC) != 0) {
+        munmap(pCode, mappingSize);
+        return nullptr;
+    }
+
+    std::shared_ptr<scJitProgram> program(new scJitProgram());
+
+    program->_pCode = pCode;
+    program->_codeSize = code.size();
+    program->_mappingSize = mappingSize;
+
+    return program;
+#else
+    return nullptr;
+#endif
+}
@@ -0,0 +1,90 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_JIT_HPP
+#define SCHISM_SC_JIT_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+#include <memory>
+
+#include <schism/sc_cpu.hpp>
+#include <schism/sc_module.hpp>
+#include <schism/sc_operations.hpp>
+
+// The generated code follows the System V calling convention, so the JIT is limited to x86-64 Linux and macOS
+#if defined(SCHISM_ARCH_X86_64) && (defined(__linux__) || defined(__APPLE__))
+#define SCHISM_HAS_JIT 1
+#endif
+
+// Runs a compiled module from the first instruction until it stops
+//   - Returns the instruction pointer one past the instruction that stopped the program, the same as the interpreter
+typedef uint32_t (*scJitFunction)(scValue_u* pRegisters, const uint8_t* pMemory);
+
+// Native x86-64 code compiled from a scModule
+//   - The code lives in its own mapping, which is writable while it is generated and executable afterwards
+//   - Memory loads are checked against memorySize once while compiling, out of range loads compile to a stop
+class scJitProgram {
+protected:
+    void* _pCode = nullptr;
+    size_t _codeSize = 0;
+    size_t _mappingSize = 0;
+
+    scJitProgram() = default;
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    ~scJitProgram();
+
+    scJitProgram(const scJitProgram&) = delete;
+    scJitProgram& operator=(const scJitProgram&) = delete;
+
+public:
+    static bool IsSupported();
+
+    // Returns nullptr if the host is unsupported or the module contains something the JIT can't compile
+    static std::shared_ptr<const scJitProgram> Compile(const scModule& module, size_t memorySize);
+
+    [[nodiscard]]
+    scJitFunction GetFunction() const {
+        return reinterpret_cast<scJitFunction>(_pCode);
+    }
+
+    [[nodiscard]]
+    size_t GetCodeSize() const {
+        return _codeSize;
+    }
+};
+
+#endif //SCHISM_SC_JIT_HPP
@@ -0,0 +1,138 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_mapped_file.hpp"
+
+#ifdef _WIN32
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+
+#else
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#endif
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scMappedFile::~scMappedFile() {
+#ifdef _WIN32
+    if (_pData != nullptr)
+        UnmapViewOfFile(_pData);
+
+    if (_hMapping != nullptr)
+        CloseHandle(_hMapping);
+
+    if (_hFile != nullptr)
+        CloseHandle(_hFile);
+#else
+    if (_pData != nullptr)
+        munmap(const_cast<uint8_t*>(_pData), _size);
+#endif
+}
+
+// =========
+//  Mapping
+// =========
+scMappedFileState scMappedFile::Open(const std::string& path, std::shared_ptr<const scMappedFile>& outFile) {
+    std::shared_ptr<scMappedFile> file = std::make_shared<scMappedFile>();
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (hFile == INVALID_HANDLE_VALUE)
+        return scMappedFileState::FileNotFound;
+
+    file->_hFile = hFile;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(hFile, &size))
+        return scMappedFileState::MapFailed;
+
+    if (size.QuadPart == 0)
+        return scMappedFileState::FileEmpty;
+
+    file->_hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (file->_hMapping == nullptr)
+        return scMappedFileState::MapFailed;
+
+    file->_pData = static_cast<const uint8_t*>(MapViewOfFile(file->_hMapping, FILE_MAP_READ, 0, 0, 0));
+
+    if (file->_pData == nullptr)
+        return scMappedFileState::MapFailed;
+
+    file->_size = (size_t)size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return scMappedFileState::FileNotFound;
+
+    struct stat info {};
+
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return scMappedFileState::MapFailed;
+    }
+
+    if (info.st_size == 0) {
+        close(fd);
+        return scMappedFileState::FileEmpty;
+    }
+
+    // The mapping keeps its own reference to the file
+    void* pData = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (pData == MAP_FAILED)
+        return scMappedFileState::MapFailed;
+
+    file->_pData = static_cast<const uint8_t*>(pData);
+    file->_size = (size_t)info.st_size;
+#endif
+
+    outFile = std::move(file);
+    return scMappedFileState::OK;
+}
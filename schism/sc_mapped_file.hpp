@@ -0,0 +1,89 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_MAPPED_FILE_HPP
+#define SCHISM_SC_MAPPED_FILE_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+#include <string>
+#include <memory>
+
+#include <schism/sc_span.hpp>
+
+// enum scMappedFileState
+//   - Result of scMappedFile::Open
+enum class scMappedFileState {
+    OK = 0,
+
+    FileNotFound,
+
+    // Empty files can't be mapped
+    FileEmpty,
+
+    MapFailed,
+};
+
+// A whole file mapped read only into memory
+//   - Pages are shared with every other process mapping the same file and only read in once touched
+//   - The mapping lives as long as the object, share it to keep views into it valid
+class scMappedFile {
+protected:
+    const uint8_t* _pData = nullptr;
+    size_t _size = 0;
+
+#ifdef _WIN32
+    void* _hFile = nullptr;
+    void* _hMapping = nullptr;
+#endif
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    scMappedFile() = default;
+
+    scMappedFile(const scMappedFile&) = delete;
+    scMappedFile& operator=(const scMappedFile&) = delete;
+
+    ~scMappedFile();
+
+public:
+    static scMappedFileState Open(const std::string& path, std::shared_ptr<const scMappedFile>& outFile);
+
+    [[nodiscard]]
+    scSpan<const uint8_t> GetBytes() const {
+        return { _pData, _size };
+    }
+};
+
+#endif //SCHISM_SC_MAPPED_FILE_HPP
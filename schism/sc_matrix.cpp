@@ -0,0 +1,244 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_matrix.hpp"
+
+#include <algorithm>
+
+#include <schism/sc_cpu.hpp>
+
+#ifdef SCHISM_ARCH_X86
+#include <immintrin.h>
+#endif
+
+// =================
+//  Generic Kernels
+// =================
+static void Generic_MulMatrixVector(float* pVector, const float* pMatrix) {
+    float result[4];
+
+    for (int i = 0; i < 4; i++)
+        result[i] = pMatrix[i * 4] * pVector[0] + pMatrix[i * 4 + 1] * pVector[1] + pMatrix[i * 4 + 2] * pVector[2] + pMatrix[i * 4 + 3] * pVector[3];
+
+    std::copy(result, result + 4, pVector);
+}
+
+static void Generic_MulMatrixMatrix(float* pA, const float* pB) {
+    float result[16];
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++)
+            result[i * 4 + j] = pA[i * 4] * pB[j] + pA[i * 4 + 1] * pB[4 + j] + pA[i * 4 + 2] * pB[8 + j] + pA[i * 4 + 3] * pB[12 + j];
+    }
+
+    std::copy(result, result + 16, pA);
+}
+
+static void Generic_TransposeMatrix(float* pMatrix) {
+    for (int i = 0; i < 4; i++) {
+        for (int j = i + 1; j < 4; j++)
+            std::swap(pMatrix[i * 4 + j], pMatrix[j * 4 + i]);
+    }
+}
+
+static void Generic_Dot(float* pA, const float* pB, int count) {
+    float dot = 0;
+
+    for (int d = 0; d < count; d++)
+        dot += pA[d] * pB[d];
+
+    std::fill(pA, pA + 4, dot);
+}
+
+static void Generic_Cross(float* pA, const float* pB) {
+    float x = pA[1] * pB[2] - pA[2] * pB[1];
+    float y = pA[2] * pB[0] - pA[0] * pB[2];
+    float z = pA[0] * pB[1] - pA[1] * pB[0];
+
+    pA[0] = x;
+    pA[1] = y;
+    pA[2] = z;
+}
+
+#ifdef SCHISM_ARCH_X86
+// ==============
+//  SSE2 Kernels
+// ==============
+
+// Registers are only 4 byte aligned
+SC_TARGET("sse2") static inline __m128 SSE2_Broadcast(__m128 value, int component) {
+    switch (component) {
+        case 0:
+            return _mm_shuffle_ps(value, value, _MM_SHUFFLE(0, 0, 0, 0));
+
+        case 1:
+            return _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 1, 1, 1));
+
+        case 2:
+            return _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 2, 2, 2));
+
+        default:
+            return _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+}
+
+// Sum of the 4 components in every component
+SC_TARGET("sse2") static inline __m128 SSE2_HorizontalSum(__m128 value) {
+    __m128 pairs = _mm_add_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_ps(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+// The columns of the matrix weighted by the components of the vector
+SC_TARGET("sse2") static void SSE2_MulMatrixVector(float* pVector, const float* pMatrix) {
+    __m128 c0 = _mm_loadu_ps(pMatrix);
+    __m128 c1 = _mm_loadu_ps(pMatrix + 4);
+    __m128 c2 = _mm_loadu_ps(pMatrix + 8);
+    __m128 c3 = _mm_loadu_ps(pMatrix + 12);
+
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    __m128 vector = _mm_loadu_ps(pVector);
+
+    __m128 result = _mm_mul_ps(c0, SSE2_Broadcast(vector, 0));
+    result = _mm_add_ps(result, _mm_mul_ps(c1, SSE2_Broadcast(vector, 1)));
+    result = _mm_add_ps(result, _mm_mul_ps(c2, SSE2_Broadcast(vector, 2)));
+    result = _mm_add_ps(result, _mm_mul_ps(c3, SSE2_Broadcast(vector, 3)));
+
+    _mm_storeu_ps(pVector, result);
+}
+
+// Row i of the result is the rows of B weighted by row i of A
+SC_TARGET("sse2") static void SSE2_MulMatrixMatrix(float* pA, const float* pB) {
+    __m128 b[4];
+
+    for (int k = 0; k < 4; k++)
+        b[k] = _mm_loadu_ps(pB + k * 4);
+
+    for (int i = 0; i < 4; i++) {
+        __m128 row = _mm_loadu_ps(pA + i * 4);
+
+        __m128 result = _mm_mul_ps(b[0], SSE2_Broadcast(row, 0));
+        result = _mm_add_ps(result, _mm_mul_ps(b[1], SSE2_Broadcast(row, 1)));
+        result = _mm_add_ps(result, _mm_mul_ps(b[2], SSE2_Broadcast(row, 2)));
+        result = _mm_add_ps(result, _mm_mul_ps(b[3], SSE2_Broadcast(row, 3)));
+
+        _mm_storeu_ps(pA + i * 4, result);
+    }
+}
+
+SC_TARGET("sse2") static void SSE2_TransposeMatrix(float* pMatrix) {
+    __m128 r0 = _mm_loadu_ps(pMatrix);
+    __m128 r1 = _mm_loadu_ps(pMatrix + 4);
+    __m128 r2 = _mm_loadu_ps(pMatrix + 8);
+    __m128 r3 = _mm_loadu_ps(pMatrix + 12);
+
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    _mm_storeu_ps(pMatrix, r0);
+    _mm_storeu_ps(pMatrix + 4, r1);
+    _mm_storeu_ps(pMatrix + 8, r2);
+    _mm_storeu_ps(pMatrix + 12, r3);
+}
+
+SC_TARGET("sse2") static void SSE2_Dot(float* pA, const float* pB, int count) {
+    __m128 product = _mm_mul_ps(_mm_loadu_ps(pA), _mm_loadu_ps(pB));
+
+    // Dot3 drops the 4th component
+    if (count == 3)
+        product = _mm_and_ps(product, _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)));
+
+    _mm_storeu_ps(pA, SSE2_HorizontalSum(product));
+}
+
+// A.yzx * B.zxy - A.zxy * B.yzx, with the 4th component of A put back
+SC_TARGET("sse2") static void SSE2_Cross(float* pA, const float* pB) {
+    __m128 a = _mm_loadu_ps(pA);
+    __m128 b = _mm_loadu_ps(pB);
+
+    __m128 aYzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 aZxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 bYzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 bZxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+
+    __m128 cross = _mm_sub_ps(_mm_mul_ps(aYzx, bZxy), _mm_mul_ps(aZxy, bYzx));
+
+    // Lowest 3 from the cross product, the 4th from A
+    __m128 mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    _mm_storeu_ps(pA, _mm_or_ps(_mm_and_ps(mask, cross), _mm_andnot_ps(mask, a)));
+}
+#endif
+
+// =========
+//  Kernels
+// =========
+#ifdef SCHISM_ARCH_X86
+#define SC_DISPATCH_SSE2(CALL)                          \
+    static const bool sse2 = scGetCpuFeatures().sse2;   \
+                                                        \
+    if (sse2) {                                         \
+        SSE2_##CALL;                                    \
+        return;                                         \
+    }
+#else
+#define SC_DISPATCH_SSE2(CALL)
+#endif
+
+void scMulMatrixVector(float* pVector, const float* pMatrix) {
+    SC_DISPATCH_SSE2(MulMatrixVector(pVector, pMatrix))
+    Generic_MulMatrixVector(pVector, pMatrix);
+}
+
+void scMulMatrixMatrix(float* pA, const float* pB) {
+    SC_DISPATCH_SSE2(MulMatrixMatrix(pA, pB))
+    Generic_MulMatrixMatrix(pA, pB);
+}
+
+void scTransposeMatrix(float* pMatrix) {
+    SC_DISPATCH_SSE2(TransposeMatrix(pMatrix))
+    Generic_TransposeMatrix(pMatrix);
+}
+
+void scDot3(float* pA, const float* pB) {
+    SC_DISPATCH_SSE2(Dot(pA, pB, 3))
+    Generic_Dot(pA, pB, 3);
+}
+
+void scDot4(float* pA, const float* pB) {
+    SC_DISPATCH_SSE2(Dot(pA, pB, 4))
+    Generic_Dot(pA, pB, 4);
+}
+
+void scCross(float* pA, const float* pB) {
+    SC_DISPATCH_SSE2(Cross(pA, pB))
+    Generic_Cross(pA, pB);
+}
+
+#undef SC_DISPATCH_SSE2
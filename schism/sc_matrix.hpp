@@ -0,0 +1,55 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_MATRIX_HPP
+#define SCHISM_SC_MATRIX_HPP
+
+// Kernels behind the group three instructions of scVM
+//   - A vector is 4 consecutive floats, a matrix is 4 row vectors
+//   - Every input is read before the result is written, so A and B may overlap
+
+// pVector = pMatrix * pVector
+extern void scMulMatrixVector(float* pVector, const float* pMatrix);
+
+// pA = pA * pB
+extern void scMulMatrixMatrix(float* pA, const float* pB);
+
+extern void scTransposeMatrix(float* pMatrix);
+
+// Every component of pA is set to the product
+extern void scDot3(float* pA, const float* pB);
+
+extern void scDot4(float* pA, const float* pB);
+
+// The first 3 components of pA are set to pA x pB, the 4th is left alone
+extern void scCross(float* pA, const float* pB);
+
+#endif //SCHISM_SC_MATRIX_HPP
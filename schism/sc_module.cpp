@@ -31,25 +31,670 @@
 
 #include "sc_module.hpp"
 
-#include <fstream>
+#include <schism/sc_mapped_file.hpp>
+#include <schism/sc_texture.hpp>
 
+#include <algorithm>
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scModule::scModule(const std::vector<uint8_t>& code, scModuleType type) {
+    std::shared_ptr<const std::vector<uint8_t>> storage = std::make_shared<const std::vector<uint8_t>>(code);
+
+    _code = { storage->data(), storage->size() };
+    _storage = std::move(storage);
+    _type = type;
+
+    Decode();
+}
+
+scModule::scModule(const scModule& source, const std::vector<scInstruction>& instructions) {
+    _storage = source._storage;
+    _code = source._code;
+    _type = source._type;
+
+    _verified = source._verified;
+    _requiredMemory = source._requiredMemory;
+
+    _instructions = instructions;
+}
+
+// =========
+//  Loading
+// =========
 scModuleState scModule::LoadFromFile(const std::string& path) {
-    std::ifstream file(path, std::ifstream::binary);
+    std::shared_ptr<const scMappedFile> file;
+
+    switch (scMappedFile::Open(path, file)) {
+        case scMappedFileState::OK:
+            break;
 
-    if (!file.is_open())
-        return scModuleState::FileNotFound;
+        case scMappedFileState::FileNotFound:
+            return scModuleState::FileNotFound;
+
+        default:
+            return scModuleState::FileCorrupt;
+    }
+
+    scSpan<const uint8_t> bytes = file->GetBytes();
+
+    constexpr size_t HEADER_SIZE = sizeof(scMagicType) + sizeof(scModuleHeader_t);
+
+    if (bytes.size() < HEADER_SIZE)
+        return scModuleState::FileCorrupt;
 
     scMagicType magic;
-    file.read(reinterpret_cast<char*>(&magic), sizeof(scMagicType));
+    std::memcpy(&magic, bytes.data(), sizeof(scMagicType));
 
     if (magic != scMagicType::SC_MAGIC_MODULE)
         return scModuleState::FileCorrupt;
 
     scModuleHeader_t header {};
-    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    std::memcpy(&header, bytes.data() + sizeof(scMagicType), sizeof(header));
 
-    _code.resize(header.len);
-    file.read(reinterpret_cast<char*>(_code.data()), header.len);
+    if (header.type != scModuleType::Vertex && header.type != scModuleType::Fragment)
+        return scModuleState::InvalidModuleType;
+
+    if (header.len != bytes.size() - HEADER_SIZE)
+        return scModuleState::LengthMismatch;
+
+    _code = { bytes.data() + HEADER_SIZE, header.len };
+    _storage = std::move(file);
+    _type = header.type;
+
+    Decode();
 
     return scModuleState::OK;
 }
+
+// V registers alias 4 consecutive scalar registers, anything else is returned as is
+static scRegister ResolveVectorRegister(scRegister reg) {
+    if (reg >= scRegister::V0 && reg <= scRegister::V7)
+        return (scRegister)((int)scRegister::S0 + ((int)reg - (int)scRegister::V0) * 4);
+
+    return reg;
+}
+
+// M registers alias 16 consecutive scalar registers
+static scRegister ResolveMatrixRegister(scRegister reg) {
+    if (reg >= scRegister::M0 && reg <= scRegister::M1)
+        return (scRegister)((int)scRegister::S0 + ((int)reg - (int)scRegister::M0) * 16);
+
+    return reg;
+}
+
+void scModule::Decode() {
+    _instructions.clear();
+    _instructions.reserve(_code.size() / sizeof(uint32_t) + 1);
+
+    uint32_t cur = 0;
+    uint32_t encoded;
+
+    while (ReadValue(cur, encoded) == scModuleState::OK) {
+        scInstruction instruction {};
+
+        instruction.opcode = scOpcode::Nop;
+        instruction.size = sizeof(uint32_t);
+        instruction.offset = cur;
+
+        scInstructionGroup group = (scInstructionGroup)(encoded & 0xF);
+
+        switch (group) {
+            case scInstructionGroup::GroupZero: {
+                scGroupZeroOperations op = (scGroupZeroOperations)((encoded >> 4) & 0xFF);
+
+                if (op == scGroupZeroOperations::OpExitProgram)
+                    instruction.opcode = scOpcode::Exit;
+                else if (op == scGroupZeroOperations::OpDiscard)
+                    instruction.opcode = scOpcode::Discard;
+
+                break;
+            }
+
+            case scInstructionGroup::GroupOne: {
+                scGroupOneOperations op = (scGroupOneOperations)((encoded >> 4) & 0xFF);
+                scGroupOneSubOperations subOp = (scGroupOneSubOperations)((encoded >> 12) & 0xF);
+
+                instruction.a = (scRegister)((encoded >> 16) & 0xFF);
+                instruction.b = (scRegister)((encoded >> 24) & 0xFF);
+
+                if (op == scGroupOneOperations::OpMOV) {
+                    instruction.opcode = scOpcode::Mov;
+                    break;
+                }
+
+                if (op != scGroupOneOperations::OpALUF32F32)
+                    break;
+
+                if (subOp > scGroupOneSubOperations::SubOpPow)
+                    break;
+
+                // A V register in either position makes the operation 4 wide, a scalar register on the other side is
+                // the first of 4 consecutive ones
+                scRegister a = ResolveVectorRegister(instruction.a);
+                scRegister b = ResolveVectorRegister(instruction.b);
+
+                bool simd = a != instruction.a || b != instruction.b;
+
+                instruction.a = a;
+                instruction.b = b;
+
+                scOpcode base = simd ? scOpcode::AddV4F32 : scOpcode::AddF32;
+                instruction.opcode = (scOpcode)((int)base + (int)subOp);
+
+                break;
+            }
+
+            case scInstructionGroup::GroupTwo: {
+                scGroupTwoOperations op = (scGroupTwoOperations)((encoded >> 4) & 0xFF);
+
+                instruction.a = (scRegister)((encoded >> 12) & 0xFF);
+
+                switch (op) {
+                    case scGroupTwoOperations::OpSetF32:
+                    case scGroupTwoOperations::OpLoadF32: {
+                        // A truncated immediate ends the program, the same as running off the end of the code
+                        if (ReadValue(cur + sizeof(uint32_t), instruction.immediate.u32) != scModuleState::OK) {
+                            cur = _code.size();
+                            continue;
+                        }
+
+                        instruction.opcode = op == scGroupTwoOperations::OpSetF32 ? scOpcode::SetF32 : scOpcode::LoadF32;
+                        instruction.size += sizeof(uint32_t);
+                        break;
+                    }
+
+                    case scGroupTwoOperations::OpABSF32:
+                        instruction.opcode = scOpcode::AbsF32;
+                        break;
+
+                    case scGroupTwoOperations::OpSamplePoint:
+                    case scGroupTwoOperations::OpSampleLinear: {
+                        if (ReadValue(cur + sizeof(uint32_t), instruction.immediate.u32) != scModuleState::OK) {
+                            cur = _code.size();
+                            continue;
+                        }
+
+                        instruction.opcode = op == scGroupTwoOperations::OpSamplePoint ? scOpcode::SamplePoint : scOpcode::SampleLinear;
+                        instruction.size += sizeof(uint32_t);
+
+                        instruction.a = ResolveVectorRegister(instruction.a);
+                        instruction.b = ResolveVectorRegister((scRegister)((encoded >> 20) & 0xFF));
+                        break;
+                    }
+                }
+
+                break;
+            }
+
+            // An operand of the wrong kind keeps its alias, which is out of range for the verifier
+            case scInstructionGroup::GroupThree: {
+                scGroupThreeOperations op = (scGroupThreeOperations)((encoded >> 4) & 0xFF);
+
+                scRegister a = (scRegister)((encoded >> 16) & 0xFF);
+                scRegister b = (scRegister)((encoded >> 24) & 0xFF);
+
+                switch (op) {
+                    case scGroupThreeOperations::OpMatMulVec:
+                        instruction.opcode = scOpcode::MulM4V4;
+                        instruction.a = ResolveVectorRegister(a);
+                        instruction.b = ResolveMatrixRegister(b);
+                        break;
+
+                    case scGroupThreeOperations::OpMatMulMat:
+                        instruction.opcode = scOpcode::MulM4M4;
+                        instruction.a = ResolveMatrixRegister(a);
+                        instruction.b = ResolveMatrixRegister(b);
+                        break;
+
+                    case scGroupThreeOperations::OpMatTranspose:
+                        instruction.opcode = scOpcode::TransposeM4;
+                        instruction.a = ResolveMatrixRegister(a);
+                        break;
+
+                    case scGroupThreeOperations::OpVecDot3:
+                    case scGroupThreeOperations::OpVecDot4:
+                    case scGroupThreeOperations::OpVecCross:
+                        instruction.opcode = (scOpcode)((int)scOpcode::Dot3V4 + ((int)op - (int)scGroupThreeOperations::OpVecDot3));
+                        instruction.a = ResolveVectorRegister(a);
+                        instruction.b = ResolveVectorRegister(b);
+                        break;
+                }
+
+                break;
+            }
+
+            case scInstructionGroup::GroupFour: {
+                scGroupFourOperations op = (scGroupFourOperations)((encoded >> 4) & 0xFF);
+
+                instruction.a = (scRegister)((encoded >> 12) & 0xFF);
+                instruction.b = (scRegister)((encoded >> 20) & 0xFF);
+
+                if (op <= scGroupFourOperations::OpCmpNe) {
+                    instruction.opcode = (scOpcode)((int)scOpcode::CmpLtF32 + (int)op);
+                    break;
+                }
+
+                if (op == scGroupFourOperations::OpDiscardNotZero) {
+                    instruction.opcode = scOpcode::DiscardNotZero;
+                    break;
+                }
+
+                if (op > scGroupFourOperations::OpLoop)
+                    break;
+
+                // Branch targets are byte offsets here, they're turned into displacements once every instruction is known
+                if (ReadValue(cur + sizeof(uint32_t), instruction.immediate.u32) != scModuleState::OK) {
+                    cur = _code.size();
+                    continue;
+                }
+
+                if (op == scGroupFourOperations::OpSelect)
+                    instruction.opcode = scOpcode::SelectF32;
+                else
+                    instruction.opcode = (scOpcode)((int)scOpcode::Jump + ((int)op - (int)scGroupFourOperations::OpJump));
+
+                instruction.size += sizeof(uint32_t);
+                break;
+            }
+        }
+
+        cur += instruction.size;
+        _instructions.push_back(instruction);
+    }
+
+    scInstruction terminator {};
+
+    terminator.opcode = scOpcode::Exit;
+    terminator.offset = _code.size();
+
+    _instructions.push_back(terminator);
+
+    // A target in the middle of an instruction goes to the terminator instead, so unverified code still stops
+    for (size_t i = 0; i < _instructions.size(); i++) {
+        scInstruction& instruction = _instructions[i];
+
+        if (!scIsBranchOpcode(instruction.opcode))
+            continue;
+
+        auto target = std::lower_bound(_instructions.begin(), _instructions.end(), instruction.immediate.u32, [](const scInstruction& lhs, uint32_t offset) {
+            return lhs.offset < offset;
+        });
+
+        if (target == _instructions.end() || target->offset != instruction.immediate.u32)
+            target = _instructions.end() - 1;
+
+        instruction.immediate.i32 = (int32_t)(target - _instructions.begin()) - (int32_t)i;
+    }
+}
+
+// =================
+//  Register Access
+// =================
+bool scGetRegisterAccess(const scInstruction& instruction, scRegisterAccess& outAccess) {
+    int a = (int)instruction.a;
+    int b = (int)instruction.b;
+
+    outAccess = { { a, b, 0 }, { 1, 1, 1 }, 0, a, 1 };
+
+    switch (instruction.opcode) {
+        case scOpcode::Mov:
+            outAccess.reads[0] = b;
+            outAccess.readCount = 1;
+            break;
+
+        case scOpcode::AddF32:
+        case scOpcode::SubF32:
+        case scOpcode::MulF32:
+        case scOpcode::DivF32:
+        case scOpcode::ModF32:
+        case scOpcode::PowF32:
+            outAccess.readCount = 2;
+            break;
+
+        case scOpcode::AddV4F32:
+        case scOpcode::SubV4F32:
+        case scOpcode::MulV4F32:
+        case scOpcode::DivV4F32:
+        case scOpcode::ModV4F32:
+        case scOpcode::PowV4F32:
+            outAccess.readCount = 2;
+            outAccess.readWidths[0] = 4;
+            outAccess.readWidths[1] = 4;
+            outAccess.width = 4;
+            break;
+
+        // U / V and the LOD
+        case scOpcode::SamplePoint:
+        case scOpcode::SampleLinear:
+            outAccess.reads[0] = b;
+            outAccess.readWidths[0] = 2;
+            outAccess.reads[1] = (int)scGetSampleLod(instruction);
+            outAccess.readCount = 2;
+            outAccess.width = 4;
+            break;
+
+        case scOpcode::Dot3V4:
+        case scOpcode::Dot4V4:
+        case scOpcode::CrossV4:
+            outAccess.readCount = 2;
+            outAccess.readWidths[0] = 4;
+            outAccess.readWidths[1] = 4;
+            outAccess.width = 4;
+            break;
+
+        case scOpcode::MulM4V4:
+            outAccess.readCount = 2;
+            outAccess.readWidths[0] = 4;
+            outAccess.readWidths[1] = 16;
+            outAccess.width = 4;
+            break;
+
+        case scOpcode::MulM4M4:
+            outAccess.readCount = 2;
+            outAccess.readWidths[0] = 16;
+            outAccess.readWidths[1] = 16;
+            outAccess.width = 16;
+            break;
+
+        case scOpcode::TransposeM4:
+            outAccess.readCount = 1;
+            outAccess.readWidths[0] = 16;
+            outAccess.width = 16;
+            break;
+
+        case scOpcode::CmpLtF32:
+        case scOpcode::CmpLeF32:
+        case scOpcode::CmpGtF32:
+        case scOpcode::CmpGeF32:
+        case scOpcode::CmpEqF32:
+        case scOpcode::CmpNeF32:
+            outAccess.readCount = 2;
+            break;
+
+        // A is kept where the condition is 0
+        case scOpcode::SelectF32:
+            outAccess.reads[2] = (int)scGetSelectCondition(instruction);
+            outAccess.readCount = 3;
+            break;
+
+        case scOpcode::Jump:
+            outAccess.width = 0;
+            break;
+
+        case scOpcode::BranchZero:
+        case scOpcode::BranchNotZero:
+            outAccess.readCount = 1;
+            outAccess.width = 0;
+            break;
+
+        case scOpcode::Loop:
+            outAccess.readCount = 1;
+            break;
+
+        case scOpcode::Discard:
+            outAccess.width = 0;
+            break;
+
+        case scOpcode::DiscardNotZero:
+            outAccess.readCount = 1;
+            outAccess.width = 0;
+            break;
+
+        case scOpcode::AbsF32:
+            outAccess.readCount = 1;
+            break;
+
+        case scOpcode::SetF32:
+        case scOpcode::LoadF32:
+        case scOpcode::LoadF32Unchecked:
+            break;
+
+        default:
+            return false;
+    }
+
+    for (int r = 0; r < outAccess.readCount; r++) {
+        if (outAccess.reads[r] + outAccess.readWidths[r] > (int)scRegister::REGISTER_COUNT)
+            return false;
+    }
+
+    return outAccess.write + outAccess.width <= (int)scRegister::REGISTER_COUNT;
+}
+
+// ===========
+//  Debugging
+// ===========
+#define ENUM_OPCODE_NAME(OP) case scOpcode::OP: return #OP;
+
+const char* scGetOpcodeName(scOpcode opcode) {
+    switch (opcode) {
+        ENUM_OPCODE_NAME(Exit)
+        ENUM_OPCODE_NAME(Nop)
+        ENUM_OPCODE_NAME(Mov)
+        ENUM_OPCODE_NAME(AddF32)
+        ENUM_OPCODE_NAME(SubF32)
+        ENUM_OPCODE_NAME(MulF32)
+        ENUM_OPCODE_NAME(DivF32)
+        ENUM_OPCODE_NAME(ModF32)
+        ENUM_OPCODE_NAME(PowF32)
+        ENUM_OPCODE_NAME(AddV4F32)
+        ENUM_OPCODE_NAME(SubV4F32)
+        ENUM_OPCODE_NAME(MulV4F32)
+        ENUM_OPCODE_NAME(DivV4F32)
+        ENUM_OPCODE_NAME(ModV4F32)
+        ENUM_OPCODE_NAME(PowV4F32)
+        ENUM_OPCODE_NAME(SetF32)
+        ENUM_OPCODE_NAME(LoadF32)
+        ENUM_OPCODE_NAME(AbsF32)
+        ENUM_OPCODE_NAME(LoadF32Unchecked)
+        ENUM_OPCODE_NAME(SamplePoint)
+        ENUM_OPCODE_NAME(SampleLinear)
+        ENUM_OPCODE_NAME(MulM4V4)
+        ENUM_OPCODE_NAME(MulM4M4)
+        ENUM_OPCODE_NAME(TransposeM4)
+        ENUM_OPCODE_NAME(Dot3V4)
+        ENUM_OPCODE_NAME(Dot4V4)
+        ENUM_OPCODE_NAME(CrossV4)
+        ENUM_OPCODE_NAME(CmpLtF32)
+        ENUM_OPCODE_NAME(CmpLeF32)
+        ENUM_OPCODE_NAME(CmpGtF32)
+        ENUM_OPCODE_NAME(CmpGeF32)
+        ENUM_OPCODE_NAME(CmpEqF32)
+        ENUM_OPCODE_NAME(CmpNeF32)
+        ENUM_OPCODE_NAME(SelectF32)
+        ENUM_OPCODE_NAME(Jump)
+        ENUM_OPCODE_NAME(BranchZero)
+        ENUM_OPCODE_NAME(BranchNotZero)
+        ENUM_OPCODE_NAME(Loop)
+        ENUM_OPCODE_NAME(Discard)
+        ENUM_OPCODE_NAME(DiscardNotZero)
+
+        default:
+            break;
+    }
+
+    return nullptr;
+}
+
+#undef ENUM_OPCODE_NAME
+
+// ===========
+//  Verifying
+// ===========
+const char* scGetVerifierStateName(scVerifierState state) {
+    switch (state) {
+        case scVerifierState::OK:
+            return "OK";
+
+        case scVerifierState::TruncatedInstruction:
+            return "TruncatedInstruction";
+
+        case scVerifierState::UnknownInstruction:
+            return "UnknownInstruction";
+
+        case scVerifierState::InvalidRegister:
+            return "InvalidRegister";
+
+        case scVerifierState::MissingExit:
+            return "MissingExit";
+
+        case scVerifierState::InvalidTextureSlot:
+            return "InvalidTextureSlot";
+
+        case scVerifierState::InvalidBranchTarget:
+            return "InvalidBranchTarget";
+    }
+
+    return nullptr;
+}
+
+scVerifierResult scModule::Verify() {
+    scVerifierResult result {};
+
+    constexpr int REGISTER_COUNT = (int)scRegister::REGISTER_COUNT;
+
+    auto fail = [&](scVerifierState state, uint32_t offset) {
+        result.state = state;
+        result.offset = offset;
+
+        return result;
+    };
+
+    // Everything but the terminator Decode appends
+    size_t count = _instructions.size() - 1;
+    uint32_t expected = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const scInstruction& instruction = _instructions[i];
+
+        // Decode stops at a truncated immediate, leaving a gap before the terminator
+        if (instruction.offset != expected)
+            return fail(scVerifierState::TruncatedInstruction, expected);
+
+        expected += instruction.size;
+
+        // Number of registers A and B span, either is unused at 0
+        int widthA = 1;
+        int widthB = 0;
+
+        switch (instruction.opcode) {
+            case scOpcode::Exit:
+            case scOpcode::Discard:
+                continue;
+
+            // Nothing encodes a no-op, it only comes from encodings Decode didn't understand
+            case scOpcode::Nop:
+                return fail(scVerifierState::UnknownInstruction, instruction.offset);
+
+            case scOpcode::AddV4F32:
+            case scOpcode::SubV4F32:
+            case scOpcode::MulV4F32:
+            case scOpcode::DivV4F32:
+            case scOpcode::ModV4F32:
+            case scOpcode::PowV4F32:
+            case scOpcode::Dot3V4:
+            case scOpcode::Dot4V4:
+            case scOpcode::CrossV4:
+                widthA = 4;
+                widthB = 4;
+                break;
+
+            case scOpcode::MulM4V4:
+                widthA = 4;
+                widthB = 16;
+                break;
+
+            case scOpcode::MulM4M4:
+                widthA = 16;
+                widthB = 16;
+                break;
+
+            case scOpcode::TransposeM4:
+                widthA = 16;
+                break;
+
+            case scOpcode::Mov:
+            case scOpcode::AddF32:
+            case scOpcode::SubF32:
+            case scOpcode::MulF32:
+            case scOpcode::DivF32:
+            case scOpcode::ModF32:
+            case scOpcode::PowF32:
+            case scOpcode::CmpLtF32:
+            case scOpcode::CmpLeF32:
+            case scOpcode::CmpGtF32:
+            case scOpcode::CmpGeF32:
+            case scOpcode::CmpEqF32:
+            case scOpcode::CmpNeF32:
+                widthB = 1;
+                break;
+
+            case scOpcode::SelectF32:
+                if ((int)scGetSelectCondition(instruction) >= REGISTER_COUNT || (instruction.immediate.u32 >> 8) != 0)
+                    return fail(scVerifierState::InvalidRegister, instruction.offset);
+
+                widthB = 1;
+                break;
+
+            // Decode sends targets it couldn't find to the terminator, the encoded offset tells the two apart
+            case scOpcode::Jump:
+            case scOpcode::BranchZero:
+            case scOpcode::BranchNotZero:
+            case scOpcode::Loop: {
+                uint32_t target = 0;
+                ReadValue(instruction.offset + sizeof(uint32_t), target);
+
+                if (_instructions[i + scGetBranchDisplacement(instruction)].offset != target)
+                    return fail(scVerifierState::InvalidBranchTarget, instruction.offset);
+
+                if (instruction.opcode == scOpcode::Jump)
+                    widthA = 0;
+
+                break;
+            }
+
+            case scOpcode::LoadF32:
+            case scOpcode::LoadF32Unchecked:
+                result.requiredMemory = std::max<uint64_t>(result.requiredMemory, (uint64_t)instruction.immediate.u32 + sizeof(float));
+                break;
+
+            // A takes the RGBA result, B is the U / V pair
+            case scOpcode::SamplePoint:
+            case scOpcode::SampleLinear:
+                if ((int)scGetSampleLod(instruction) >= REGISTER_COUNT)
+                    return fail(scVerifierState::InvalidRegister, instruction.offset);
+
+                if (scGetSampleSlot(instruction) >= SC_TEXTURE_SLOT_COUNT)
+                    return fail(scVerifierState::InvalidTextureSlot, instruction.offset);
+
+                widthA = 4;
+                widthB = 2;
+                break;
+
+            default:
+                break;
+        }
+
+        // Aliases an operation accepts were already resolved by Decode, any alias left over is out of range here
+        if ((widthA > 0 && (int)instruction.a + widthA > REGISTER_COUNT) || (widthB > 0 && (int)instruction.b + widthB > REGISTER_COUNT))
+            return fail(scVerifierState::InvalidRegister, instruction.offset);
+    }
+
+    if (expected != _code.size())
+        return fail(scVerifierState::TruncatedInstruction, expected);
+
+    if (count == 0 || _instructions[count - 1].opcode != scOpcode::Exit)
+        return fail(scVerifierState::MissingExit, (uint32_t)_code.size());
+
+    for (scInstruction& instruction : _instructions) {
+        if (instruction.opcode == scOpcode::LoadF32)
+            instruction.opcode = scOpcode::LoadF32Unchecked;
+    }
+
+    _verified = true;
+    _requiredMemory = result.requiredMemory;
+
+    return result;
+}
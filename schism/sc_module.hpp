@@ -33,10 +33,14 @@
 #define SCHISM_SC_MODULE_HPP
 
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include <string>
+#include <memory>
 
 #include <schism/sc_magic.hpp>
+#include <schism/sc_operations.hpp>
+#include <schism/sc_span.hpp>
 
 enum class scModuleType : uint16_t {
     Vertex = 0x0000,
@@ -50,6 +54,48 @@ enum class scModuleState {
 
     FileNotFound,
     FileCorrupt,
+
+    // The header length doesn't match the size of the file
+    LengthMismatch,
+
+    // The header type isn't a scModuleType
+    InvalidModuleType,
+};
+
+// enum scVerifierState
+//   - The first problem scModule::Verify found
+enum class scVerifierState {
+    OK = 0,
+
+    // The code ends in the middle of an instruction or its immediate
+    TruncatedInstruction,
+
+    // An encoding the VM doesn't understand, it would have executed as a no-op
+    UnknownInstruction,
+
+    // A register outside the register file, or a V / M alias the operation doesn't accept
+    InvalidRegister,
+
+    // The last instruction of the code isn't EXIT
+    MissingExit,
+
+    // A sample instruction names a texture slot past SC_TEXTURE_SLOT_COUNT
+    InvalidTextureSlot,
+
+    // A branch whose target isn't the start of an instruction or the end of the code
+    InvalidBranchTarget,
+};
+
+extern const char* scGetVerifierStateName(scVerifierState state);
+
+// struct scVerifierResult
+//   - offset is the byte offset of the offending instruction
+//   - requiredMemory is the smallest memory size every load of the module fits in
+struct scVerifierResult {
+    scVerifierState state = scVerifierState::OK;
+
+    uint32_t offset = 0;
+    uint64_t requiredMemory = 0;
 };
 
 #pragma pack(push, 1)
@@ -60,30 +106,106 @@ typedef struct scModuleHeader {
 #pragma pack(pop)
 
 // Represents a loaded shader module
+//   - Nothing modifies a module once it's executed, so one module can be shared between any number of contexts through scModuleRef
+//   - Copies share the code, which either lives on the heap or in a mapped .scsm file
 class scModule {
 protected:
-    std::vector<uint8_t> _code {};
+    // Keeps whatever _code points into alive
+    std::shared_ptr<const void> _storage;
+    scSpan<const uint8_t> _code {};
+
+    scModuleType _type = scModuleType::Fragment;
+
+    // Set by Verify, contexts with less memory than _requiredMemory refuse the module
+    bool _verified = false;
+    uint64_t _requiredMemory = 0;
+
+    // Decoded form of _code, always terminated by an implicit EXIT
+    std::vector<scInstruction> _instructions {};
+
+    void Decode();
 
 public:
-    scModule(const std::vector<uint8_t>& code) {
-        this->_code = code;
-    }
+    scModule() = default;
+
+    scModule(const std::vector<uint8_t>& code, scModuleType type = scModuleType::Fragment);
+
+    // Takes an already decoded stream, which must end in an EXIT, offsets still refer to the code of source
+    scModule(const scModule& source, const std::vector<scInstruction>& instructions);
+
+    scModule(const scModule&) = default;
+    scModule(scModule&&) = default;
+
+    scModule& operator=(const scModule&) = default;
+    scModule& operator=(scModule&&) = default;
 
     template<typename T>
     scModuleState ReadValue(uint32_t cur, T& outValue) const {
         if (cur + (sizeof(T) - 1) >= _code.size())
             return scModuleState::ReadOutOfBounds;
 
-        outValue = *((T*)(_code.data() + cur));
+        // Code in a mapped file follows the header, so it isn't aligned
+        std::memcpy(&outValue, _code.data() + cur, sizeof(T));
         return scModuleState::OK;
     }
 
+    // Maps the file instead of reading it, the code is never copied
+    //   - Validates the magic, the module type and that the header length matches the file
+    //   - Leaves the module untouched on failure
     scModuleState LoadFromFile(const std::string& path);
 
     [[nodiscard]]
-    std::vector<uint8_t> GetCode() const {
+    scModuleType GetType() const {
+        return _type;
+    }
+
+    // Proves every instruction is known, complete and only touches the register file, that every branch lands on an
+    // instruction and that the code ends in EXIT
+    //   - On success loads drop their bound check, as any context the module is loaded into has enough memory
+    //   - Has to happen before the module is shared
+    scVerifierResult Verify();
+
+    [[nodiscard]]
+    bool IsVerified() const {
+        return _verified;
+    }
+
+    [[nodiscard]]
+    uint64_t GetRequiredMemory() const {
+        return _requiredMemory;
+    }
+
+    [[nodiscard]]
+    scSpan<const uint8_t> GetCode() const {
         return _code;
     }
+
+    [[nodiscard]]
+    scSpan<const scInstruction> GetInstructions() const {
+        return _instructions;
+    }
+};
+
+typedef std::shared_ptr<const scModule> scModuleRef;
+
+// Moves module into a new shared, immutable module
+inline scModuleRef scShareModule(scModule module) {
+    return std::make_shared<const scModule>(std::move(module));
+}
+
+// struct scRegisterAccess
+//   - Registers an instruction reads and writes, vector and matrix operations touch consecutive registers
+//   - width is 0 for operations that don't write a register
+struct scRegisterAccess {
+    int reads[3];
+    int readWidths[3];
+    int readCount;
+
+    int write;
+    int width;
 };
 
+// Returns false for operations it doesn't know, or when a register is outside the register file
+extern bool scGetRegisterAccess(const scInstruction& instruction, scRegisterAccess& outAccess);
+
 #endif //SCHISM_SC_MODULE_HPP
@@ -34,6 +34,9 @@
 
 #include <cstdint>
 
+// Bumped whenever an existing encoding changes meaning, cached modules from older versions are reassembled
+constexpr uint32_t SC_ISA_VERSION = 1;
+
 // enum scRegister
 //   - Represents a register within the Schism VM runtime
 //   - The lower half of registers are actually all virtual and do not physically exist
@@ -105,7 +108,9 @@ enum class scRegister : uint8_t {
 enum class scInstructionGroup : uint8_t {
     GroupZero      = 0x0,
     GroupOne       = 0x1,
-    GroupTwo       = 0x2
+    GroupTwo       = 0x2,
+    GroupThree     = 0x3,
+    GroupFour      = 0x4
 };
 
 enum class scGroupZeroOperations : uint8_t {
@@ -113,6 +118,7 @@ enum class scGroupZeroOperations : uint8_t {
     //  Group Zero Operations
     // =======================
     OpExitProgram  = 0x00,
+    OpDiscard      = 0x01,
 };
 
 enum class scGroupOneOperations : uint8_t {
@@ -141,9 +147,197 @@ enum class scGroupTwoOperations : uint8_t {
     // ======================
     OpSetF32       = 0x00,
     OpLoadF32      = 0x01,
-    OpABSF32       = 0x02
+    OpABSF32       = 0x02,
+
+    // The target is a V register, the coordinate register is in bits 20 - 27 and the trailing word holds the LOD
+    // register in its low byte and the texture slot in the next
+    OpSamplePoint  = 0x03,
+    OpSampleLinear = 0x04
+};
+
+enum class scGroupThreeOperations : uint8_t {
+    // ========================
+    //  Group Three Operations
+    // ========================
+    // Laid out like group one, A in bits 16 - 23 and B in bits 24 - 31, the result goes to A
+    OpMatMulVec    = 0x00,
+    OpMatMulMat    = 0x01,
+    OpMatTranspose = 0x02,
+    OpVecDot3      = 0x03,
+    OpVecDot4      = 0x04,
+    OpVecCross     = 0x05
+};
+
+enum class scGroupFourOperations : uint8_t {
+    // =======================
+    //  Group Four Operations
+    // =======================
+    // A in bits 12 - 19 and B in bits 20 - 27, compares set A to 1.0 when the comparison holds and 0.0 otherwise
+    OpCmpLt         = 0x00,
+    OpCmpLe         = 0x01,
+    OpCmpGt         = 0x02,
+    OpCmpGe         = 0x03,
+    OpCmpEq         = 0x04,
+    OpCmpNe         = 0x05,
+
+    // The trailing word is the condition register
+    OpSelect        = 0x06,
+
+    // The trailing word is the byte offset of the target within the code
+    OpJump          = 0x07,
+    OpBranchZero    = 0x08,
+    OpBranchNotZero = 0x09,
+    OpLoop          = 0x0A,
+
+    // Only A, there is no trailing word
+    OpDiscardNotZero = 0x0B
+};
+
+// union scValue
+//   - A raw 32-bit register / immediate value
+typedef union scValue {
+    int16_t i16;
+    int32_t i32;
+
+    uint16_t u16;
+    uint32_t u32;
+
+    float f32;
+} scValue_u;
+
+// enum scOpcode
+//   - The flattened operation of a decoded instruction
+//   - Group, operation and sub operation are folded together at decode time so the VM only has to branch once
+enum class scOpcode : uint8_t {
+    // Group zero
+    Exit,
+
+    // Any encoding the VM does not understand, executes as a no-op
+    Nop,
+
+    // Group one
+    Mov,
+
+    AddF32,
+    SubF32,
+    MulF32,
+    DivF32,
+    ModF32,
+    PowF32,
+
+    // Group one, 4 wide (A and B are the first scalar register of each operand)
+    AddV4F32,
+    SubV4F32,
+    MulV4F32,
+    DivV4F32,
+    ModV4F32,
+    PowV4F32,
+
+    // Group two
+    SetF32,
+    LoadF32,
+    AbsF32,
+
+    // LoadF32 without the bound check, only scModule::Verify produces it
+    LoadF32Unchecked,
+
+    // Group two, A is the first of 4 registers the RGBA result goes to, B the first of the U / V registers and the
+    // immediate is the LOD register and texture slot packed by scPackSampleOperand
+    SamplePoint,
+    SampleLinear,
+
+    // Group three, matrices are 4 consecutive row vectors
+    // A = B * A with A a vector and B a matrix
+    MulM4V4,
+
+    // A = A * B, both matrices
+    MulM4M4,
+
+    TransposeM4,
+
+    // Every component of A is set to the product
+    Dot3V4,
+    Dot4V4,
+
+    // The first 3 components of A are set to A x B, the 4th is left alone
+    CrossV4,
+
+    // Group four, A = (A op B) ? 1.0 : 0.0
+    CmpLtF32,
+    CmpLeF32,
+    CmpGtF32,
+    CmpGeF32,
+    CmpEqF32,
+    CmpNeF32,
+
+    // A = B if the register in the immediate isn't 0, otherwise A is left alone
+    SelectF32,
+
+    // The immediate is the signed distance to the target in decoded instructions, see scGetBranchDisplacement
+    Jump,
+
+    // Taken when A is 0 / isn't 0
+    BranchZero,
+    BranchNotZero,
+
+    // A = A - 1, taken while A is still above 0
+    Loop,
+
+    // Stops the invocation like Exit, but its output is thrown away instead of written
+    Discard,
+
+    // Discard when A isn't 0
+    DiscardNotZero,
+
+    OPCODE_COUNT
 };
 
-//extern const char* scGetOperationName(scOperation op);
+// Operations that can move the instruction pointer anywhere other than the next instruction
+inline bool scIsBranchOpcode(scOpcode opcode) {
+    return opcode >= scOpcode::Jump && opcode <= scOpcode::Loop;
+}
+
+// struct scInstruction
+//   - A single instruction decoded from a module's byte code
+//   - Immediates are already resolved, A is the target register of group two operations
+struct scInstruction {
+    scOpcode opcode;
+
+    scRegister a;
+    scRegister b;
+
+    // Size of the instruction in the byte code, including the trailing immediate
+    uint8_t size;
+
+    scValue_u immediate;
+
+    // Byte offset of the instruction within the module
+    uint32_t offset;
+};
+
+// The immediate of SamplePoint / SampleLinear
+inline uint32_t scPackSampleOperand(scRegister lod, uint32_t slot) {
+    return (uint32_t)lod | ((slot & 0xFF) << 8);
+}
+
+inline scRegister scGetSampleLod(const scInstruction& instruction) {
+    return (scRegister)(instruction.immediate.u32 & 0xFF);
+}
+
+inline uint32_t scGetSampleSlot(const scInstruction& instruction) {
+    return (instruction.immediate.u32 >> 8) & 0xFF;
+}
+
+// The instruction a taken branch continues at is the branch's index in the decoded stream plus this
+inline int32_t scGetBranchDisplacement(const scInstruction& instruction) {
+    return instruction.immediate.i32;
+}
+
+// The condition register of SelectF32
+inline scRegister scGetSelectCondition(const scInstruction& instruction) {
+    return (scRegister)(instruction.immediate.u32 & 0xFF);
+}
+
+extern const char* scGetOpcodeName(scOpcode opcode);
 
 #endif //SCHISM_SC_OPERATIONS_HPP
@@ -0,0 +1,549 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_optimizer.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include <array>
+#include <bitset>
+
+#include <schism/sc_assembler.hpp>
+
+static constexpr int REGISTER_COUNT = (int)scRegister::REGISTER_COUNT;
+
+// ==========
+//  Encoding
+// ==========
+static uint32_t EncodeGroupOne(scGroupOneOperations op, scGroupOneSubOperations subOp, int a, int b) {
+    return (uint32_t)scInstructionGroup::GroupOne
+           | ((uint32_t)op << 4)
+           | ((uint32_t)subOp << 12)
+           | ((uint32_t)(uint8_t)a << 16)
+           | ((uint32_t)(uint8_t)b << 24);
+}
+
+static uint32_t EncodeGroupTwo(scGroupTwoOperations op, int target) {
+    return (uint32_t)scInstructionGroup::GroupTwo
+           | ((uint32_t)op << 4)
+           | ((uint32_t)(uint8_t)target << 12);
+}
+
+static void EmitWord(std::vector<uint8_t>& binary, uint32_t word) {
+    uint8_t bytes[sizeof(uint32_t)];
+    std::memcpy(bytes, &word, sizeof(uint32_t));
+
+    binary.insert(binary.end(), bytes, bytes + sizeof(uint32_t));
+}
+
+// =========
+//  Folding
+// =========
+
+// pow is left alone as libm implementations don't agree on every result, the module may run on another host
+static bool TryFold(scGroupOneSubOperations subOp, uint32_t aBits, uint32_t bBits, uint32_t& outBits) {
+    float a, b;
+    std::memcpy(&a, &aBits, sizeof(float));
+    std::memcpy(&b, &bBits, sizeof(float));
+
+    switch (subOp) {
+        case scGroupOneSubOperations::SubOpAdd:
+            a = a + b;
+            break;
+
+        case scGroupOneSubOperations::SubOpSub:
+            a = a - b;
+            break;
+
+        case scGroupOneSubOperations::SubOpMul:
+            a = a * b;
+            break;
+
+        case scGroupOneSubOperations::SubOpDiv:
+            a = a / b;
+            break;
+
+        case scGroupOneSubOperations::SubOpMod:
+            a = std::fmod(a, b);
+            break;
+
+        default:
+            return false;
+    }
+
+    std::memcpy(&outBits, &a, sizeof(float));
+    return true;
+}
+
+// ==========
+//  Lowering
+// ==========
+bool scOptimizer::Lower(scSpan<const scInstruction> instructions, std::vector<scMicroOp>& outOps, std::vector<scVectorGroup>& outGroups) const {
+    auto valid = [](scRegister reg, int width) {
+        return (int)reg + width <= REGISTER_COUNT;
+    };
+
+    for (const scInstruction& instruction : instructions) {
+        scMicroOp op {};
+        op.a = (int)instruction.a;
+        op.b = (int)instruction.b;
+        op.group = -1;
+
+        switch (instruction.opcode) {
+            case scOpcode::Exit:
+                // Nothing after the first EXIT is reachable from ExecuteTillEnd
+                return true;
+
+            case scOpcode::Nop:
+                continue;
+
+            case scOpcode::Mov:
+                if (!valid(instruction.a, 1) || !valid(instruction.b, 1))
+                    return false;
+
+                op.kind = scMicroOpKind::Copy;
+                outOps.push_back(op);
+                break;
+
+            case scOpcode::AddF32:
+            case scOpcode::SubF32:
+            case scOpcode::MulF32:
+            case scOpcode::DivF32:
+            case scOpcode::ModF32:
+            case scOpcode::PowF32:
+                if (!valid(instruction.a, 1) || !valid(instruction.b, 1))
+                    return false;
+
+                op.kind = scMicroOpKind::Alu;
+                op.subOp = (scGroupOneSubOperations)((int)instruction.opcode - (int)scOpcode::AddF32);
+                outOps.push_back(op);
+                break;
+
+            case scOpcode::AddV4F32:
+            case scOpcode::SubV4F32:
+            case scOpcode::MulV4F32:
+            case scOpcode::DivV4F32:
+            case scOpcode::ModV4F32:
+            case scOpcode::PowV4F32:
+                if (!valid(instruction.a, 4) || !valid(instruction.b, 4))
+                    return false;
+
+                op.kind = scMicroOpKind::Alu;
+                op.subOp = (scGroupOneSubOperations)((int)instruction.opcode - (int)scOpcode::AddV4F32);
+                op.group = (int)outGroups.size();
+
+                outGroups.push_back({ true });
+
+                for (int d = 0; d < 4; d++) {
+                    scMicroOp lane = op;
+                    lane.a += d;
+                    lane.b += d;
+
+                    outOps.push_back(lane);
+                }
+
+                break;
+
+            case scOpcode::SetF32:
+            case scOpcode::LoadF32:
+            case scOpcode::AbsF32:
+                if (!valid(instruction.a, 1))
+                    return false;
+
+                if (instruction.opcode == scOpcode::SetF32)
+                    op.kind = scMicroOpKind::Const;
+                else if (instruction.opcode == scOpcode::LoadF32)
+                    op.kind = scMicroOpKind::Load;
+                else
+                    op.kind = scMicroOpKind::Abs;
+
+                op.immediate = instruction.immediate.u32;
+                outOps.push_back(op);
+                break;
+
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// ==================================
+//  Constant and Copy Propagation
+// ==================================
+void scOptimizer::Propagate(std::vector<scMicroOp>& ops, const std::vector<scVectorGroup>& groups) const {
+    struct scValueInfo {
+        enum { Unknown, Constant, Copy } kind = Unknown;
+
+        uint32_t bits = 0;
+
+        // A copy is only valid while its source still has the version it was copied at
+        int source = 0;
+        uint32_t sourceVersion = 0;
+    };
+
+    std::array<scValueInfo, REGISTER_COUNT> values {};
+    std::array<uint32_t, REGISTER_COUNT> versions {};
+
+    auto write = [&](int reg, const scValueInfo& info) {
+        versions[reg]++;
+        values[reg] = info;
+    };
+
+    auto resolve = [&](int reg) {
+        const scValueInfo& info = values[reg];
+
+        if (_options.copyPropagation && info.kind == scValueInfo::Copy && versions[info.source] == info.sourceVersion)
+            return info.source;
+
+        return reg;
+    };
+
+    auto constant = [&](int reg, uint32_t& outBits) {
+        if (!_options.constantFolding || values[reg].kind != scValueInfo::Constant)
+            return false;
+
+        outBits = values[reg].bits;
+        return true;
+    };
+
+    auto makeConstant = [](uint32_t bits) {
+        scValueInfo info;
+        info.kind = scValueInfo::Constant;
+        info.bits = bits;
+
+        return info;
+    };
+
+    for (scMicroOp& op : ops) {
+        if (op.removed)
+            continue;
+
+        if (op.group >= 0 && groups[op.group].fused) {
+            write(op.a, {});
+            continue;
+        }
+
+        uint32_t aBits, bBits;
+
+        switch (op.kind) {
+            case scMicroOpKind::Copy: {
+                int source = resolve(op.b);
+
+                if (constant(source, bBits)) {
+                    op.kind = scMicroOpKind::Const;
+                    op.immediate = bBits;
+                    // Handled as a constant below
+                } else {
+                    const scValueInfo& current = values[op.a];
+
+                    bool alreadyCopy = current.kind == scValueInfo::Copy
+                                       && current.source == source
+                                       && versions[source] == current.sourceVersion;
+
+                    if (source == op.a || (_options.copyPropagation && alreadyCopy)) {
+                        op.removed = true;
+                        break;
+                    }
+
+                    op.b = source;
+
+                    scValueInfo info;
+                    info.kind = scValueInfo::Copy;
+                    info.source = source;
+                    info.sourceVersion = versions[source];
+
+                    write(op.a, info);
+                    break;
+                }
+            }
+
+            [[fallthrough]];
+
+            case scMicroOpKind::Const: {
+                if (constant(op.a, aBits) && aBits == op.immediate) {
+                    op.removed = true;
+                    break;
+                }
+
+                write(op.a, makeConstant(op.immediate));
+                break;
+            }
+
+            case scMicroOpKind::Alu: {
+                op.b = resolve(op.b);
+
+                uint32_t folded;
+
+                if (constant(op.a, aBits) && constant(op.b, bBits) && TryFold(op.subOp, aBits, bBits, folded)) {
+                    op.kind = scMicroOpKind::Const;
+                    op.immediate = folded;
+
+                    write(op.a, makeConstant(folded));
+                    break;
+                }
+
+                write(op.a, {});
+                break;
+            }
+
+            case scMicroOpKind::Abs: {
+                if (constant(op.a, aBits)) {
+                    op.kind = scMicroOpKind::Const;
+                    op.immediate = aBits & 0x7FFFFFFF;
+
+                    write(op.a, makeConstant(op.immediate));
+                    break;
+                }
+
+                write(op.a, {});
+                break;
+            }
+
+            case scMicroOpKind::Load:
+                write(op.a, {});
+                break;
+        }
+    }
+}
+
+// ===========================
+//  Dead Code Elimination
+// ===========================
+void scOptimizer::Eliminate(std::vector<scMicroOp>& ops, const std::vector<scVectorGroup>& groups, scModuleType type) const {
+    std::bitset<REGISTER_COUNT> outputs;
+
+    // The vertex stage reads its output streams from S0 onwards
+    if (type == scModuleType::Vertex) {
+        for (int r = (int)scRegister::S0; r <= (int)scRegister::S31; r++)
+            outputs.set(r);
+    } else {
+        for (int r = (int)scRegister::FB0; r <= (int)scRegister::FB3; r++)
+            outputs.set(r);
+    }
+
+    std::bitset<REGISTER_COUNT> live = outputs;
+
+    for (int i = (int)ops.size() - 1; i >= 0; i--) {
+        scMicroOp& op = ops[i];
+
+        if (op.removed)
+            continue;
+
+        // Fused groups live or die together, their lanes are the 4 ops ending at i
+        if (op.group >= 0 && groups[op.group].fused) {
+            int first = i - 3;
+            bool anyLive = false;
+
+            for (int l = first; l <= i; l++)
+                anyLive = anyLive || live[ops[l].a];
+
+            for (int l = first; l <= i; l++) {
+                if (!anyLive) {
+                    ops[l].removed = true;
+                    continue;
+                }
+
+                live.set(ops[l].a);
+                live.set(ops[l].b);
+            }
+
+            i = first;
+            continue;
+        }
+
+        switch (op.kind) {
+            case scMicroOpKind::Copy:
+                if (!live[op.a]) {
+                    op.removed = true;
+                    break;
+                }
+
+                live.reset(op.a);
+                live.set(op.b);
+                break;
+
+            case scMicroOpKind::Const:
+                if (!live[op.a]) {
+                    op.removed = true;
+                    break;
+                }
+
+                live.reset(op.a);
+                break;
+
+            case scMicroOpKind::Alu:
+                if (!live[op.a]) {
+                    op.removed = true;
+                    break;
+                }
+
+                live.set(op.b);
+                break;
+
+            case scMicroOpKind::Abs:
+                if (!live[op.a])
+                    op.removed = true;
+
+                break;
+
+            case scMicroOpKind::Load:
+                // An out of range load stops the program, whatever is in the outputs at that point is the result
+                live.reset(op.a);
+                live |= outputs;
+                break;
+        }
+    }
+}
+
+// ==========
+//  Emission
+// ==========
+
+// Registers that start a V register are encoded as that V register, which makes an ALU operation 4 wide
+static int GetVectorAlias(int reg) {
+    int offset = reg - (int)scRegister::S0;
+
+    if (offset >= 0 && offset % 4 == 0 && reg < REGISTER_COUNT)
+        return (int)scRegister::V0 + offset / 4;
+
+    return reg;
+}
+void scOptimizer::Emit(const std::vector<scMicroOp>& ops, const std::vector<scVectorGroup>& groups, std::vector<uint8_t>& outBinary) const {
+    for (size_t i = 0; i < ops.size(); i++) {
+        const scMicroOp& op = ops[i];
+
+        if (op.removed)
+            continue;
+
+        if (op.group >= 0 && groups[op.group].fused) {
+            // Every group came from an operand that was a V register, and fused groups are never renamed
+            int a = GetVectorAlias(op.a);
+            int b = GetVectorAlias(op.b);
+
+            EmitWord(outBinary, EncodeGroupOne(scGroupOneOperations::OpALUF32F32, op.subOp, a, b));
+
+            i += 3;
+            continue;
+        }
+
+        switch (op.kind) {
+            case scMicroOpKind::Copy:
+                EmitWord(outBinary, EncodeGroupOne(scGroupOneOperations::OpMOV, scGroupOneSubOperations::SubOpAdd, op.a, op.b));
+                break;
+
+            case scMicroOpKind::Alu:
+                EmitWord(outBinary, EncodeGroupOne(scGroupOneOperations::OpALUF32F32, op.subOp, op.a, op.b));
+                break;
+
+            case scMicroOpKind::Const:
+                EmitWord(outBinary, EncodeGroupTwo(scGroupTwoOperations::OpSetF32, op.a));
+                EmitWord(outBinary, op.immediate);
+                break;
+
+            case scMicroOpKind::Load:
+                EmitWord(outBinary, EncodeGroupTwo(scGroupTwoOperations::OpLoadF32, op.a));
+                EmitWord(outBinary, op.immediate);
+                break;
+
+            case scMicroOpKind::Abs:
+                EmitWord(outBinary, EncodeGroupTwo(scGroupTwoOperations::OpABSF32, op.a));
+                break;
+        }
+    }
+
+    EmitWord(outBinary, (uint32_t)scInstructionGroup::GroupZero | ((uint32_t)scGroupZeroOperations::OpExitProgram << 4));
+}
+
+// ==============
+//  Optimization
+// ==============
+bool scOptimizer::Optimize(scAssembledProgram& program) {
+    scModule module(program.binary);
+
+    std::vector<scMicroOp> ops;
+    std::vector<scVectorGroup> groups;
+
+    _stats = {};
+
+    if (!Lower(module.GetInstructions(), ops, groups))
+        return false;
+
+    for (const scInstruction& instruction : module.GetInstructions()) {
+        _stats.instructionsBefore++;
+
+        if (instruction.opcode == scOpcode::Exit)
+            break;
+    }
+
+    // A 4 wide op is one instruction, splitting it only pays off when at most 2 lanes still have to be computed
+    // Find out by running the passes with every group split first
+    if (!groups.empty()) {
+        std::vector<scMicroOp> trialOps = ops;
+        std::vector<scVectorGroup> trialGroups(groups.size(), { false });
+
+        Propagate(trialOps, trialGroups);
+
+        if (_options.deadCodeElimination)
+            Eliminate(trialOps, trialGroups, program.header.type);
+
+        std::vector<int> computedLanes(groups.size(), 0);
+
+        for (const scMicroOp& op : trialOps) {
+            if (op.group >= 0 && !op.removed && op.kind == scMicroOpKind::Alu)
+                computedLanes[op.group]++;
+        }
+
+        for (size_t g = 0; g < groups.size(); g++)
+            groups[g].fused = computedLanes[g] > 2;
+    }
+
+    Propagate(ops, groups);
+
+    if (_options.deadCodeElimination)
+        Eliminate(ops, groups, program.header.type);
+
+    std::vector<uint8_t> binary;
+    Emit(ops, groups, binary);
+
+    scModule optimized(binary);
+    _stats.instructionsAfter = (uint32_t)optimized.GetInstructions().size() - 1;
+
+    if (_stats.instructionsAfter > _stats.instructionsBefore) {
+        _stats.instructionsAfter = _stats.instructionsBefore;
+        return true;
+    }
+
+    program = scAssembledProgram(binary, program.header.type);
+    return true;
+}
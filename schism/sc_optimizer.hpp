@@ -0,0 +1,126 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_OPTIMIZER_HPP
+#define SCHISM_SC_OPTIMIZER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <schism/sc_operations.hpp>
+#include <schism/sc_module.hpp>
+
+class scAssembledProgram;
+
+// struct scOptimizerOptions
+//   - Selects the passes scOptimizer runs
+struct scOptimizerOptions {
+    bool constantFolding = true;
+    bool copyPropagation = true;
+    bool deadCodeElimination = true;
+};
+
+// struct scOptimizerStats
+//   - Instruction counts of the last program passed to scOptimizer::Optimize, up to and including the first EXIT
+struct scOptimizerStats {
+    uint32_t instructionsBefore = 0;
+    uint32_t instructionsAfter = 0;
+};
+
+// Rewrites an assembled program into an equivalent, smaller one
+//   - Vector operations are split into one operation per lane, so every pass works on single registers
+//   - Only FB0 - FB3 are assumed to be read after a fragment program exits, vertex programs keep S0 - S31 as their outputs
+//   - Registers are assumed to hold unknown values on entry, so nothing depends on ResetRegisters
+//   - LD_F32 is never removed, an out of range load still has to stop the program
+class scOptimizer {
+protected:
+    scOptimizerOptions _options;
+    scOptimizerStats _stats;
+
+    // ===============
+    //  Intermediate
+    // ===============
+    enum class scMicroOpKind : uint8_t {
+        Copy,
+        Alu,
+        Const,
+        Load,
+        Abs,
+    };
+
+    struct scMicroOp {
+        scMicroOpKind kind;
+        scGroupOneSubOperations subOp;
+
+        int a;
+        int b;
+
+        // Constant bits or load address
+        uint32_t immediate;
+
+        // The 4 wide operation this lane came from, or -1
+        int group;
+
+        bool removed;
+    };
+
+    struct scVectorGroup {
+        // Fused groups are emitted as a single 4 wide operation and are never folded or renamed per lane
+        bool fused;
+    };
+
+    bool Lower(scSpan<const scInstruction> instructions, std::vector<scMicroOp>& outOps, std::vector<scVectorGroup>& outGroups) const;
+
+    void Propagate(std::vector<scMicroOp>& ops, const std::vector<scVectorGroup>& groups) const;
+
+    void Eliminate(std::vector<scMicroOp>& ops, const std::vector<scVectorGroup>& groups, scModuleType type) const;
+
+    void Emit(const std::vector<scMicroOp>& ops, const std::vector<scVectorGroup>& groups, std::vector<uint8_t>& outBinary) const;
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    explicit scOptimizer(const scOptimizerOptions& options = {}) : _options(options) {
+
+    }
+
+public:
+    // Returns false and leaves the program untouched if it contains anything the optimizer doesn't understand
+    bool Optimize(scAssembledProgram& program);
+
+    [[nodiscard]]
+    const scOptimizerStats& GetStats() const {
+        return _stats;
+    }
+};
+
+#endif //SCHISM_SC_OPTIMIZER_HPP
@@ -0,0 +1,279 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_profiler.hpp"
+
+#include <cstdio>
+#include <cstdarg>
+
+#include <algorithm>
+
+// =========
+//  Classes
+// =========
+scOpcodeClass scGetOpcodeClass(scOpcode opcode) {
+    switch (opcode) {
+        case scOpcode::Mov:
+            return scOpcodeClass::Move;
+
+        case scOpcode::AddF32:
+        case scOpcode::SubF32:
+        case scOpcode::MulF32:
+        case scOpcode::DivF32:
+        case scOpcode::AddV4F32:
+        case scOpcode::SubV4F32:
+        case scOpcode::MulV4F32:
+        case scOpcode::DivV4F32:
+        case scOpcode::AbsF32:
+        case scOpcode::CmpLtF32:
+        case scOpcode::CmpLeF32:
+        case scOpcode::CmpGtF32:
+        case scOpcode::CmpGeF32:
+        case scOpcode::CmpEqF32:
+        case scOpcode::CmpNeF32:
+        case scOpcode::SelectF32:
+            return scOpcodeClass::Arithmetic;
+
+        case scOpcode::ModF32:
+        case scOpcode::PowF32:
+        case scOpcode::ModV4F32:
+        case scOpcode::PowV4F32:
+            return scOpcodeClass::Transcendental;
+
+        case scOpcode::SetF32:
+            return scOpcodeClass::Immediate;
+
+        case scOpcode::LoadF32:
+        case scOpcode::LoadF32Unchecked:
+            return scOpcodeClass::Memory;
+
+        case scOpcode::SamplePoint:
+        case scOpcode::SampleLinear:
+            return scOpcodeClass::Texture;
+
+        case scOpcode::MulM4V4:
+        case scOpcode::MulM4M4:
+        case scOpcode::TransposeM4:
+        case scOpcode::Dot3V4:
+        case scOpcode::Dot4V4:
+        case scOpcode::CrossV4:
+            return scOpcodeClass::Matrix;
+
+        default:
+            return scOpcodeClass::Control;
+    }
+}
+
+const char* scGetOpcodeClassName(scOpcodeClass opcodeClass) {
+    switch (opcodeClass) {
+        case scOpcodeClass::Control:
+            return "Control";
+
+        case scOpcodeClass::Move:
+            return "Move";
+
+        case scOpcodeClass::Arithmetic:
+            return "Arithmetic";
+
+        case scOpcodeClass::Transcendental:
+            return "Transcendental";
+
+        case scOpcodeClass::Immediate:
+            return "Immediate";
+
+        case scOpcodeClass::Memory:
+            return "Memory";
+
+        case scOpcodeClass::Texture:
+            return "Texture";
+
+        case scOpcodeClass::Matrix:
+            return "Matrix";
+
+        default:
+            return nullptr;
+    }
+}
+
+// =========
+//  Profile
+// =========
+uint64_t scProfile::GetTotalCount() const {
+    uint64_t total = 0;
+
+    for (uint64_t count : opcodeCounts)
+        total += count;
+
+    return total;
+}
+
+uint64_t scProfile::GetSubOpCount(scGroupOneSubOperations subOp) const {
+    if (subOp > scGroupOneSubOperations::SubOpPow)
+        return 0;
+
+    return opcodeCounts[(int)scOpcode::AddF32 + (int)subOp] + opcodeCounts[(int)scOpcode::AddV4F32 + (int)subOp];
+}
+
+double scProfile::GetAverageCycles(scOpcodeClass opcodeClass) const {
+    uint64_t samples = classSamples[(int)opcodeClass];
+
+    if (samples == 0)
+        return 0;
+
+    return (double)classCycles[(int)opcodeClass] / (double)samples;
+}
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scProfiler::scProfiler() {
+    // Back to back reads give the fixed cost every sample pays on top of the instruction itself
+    uint64_t overhead = UINT64_MAX;
+
+    for (int i = 0; i < 16; i++) {
+        uint64_t begin = scReadTimestamp();
+        uint64_t end = scReadTimestamp();
+
+        overhead = std::min(overhead, end - begin);
+    }
+
+    _timestampOverhead = overhead;
+}
+
+// ===============
+//  Configuration
+// ===============
+void scProfiler::SetSampleInterval(uint32_t interval) {
+    _sampleInterval = interval;
+    _sampleCountdown = interval;
+}
+
+// =========
+//  Results
+// =========
+void scProfiler::Reset() {
+    _profile = {};
+    _sampleCountdown = _sampleInterval;
+}
+
+static void AppendFormat(std::string& out, const char* fmt, ...) {
+    char buffer[256];
+
+    va_list args;
+    va_start(args, fmt);
+    int len = std::vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+
+    if (len > 0)
+        out.append(buffer, std::min<size_t>(len, sizeof(buffer) - 1));
+}
+
+std::string scProfiler::ToJson(const scModule& module) const {
+    std::string json = "{\n";
+
+    AppendFormat(json, "  \"runs\": %llu,\n", (unsigned long long)_profile.runs);
+    AppendFormat(json, "  \"instructions\": %llu,\n", (unsigned long long)_profile.GetTotalCount());
+    AppendFormat(json, "  \"sample_interval\": %u,\n", _sampleInterval);
+
+    // Opcodes
+    json += "  \"opcodes\": [";
+    bool first = true;
+
+    for (int o = 0; o < SC_OPCODE_COUNT; o++) {
+        if (_profile.opcodeCounts[o] == 0)
+            continue;
+
+        scOpcode opcode = (scOpcode)o;
+
+        AppendFormat(json, "%s\n    { \"opcode\": \"%s\", \"class\": \"%s\", \"count\": %llu }",
+            first ? "" : ",",
+            scGetOpcodeName(opcode),
+            scGetOpcodeClassName(scGetOpcodeClass(opcode)),
+            (unsigned long long)_profile.opcodeCounts[o]
+        );
+
+        first = false;
+    }
+
+    json += "\n  ],\n";
+
+    // Sub operations
+    const char* subOpNames[] = { "add", "sub", "mul", "div", "mod", "pow" };
+
+    json += "  \"sub_ops\": {";
+
+    for (int s = 0; s < 6; s++) {
+        AppendFormat(json, "%s \"%s\": %llu",
+            s == 0 ? "" : ",",
+            subOpNames[s],
+            (unsigned long long)_profile.GetSubOpCount((scGroupOneSubOperations)s)
+        );
+    }
+
+    json += " },\n";
+
+    // Classes
+    json += "  \"classes\": [";
+
+    for (int c = 0; c < SC_OPCODE_CLASS_COUNT; c++) {
+        scOpcodeClass opcodeClass = (scOpcodeClass)c;
+
+        AppendFormat(json, "%s\n    { \"class\": \"%s\", \"samples\": %llu, \"cycles\": %llu, \"cycles_per_instruction\": %.2f }",
+            c == 0 ? "" : ",",
+            scGetOpcodeClassName(opcodeClass),
+            (unsigned long long)_profile.classSamples[c],
+            (unsigned long long)_profile.classCycles[c],
+            _profile.GetAverageCycles(opcodeClass)
+        );
+    }
+
+    json += "\n  ],\n";
+
+    // Instructions
+    scSpan<const scInstruction> instructions = module.GetInstructions();
+    size_t count = std::min(instructions.size(), _profile.instructionCounts.size());
+
+    json += "  \"listing\": [";
+
+    for (size_t i = 0; i < count; i++) {
+        AppendFormat(json, "%s\n    { \"ip\": %zu, \"offset\": %u, \"opcode\": \"%s\", \"count\": %llu }",
+            i == 0 ? "" : ",",
+            i,
+            instructions[i].offset,
+            scGetOpcodeName(instructions[i].opcode),
+            (unsigned long long)_profile.instructionCounts[i]
+        );
+    }
+
+    json += "\n  ]\n}\n";
+
+    return json;
+}
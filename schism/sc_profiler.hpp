@@ -0,0 +1,213 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_PROFILER_HPP
+#define SCHISM_SC_PROFILER_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+#include <array>
+#include <vector>
+#include <string>
+
+#include <schism/sc_cpu.hpp>
+#include <schism/sc_module.hpp>
+
+#if defined(SCHISM_ARCH_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(SCHISM_ARCH_X86)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// The VMs only call into a profiler when the library is built with SCHISM_PROFILER, otherwise none of the
+// profiling paths exist and attaching a profiler does nothing
+
+// enum scOpcodeClass
+//   - Groups opcodes of a similar cost, cycle samples are kept per class
+enum class scOpcodeClass : uint8_t {
+    // Exit, branches, discards and anything the VM doesn't understand
+    Control,
+
+    Move,
+
+    // Add, sub, mul, div, abs, compares and selects
+    Arithmetic,
+
+    // Mod and pow, which go through libm
+    Transcendental,
+
+    Immediate,
+
+    Memory,
+
+    // Texture samples
+    Texture,
+
+    // Matrix products, transposes, dot and cross products
+    Matrix,
+
+    CLASS_COUNT
+};
+
+extern scOpcodeClass scGetOpcodeClass(scOpcode opcode);
+
+extern const char* scGetOpcodeClassName(scOpcodeClass opcodeClass);
+
+// Reads the time stamp counter, or a nanosecond clock on hosts without one
+inline uint64_t scReadTimestamp() {
+#ifdef SCHISM_ARCH_X86
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+constexpr int SC_OPCODE_COUNT = (int)scOpcode::OPCODE_COUNT;
+constexpr int SC_OPCODE_CLASS_COUNT = (int)scOpcodeClass::CLASS_COUNT;
+
+// struct scProfile
+//   - Everything an scProfiler counted since it was last reset
+//   - An scWideVM counts an instruction once per batch, not once per lane
+struct scProfile {
+    // Number of times a program was started
+    uint64_t runs = 0;
+
+    std::array<uint64_t, SC_OPCODE_COUNT> opcodeCounts {};
+
+    // Indexed like the decoded instructions of the profiled program
+    std::vector<uint64_t> instructionCounts {};
+
+    // Sampled cycles with the cost of reading the time stamp already taken out
+    std::array<uint64_t, SC_OPCODE_CLASS_COUNT> classCycles {};
+    std::array<uint64_t, SC_OPCODE_CLASS_COUNT> classSamples {};
+
+    [[nodiscard]]
+    uint64_t GetTotalCount() const;
+
+    // Scalar and 4 wide operations of the same sub operation are counted together
+    [[nodiscard]]
+    uint64_t GetSubOpCount(scGroupOneSubOperations subOp) const;
+
+    // Returns 0 if the class was never sampled
+    [[nodiscard]]
+    double GetAverageCycles(scOpcodeClass opcodeClass) const;
+};
+
+// Collects execution counts from a single VM, see scVM::SetProfiler
+class scProfiler {
+protected:
+    scProfile _profile;
+
+    uint32_t _sampleInterval = 0;
+    uint32_t _sampleCountdown = 0;
+
+    uint64_t _timestampOverhead = 0;
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    scProfiler();
+
+    // Returns true if the library was built with SCHISM_PROFILER
+    static constexpr bool IsSupported() {
+#ifdef SCHISM_PROFILER
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // ===============
+    //  Configuration
+    // ===============
+
+    // Takes a cycle sample every interval instructions, 0 turns sampling off
+    void SetSampleInterval(uint32_t interval);
+
+    [[nodiscard]]
+    uint32_t GetSampleInterval() const {
+        return _sampleInterval;
+    }
+
+    // =========
+    //  Results
+    // =========
+    void Reset();
+
+    [[nodiscard]]
+    const scProfile& GetProfile() const {
+        return _profile;
+    }
+
+    // Dumps the profile as JSON, module is the program it was taken of and gives the byte offsets of each instruction
+    [[nodiscard]]
+    std::string ToJson(const scModule& module) const;
+
+    // ===========
+    //  Recording
+    // ===========
+
+    // Called by the VM before a program is run from the start
+    void BeginRun(size_t instructionCount) {
+        if (_profile.instructionCounts.size() < instructionCount)
+            _profile.instructionCounts.resize(instructionCount);
+
+        _profile.runs++;
+    }
+
+    void Count(uint32_t ip, scOpcode opcode) {
+        _profile.opcodeCounts[(int)opcode]++;
+
+        if (ip < _profile.instructionCounts.size())
+            _profile.instructionCounts[ip]++;
+    }
+
+    bool ShouldSample() {
+        if (_sampleInterval == 0 || --_sampleCountdown != 0)
+            return false;
+
+        _sampleCountdown = _sampleInterval;
+        return true;
+    }
+
+    void AddSample(scOpcode opcode, uint64_t cycles) {
+        int opcodeClass = (int)scGetOpcodeClass(opcode);
+
+        _profile.classCycles[opcodeClass] += cycles > _timestampOverhead ? cycles - _timestampOverhead : 0;
+        _profile.classSamples[opcodeClass]++;
+    }
+};
+
+#endif //SCHISM_SC_PROFILER_HPP
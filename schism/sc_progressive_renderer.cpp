@@ -0,0 +1,224 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_progressive_renderer.hpp"
+
+#include <cstring>
+
+#include <algorithm>
+
+// Share of the pixels each pass executes, in sixteenths
+static constexpr int PASS_WEIGHTS[SC_PROGRESSIVE_PASS_COUNT] = { 1, 3, 12 };
+
+void scDirtyRegion::Add(const scDirtyRegion& region) {
+    if (region.IsEmpty())
+        return;
+
+    if (IsEmpty()) {
+        *this = region;
+        return;
+    }
+
+    x0 = std::min(x0, region.x0);
+    y0 = std::min(y0, region.y0);
+    x1 = std::max(x1, region.x1);
+    y1 = std::max(y1, region.y1);
+}
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scProgressiveRenderer::scProgressiveRenderer(scRenderer& renderer) : _renderer(renderer) {
+    _thread = std::thread(&scProgressiveRenderer::JobMain, this);
+}
+
+scProgressiveRenderer::~scProgressiveRenderer() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _quit = true;
+        _cancel = true;
+    }
+
+    _wake.notify_all();
+    _thread.join();
+}
+
+// ======
+//  Jobs
+// ======
+void scProgressiveRenderer::Start(int width, int height, scPixelFormat format) {
+    Stop();
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        size_t size = (size_t)width * height * scGetPixelSize(format);
+
+        // The job isn't running, so its buffer is free to resize too
+        _renderPixels.resize(size);
+        _stagingPixels.resize(size);
+
+        // Transparent black in every format, which is what the passes leave behind discarded pixels
+        std::fill(_renderPixels.begin(), _renderPixels.end(), 0);
+
+        _width = width;
+        _height = height;
+        _format = format;
+
+        _completedPasses = 0;
+        _completedRows = 0;
+
+        _dirty = {};
+        _pending = true;
+    }
+
+    _wake.notify_one();
+}
+
+void scProgressiveRenderer::Stop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _pending = false;
+    _cancel = true;
+
+    _idle.wait(lock, [this]() { return !_running; });
+
+    _cancel = false;
+}
+
+void scProgressiveRenderer::SetBandBudget(std::chrono::microseconds budget) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _bandBudget = std::max(budget, std::chrono::microseconds(1));
+}
+
+bool scProgressiveRenderer::IsRunning() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _running || _pending;
+}
+
+float scProgressiveRenderer::GetProgress() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_height <= 0)
+        return 0;
+
+    int done = 0;
+
+    for (int p = 0; p < _completedPasses; p++)
+        done += PASS_WEIGHTS[p];
+
+    float progress = (float)done;
+
+    if (_completedPasses < SC_PROGRESSIVE_PASS_COUNT)
+        progress += PASS_WEIGHTS[_completedPasses] * (float)_completedRows / (float)_height;
+
+    return progress / 16.0F;
+}
+
+void scProgressiveRenderer::JobMain() {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true) {
+        _wake.wait(lock, [this]() { return _quit || _pending; });
+
+        if (_quit)
+            break;
+
+        _pending = false;
+        _running = true;
+
+        int width = _width;
+        int height = _height;
+        scPixelFormat format = _format;
+
+        lock.unlock();
+        RenderJob(width, height, format);
+        lock.lock();
+
+        _running = false;
+        _idle.notify_all();
+    }
+}
+
+bool scProgressiveRenderer::RenderJob(int width, int height, scPixelFormat format) {
+    constexpr int ALIGNMENT = SC_PROGRESSIVE_ROW_ALIGNMENT;
+
+    std::chrono::microseconds budget;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        budget = _bandBudget;
+    }
+
+    size_t pitch = (size_t)width * scGetPixelSize(format);
+    int rows = ALIGNMENT;
+
+    for (int pass = 0; pass < SC_PROGRESSIVE_PASS_COUNT; pass++) {
+        for (int y = 0; y < height;) {
+            if (_cancel)
+                return false;
+
+            int y1 = std::min(y + rows, height);
+
+            auto begin = std::chrono::steady_clock::now();
+            _renderer.RenderProgressive(pass, width, height, y, y1, _renderPixels.data(), pitch, format);
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+
+            // Bands are aligned, so the blocks of this one all end by y1
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+
+                std::memcpy(_stagingPixels.data() + y * pitch, _renderPixels.data() + y * pitch, (y1 - y) * pitch);
+
+                _dirty.Add({ 0, y, width, y1 });
+                _completedRows = y1;
+            }
+
+            // Aim the next band at the budget, growing at most twice as tall so one slow band can't overshoot
+            int64_t target = rows * budget.count() / std::max<int64_t>(elapsed.count(), 1);
+            target = std::clamp<int64_t>(target, ALIGNMENT, std::min<int64_t>((int64_t)rows * 2, height + ALIGNMENT));
+
+            rows = (int)target / ALIGNMENT * ALIGNMENT;
+            y = y1;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _completedPasses = pass + 1;
+        _completedRows = 0;
+    }
+
+    return true;
+}
@@ -0,0 +1,156 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_PROGRESSIVE_RENDERER_HPP
+#define SCHISM_SC_PROGRESSIVE_RENDERER_HPP
+
+#include <cstdint>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <condition_variable>
+
+#include <schism/sc_renderer.hpp>
+
+// struct scDirtyRegion
+//   - A rectangle of pixels, x1 / y1 are exclusive
+struct scDirtyRegion {
+    int x0 = 0;
+    int y0 = 0;
+    int x1 = 0;
+    int y1 = 0;
+
+    [[nodiscard]]
+    bool IsEmpty() const {
+        return x0 >= x1 || y0 >= y1;
+    }
+
+    void Add(const scDirtyRegion& region);
+};
+
+// Renders surfaces coarse to fine on a background thread
+//   - Every pass of scRenderer::RenderProgressive runs over the surface in bands of rows, sized so a band takes
+//     about as long as the band budget
+//   - Finished bands are copied into a staging buffer, Upload hands out whatever changed since the last call
+//   - The renderer belongs to the job while one runs, Stop has to be called before it's changed in any way
+class scProgressiveRenderer {
+protected:
+    scRenderer& _renderer;
+
+    std::thread _thread;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+
+    // Only touched by the job thread
+    std::vector<uint8_t> _renderPixels;
+
+    // Guarded by _mutex
+    std::vector<uint8_t> _stagingPixels;
+    scDirtyRegion _dirty;
+
+    int _width = 0;
+    int _height = 0;
+
+    scPixelFormat _format = scPixelFormat::RGBA8;
+
+    int _completedPasses = 0;
+    int _completedRows = 0;
+
+    std::chrono::microseconds _bandBudget { 8000 };
+
+    bool _pending = false;
+    bool _running = false;
+    bool _quit = false;
+
+    std::atomic<bool> _cancel { false };
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    explicit scProgressiveRenderer(scRenderer& renderer);
+
+    ~scProgressiveRenderer();
+
+    scProgressiveRenderer(const scProgressiveRenderer&) = delete;
+    scProgressiveRenderer& operator=(const scProgressiveRenderer&) = delete;
+
+public:
+    // Abandons the current job and starts rendering a width x height surface from its coarsest pass
+    void Start(int width, int height, scPixelFormat format = scPixelFormat::RGBA8);
+
+    // Returns once the job thread has let go of the renderer, a band in progress is finished first
+    void Stop();
+
+    // Smaller budgets publish more often and stop sooner, at the cost of more dispatches
+    void SetBandBudget(std::chrono::microseconds budget);
+
+    [[nodiscard]]
+    bool IsRunning();
+
+    // Fraction of the pixels of the current job that were executed
+    [[nodiscard]]
+    float GetProgress();
+
+    // Calls upload with the region that changed since the last call, if any
+    //   - upload(const scDirtyRegion& region, const uint8_t* pPixels, size_t pitch), pPixels points at x0 / y0
+    //   - Runs with the staging buffer locked, the job thread waits for it to return before publishing again
+    template<typename F>
+    bool Upload(F&& upload) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_dirty.IsEmpty())
+            return false;
+
+        size_t pixelSize = scGetPixelSize(_format);
+        size_t pitch = (size_t)_width * pixelSize;
+
+        const uint8_t* pPixels = _stagingPixels.data() + _dirty.y0 * pitch + _dirty.x0 * pixelSize;
+
+        upload(_dirty, pPixels, pitch);
+        _dirty = {};
+
+        return true;
+    }
+
+protected:
+    void JobMain();
+
+    // Returns false if the job was cancelled
+    bool RenderJob(int width, int height, scPixelFormat format);
+};
+
+#endif //SCHISM_SC_PROGRESSIVE_RENDERER_HPP
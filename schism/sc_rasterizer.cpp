@@ -0,0 +1,569 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_rasterizer.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+
+#include <schism/sc_cpu.hpp>
+
+#ifdef SCHISM_ARCH_X86
+#include <immintrin.h>
+#endif
+
+static constexpr int SUBPIXEL_SCALE = 1 << SC_RASTER_SUBPIXEL_BITS;
+static constexpr int BLOCK = SC_RASTER_BLOCK_SIZE;
+
+// Distance between the first and last pixel center of a block in subpixels
+static constexpr int64_t BLOCK_SPAN = (BLOCK - 1) * SUBPIXEL_SCALE;
+
+// ==========
+//  Coverage
+// ==========
+
+// Edge values of a block, relative to its first pixel center, the rows step by stepY and the columns by stepX
+struct scBlockEdges {
+    int32_t origin[3];
+    int32_t stepX[3];
+    int32_t stepY[3];
+};
+
+// Bit y * 8 + x is set for every pixel of the block inside all three edges
+static uint64_t CoverBlockGeneric(const scBlockEdges& edges) {
+    uint64_t mask = 0;
+
+    for (int y = 0; y < BLOCK; y++) {
+        for (int x = 0; x < BLOCK; x++) {
+            bool inside = true;
+
+            for (int e = 0; e < 3; e++)
+                inside &= edges.origin[e] + x * edges.stepX[e] + y * edges.stepY[e] >= 0;
+
+            mask |= (uint64_t)inside << (y * BLOCK + x);
+        }
+    }
+
+    return mask;
+}
+
+#ifdef SCHISM_ARCH_X86
+SC_TARGET("sse2") static uint64_t CoverBlockSSE2(const scBlockEdges& edges) {
+    __m128i left[3];
+    __m128i right[3];
+    __m128i stepY[3];
+
+    for (int e = 0; e < 3; e++) {
+        __m128i stepX = _mm_set1_epi32(edges.stepX[e]);
+        __m128i columns = _mm_setr_epi32(0, edges.stepX[e], edges.stepX[e] * 2, edges.stepX[e] * 3);
+
+        left[e] = _mm_add_epi32(_mm_set1_epi32(edges.origin[e]), columns);
+        right[e] = _mm_add_epi32(left[e], _mm_slli_epi32(stepX, 2));
+        stepY[e] = _mm_set1_epi32(edges.stepY[e]);
+    }
+
+    uint64_t mask = 0;
+
+    for (int y = 0; y < BLOCK; y++) {
+        // A pixel is outside if any edge value is negative, which shows up in the sign bit of their union
+        __m128i outsideLeft = _mm_or_si128(_mm_or_si128(left[0], left[1]), left[2]);
+        __m128i outsideRight = _mm_or_si128(_mm_or_si128(right[0], right[1]), right[2]);
+
+        int outside = _mm_movemask_ps(_mm_castsi128_ps(outsideLeft)) | (_mm_movemask_ps(_mm_castsi128_ps(outsideRight)) << 4);
+        mask |= (uint64_t)(~outside & 0xFF) << (y * BLOCK);
+
+        for (int e = 0; e < 3; e++) {
+            left[e] = _mm_add_epi32(left[e], stepY[e]);
+            right[e] = _mm_add_epi32(right[e], stepY[e]);
+        }
+    }
+
+    return mask;
+}
+#endif
+
+static uint64_t CoverBlock(const scBlockEdges& edges) {
+#ifdef SCHISM_ARCH_X86
+    static const bool sse2 = scGetCpuFeatures().sse2;
+
+    if (sse2)
+        return CoverBlockSSE2(edges);
+#endif
+
+    return CoverBlockGeneric(edges);
+}
+
+// Pixels of the block at blockX / blockY that are within [minX, maxX] x [minY, maxY]
+static uint64_t GetBoundsMask(int blockX, int blockY, int minX, int minY, int maxX, int maxY) {
+    int firstColumn = std::clamp(minX - blockX, 0, BLOCK);
+    int lastColumn = std::clamp(maxX - blockX + 1, 0, BLOCK);
+
+    int firstRow = std::clamp(minY - blockY, 0, BLOCK);
+    int lastRow = std::clamp(maxY - blockY + 1, 0, BLOCK);
+
+    uint64_t row = (0xFFu >> (BLOCK - lastColumn)) & (0xFFu << firstColumn);
+    uint64_t mask = 0;
+
+    for (int y = firstRow; y < lastRow; y++)
+        mask |= row << (y * BLOCK);
+
+    return mask;
+}
+
+static int FindLowestBit(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#else
+    int bit = 0;
+
+    while (!(mask & (1ull << bit)))
+        bit++;
+
+    return bit;
+#endif
+}
+
+static int64_t FloorDiv(int64_t value, int64_t divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scRasterizer::scRasterizer(int threadCount, size_t memSize) : _pool(threadCount) {
+    for (int w = 0; w < _pool.GetWorkerCount(); w++) {
+        _contexts.emplace_back(std::make_unique<scWideVM>(memSize));
+        _contexts.back()->SetUniformHoisting(true);
+    }
+
+    _batches.resize(_pool.GetWorkerCount());
+    _fragmentCounts.resize(_pool.GetWorkerCount());
+}
+
+// =======
+//  Setup
+// =======
+bool scRasterizer::LoadProgram(scModuleRef program) {
+    if (program != nullptr && program->GetType() != scModuleType::Fragment)
+        program = nullptr;
+
+    if (program != nullptr && program->IsVerified() && program->GetRequiredMemory() > _contexts[0]->GetMemorySize())
+        program = nullptr;
+
+    bool loaded = program != nullptr;
+
+    _program = std::move(program);
+    _lateDepth = false;
+
+    if (_program != nullptr) {
+        for (const scInstruction& instruction : _program->GetInstructions())
+            _lateDepth |= instruction.opcode == scOpcode::Discard || instruction.opcode == scOpcode::DiscardNotZero;
+    }
+
+    scHoistedProgramRef hoisted = nullptr;
+
+    if (_program != nullptr)
+        hoisted = scHoistUniforms(*_program, _contexts[0]->GetMemorySize());
+
+    for (std::unique_ptr<scWideVM>& context : _contexts)
+        context->LoadProgram(_program, hoisted);
+
+    return loaded;
+}
+
+void scRasterizer::SetTileSize(int size) {
+    _tileSize = std::max(1, (size + BLOCK - 1) / BLOCK) * BLOCK;
+}
+
+bool scRasterizer::BindTexture(int slot, scTextureRef texture) {
+    bool bound = true;
+
+    for (std::unique_ptr<scWideVM>& context : _contexts)
+        bound = context->BindTexture(slot, texture) && bound;
+
+    return bound;
+}
+
+bool scRasterizer::SetupTriangle(const scTransformedVertices& vertices, const uint32_t indices[3], const scRasterTarget& target, scTriangle& outTriangle) {
+    int64_t x[3];
+    int64_t y[3];
+
+    float invW[3];
+    float depth[3];
+
+    for (int v = 0; v < 3; v++) {
+        uint32_t index = indices[v];
+
+        float clipX = vertices.GetStream(0)[index];
+        float clipY = vertices.GetStream(1)[index];
+        float clipZ = vertices.GetStream(2)[index];
+        float clipW = vertices.GetStream(3)[index];
+
+        // Also rejects NaN
+        if (!(clipW > 0.0f))
+            return false;
+
+        invW[v] = 1.0f / clipW;
+        depth[v] = clipZ * invW[v];
+
+        // NDC y points up, rows go down
+        float screenX = (clipX * invW[v] * 0.5f + 0.5f) * (float)target.width;
+        float screenY = (0.5f - clipY * invW[v] * 0.5f) * (float)target.height;
+
+        if (!(std::fabs(screenX) < SC_RASTER_GUARD_BAND && std::fabs(screenY) < SC_RASTER_GUARD_BAND))
+            return false;
+
+        x[v] = std::lround(screenX * SUBPIXEL_SCALE);
+        y[v] = std::lround(screenY * SUBPIXEL_SCALE);
+    }
+
+    int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+
+    if (area == 0)
+        return false;
+
+    // Both faces are drawn, the edges are flipped so the inside is always positive
+    int64_t sign = area > 0 ? 1 : -1;
+
+    for (int e = 0; e < 3; e++) {
+        int i0 = (e + 1) % 3;
+        int i1 = (e + 2) % 3;
+
+        outTriangle.a[e] = (y[i0] - y[i1]) * sign;
+        outTriangle.b[e] = (x[i1] - x[i0]) * sign;
+        outTriangle.c[e] = (x[i0] * y[i1] - y[i0] * x[i1]) * sign;
+
+        bool topLeft = outTriangle.a[e] > 0 || (outTriangle.a[e] == 0 && outTriangle.b[e] > 0);
+        outTriangle.bias[e] = topLeft ? 0 : -1;
+    }
+
+    // Pixel centers are at + 0.5, so the first pixel whose center can be inside is rounded up from min - 0.5
+    int64_t minX = std::min({ x[0], x[1], x[2] });
+    int64_t minY = std::min({ y[0], y[1], y[2] });
+    int64_t maxX = std::max({ x[0], x[1], x[2] });
+    int64_t maxY = std::max({ y[0], y[1], y[2] });
+
+    constexpr int64_t HALF = SUBPIXEL_SCALE / 2;
+
+    outTriangle.minX = (int)std::max<int64_t>(0, -FloorDiv(HALF - minX, SUBPIXEL_SCALE));
+    outTriangle.minY = (int)std::max<int64_t>(0, -FloorDiv(HALF - minY, SUBPIXEL_SCALE));
+    outTriangle.maxX = (int)std::min<int64_t>(target.width - 1, FloorDiv(maxX - HALF, SUBPIXEL_SCALE));
+    outTriangle.maxY = (int)std::min<int64_t>(target.height - 1, FloorDiv(maxY - HALF, SUBPIXEL_SCALE));
+
+    if (outTriangle.minX > outTriangle.maxX || outTriangle.minY > outTriangle.maxY)
+        return false;
+
+    // Barycentric weights at the first pixel of the bounds and their steps per pixel, in double so the planes
+    // stay accurate far from the origin
+    double invArea = 1.0 / (double)(area * sign);
+
+    int64_t anchorX = (int64_t)outTriangle.minX * SUBPIXEL_SCALE + SUBPIXEL_SCALE / 2;
+    int64_t anchorY = (int64_t)outTriangle.minY * SUBPIXEL_SCALE + SUBPIXEL_SCALE / 2;
+
+    double weights[3];
+    double stepsX[3];
+    double stepsY[3];
+
+    for (int e = 0; e < 3; e++) {
+        weights[e] = (double)(outTriangle.a[e] * anchorX + outTriangle.b[e] * anchorY + outTriangle.c[e]) * invArea;
+        stepsX[e] = (double)(outTriangle.a[e] * SUBPIXEL_SCALE) * invArea;
+        stepsY[e] = (double)(outTriangle.b[e] * SUBPIXEL_SCALE) * invArea;
+    }
+
+    auto makePlane = [&](float v0, float v1, float v2) {
+        scPlane plane;
+
+        plane.base = (float)(weights[0] * v0 + weights[1] * v1 + weights[2] * v2);
+        plane.stepX = (float)(stepsX[0] * v0 + stepsX[1] * v1 + stepsX[2] * v2);
+        plane.stepY = (float)(stepsY[0] * v0 + stepsY[1] * v1 + stepsY[2] * v2);
+
+        return plane;
+    };
+
+    outTriangle.invW = makePlane(invW[0], invW[1], invW[2]);
+    outTriangle.depth = makePlane(depth[0], depth[1], depth[2]);
+    outTriangle.firstVarying = (uint32_t)_varyingPlanes.size();
+
+    for (int v = 4; v < vertices.streamCount; v++) {
+        const float* pStream = vertices.GetStream(v);
+        _varyingPlanes.push_back(makePlane(pStream[indices[0]] * invW[0], pStream[indices[1]] * invW[1], pStream[indices[2]] * invW[2]));
+    }
+
+    return true;
+}
+
+// =========
+//  Drawing
+// =========
+bool scRasterizer::Draw(const scTransformedVertices& vertices, const scRasterTarget& target) {
+    _stats = {};
+
+    int varyingCount = vertices.streamCount - 4;
+
+    if (_program == nullptr || varyingCount < 0)
+        return false;
+
+    if (SC_FRAGMENT_VARYING_BEGIN + varyingCount * sizeof(float) > _contexts[0]->GetMemorySize())
+        return false;
+
+    if (target.width <= 0 || target.height <= 0)
+        return true;
+
+    bool indexed = !vertices.indices.empty();
+    size_t triangleCount = (indexed ? vertices.indices.size() : (size_t)vertices.vertexCount) / 3;
+
+    _triangles.clear();
+    _triangles.reserve(triangleCount);
+
+    _varyingPlanes.clear();
+    _varyingPlanes.reserve(triangleCount * varyingCount);
+
+    for (size_t t = 0; t < triangleCount; t++) {
+        uint32_t indices[3];
+
+        for (int v = 0; v < 3; v++)
+            indices[v] = indexed ? vertices.indices[t * 3 + v] : (uint32_t)(t * 3 + v);
+
+        if (indices[0] >= (uint32_t)vertices.vertexCount || indices[1] >= (uint32_t)vertices.vertexCount || indices[2] >= (uint32_t)vertices.vertexCount)
+            return false;
+
+        scTriangle triangle;
+
+        if (SetupTriangle(vertices, indices, target, triangle))
+            _triangles.push_back(triangle);
+    }
+
+    _stats.triangles = (uint32_t)triangleCount;
+    _stats.culled = (uint32_t)(triangleCount - _triangles.size());
+
+    // Binning keeps the order of the draw, so every tile sees its triangles in the order they were submitted
+    int tilesX = (target.width + _tileSize - 1) / _tileSize;
+    int tilesY = (target.height + _tileSize - 1) / _tileSize;
+
+    _bins.resize((size_t)tilesX * tilesY);
+
+    for (std::vector<uint32_t>& bin : _bins)
+        bin.clear();
+
+    for (uint32_t t = 0; t < (uint32_t)_triangles.size(); t++) {
+        const scTriangle& triangle = _triangles[t];
+
+        for (int ty = triangle.minY / _tileSize; ty <= triangle.maxY / _tileSize; ty++) {
+            for (int tx = triangle.minX / _tileSize; tx <= triangle.maxX / _tileSize; tx++)
+                _bins[ty * tilesX + tx].push_back(t);
+        }
+    }
+
+    for (int w = 0; w < _pool.GetWorkerCount(); w++) {
+        _contexts[w]->Poke<float>(sizeof(int) * 2, target.width - 1);
+        _contexts[w]->Poke<float>(sizeof(int) * 3, target.height - 1);
+
+        _batches[w].count = 0;
+
+        _fragmentCounts[w] = 0;
+    }
+
+    _pool.Dispatch(tilesX * tilesY, [&](int worker, int tile) {
+        RasterizeTile(worker, tile % tilesX, tile / tilesX, varyingCount, target);
+    });
+
+    for (uint64_t count : _fragmentCounts)
+        _stats.fragments += count;
+
+    return true;
+}
+
+void scRasterizer::RasterizeTile(int worker, int tileX, int tileY, int varyingCount, const scRasterTarget& target) {
+    const std::vector<uint32_t>& bin = _bins[tileY * (size_t)((target.width + _tileSize - 1) / _tileSize) + tileX];
+
+    if (bin.empty())
+        return;
+
+    int tileMinX = tileX * _tileSize;
+    int tileMinY = tileY * _tileSize;
+    int tileMaxX = std::min(tileMinX + _tileSize, target.width) - 1;
+    int tileMaxY = std::min(tileMinY + _tileSize, target.height) - 1;
+
+    for (uint32_t t : bin) {
+        const scTriangle& triangle = _triangles[t];
+
+        int minX = std::max(triangle.minX, tileMinX);
+        int minY = std::max(triangle.minY, tileMinY);
+        int maxX = std::min(triangle.maxX, tileMaxX);
+        int maxY = std::min(triangle.maxY, tileMaxY);
+
+        // Tiles are a multiple of the block size, so blocks never cross into another tile
+        for (int blockY = minY & ~(BLOCK - 1); blockY <= maxY; blockY += BLOCK) {
+            for (int blockX = minX & ~(BLOCK - 1); blockX <= maxX; blockX += BLOCK) {
+                scBlockEdges edges;
+
+                bool rejected = false;
+                bool accepted = true;
+
+                int64_t centerX = (int64_t)blockX * SUBPIXEL_SCALE + SUBPIXEL_SCALE / 2;
+                int64_t centerY = (int64_t)blockY * SUBPIXEL_SCALE + SUBPIXEL_SCALE / 2;
+
+                for (int e = 0; e < 3; e++) {
+                    int64_t origin = triangle.a[e] * centerX + triangle.b[e] * centerY + triangle.c[e] + triangle.bias[e];
+
+                    // The smallest and largest value over the block are at two of its corners
+                    int64_t spanX = triangle.a[e] * BLOCK_SPAN;
+                    int64_t spanY = triangle.b[e] * BLOCK_SPAN;
+
+                    int64_t low = origin + std::min<int64_t>(spanX, 0) + std::min<int64_t>(spanY, 0);
+                    int64_t high = origin + std::max<int64_t>(spanX, 0) + std::max<int64_t>(spanY, 0);
+
+                    rejected |= high < 0;
+                    accepted &= low >= 0;
+
+                    // An edge that crosses the block is within a block span of zero, one that doesn't can be far
+                    // outside 32 bits and is left out
+                    if (low >= 0) {
+                        edges.origin[e] = 0;
+                        edges.stepX[e] = 0;
+                        edges.stepY[e] = 0;
+                    } else {
+                        edges.origin[e] = (int32_t)origin;
+                        edges.stepX[e] = (int32_t)(triangle.a[e] * SUBPIXEL_SCALE);
+                        edges.stepY[e] = (int32_t)(triangle.b[e] * SUBPIXEL_SCALE);
+                    }
+                }
+
+                if (rejected)
+                    continue;
+
+                uint64_t mask = accepted ? ~0ull : CoverBlock(edges);
+
+                // The triangle bounds within the tile are also clipped to the surface
+                mask &= GetBoundsMask(blockX, blockY, minX, minY, maxX, maxY);
+
+                while (mask != 0) {
+                    int bit = FindLowestBit(mask);
+                    mask &= mask - 1;
+
+                    EmitFragment(worker, triangle, blockX + bit % BLOCK, blockY + bit / BLOCK, varyingCount, target);
+                }
+            }
+        }
+    }
+
+    FlushBatch(worker, target);
+}
+
+void scRasterizer::EmitFragment(int worker, const scTriangle& triangle, int x, int y, int varyingCount, const scRasterTarget& target) {
+    int dx = x - triangle.minX;
+    int dy = y - triangle.minY;
+
+    float depth = 0;
+
+    if (target.pDepth != nullptr) {
+        depth = triangle.depth.Evaluate(dx, dy);
+        float& stored = target.pDepth[(size_t)y * target.width + x];
+
+        if (!(depth < stored))
+            return;
+
+        // A discarded fragment mustn't hide what's behind it
+        if (!_lateDepth)
+            stored = depth;
+    }
+
+    scFragmentBatch& batch = _batches[worker];
+    scWideVM& vm = *_contexts[worker];
+
+    int lane = batch.count++;
+
+    batch.x[lane] = x;
+    batch.y[lane] = y;
+    batch.depth[lane] = depth;
+
+    // Lanes are written as fragments arrive, the memory of a lane isn't read until the batch runs
+    vm.PokeLane<float>(lane, 0, x);
+    vm.PokeLane<float>(lane, sizeof(int), y);
+
+    if (varyingCount > 0) {
+        // Perspective correct, the varyings divided by w and 1 / w are what's linear in screen space
+        float w = 1.0f / triangle.invW.Evaluate(dx, dy);
+
+        const scPlane* pPlanes = _varyingPlanes.data() + triangle.firstVarying;
+
+        for (int v = 0; v < varyingCount; v++)
+            vm.PokeLane<float>(lane, SC_FRAGMENT_VARYING_BEGIN + v * sizeof(float), pPlanes[v].Evaluate(dx, dy) * w);
+    }
+
+    if (batch.count == scWideVM::LANE_COUNT)
+        FlushBatch(worker, target);
+}
+
+void scRasterizer::FlushBatch(int worker, const scRasterTarget& target) {
+    scFragmentBatch& batch = _batches[worker];
+
+    if (batch.count == 0)
+        return;
+
+    scWideVM& vm = *_contexts[worker];
+
+    vm.ResetRegisters();
+    vm.ExecuteTillEnd();
+
+    // FB0 - FB3 are consecutive register rows, which is the planar layout scResolveRow takes
+    constexpr int LANES = scWideVM::LANE_COUNT;
+
+    uint8_t resolved[LANES * sizeof(float) * 4];
+    scResolveRow(vm.GetRegisterLanes(scRegister::FB0), LANES, batch.count, resolved, target.format, false);
+
+    size_t pixelSize = scGetPixelSize(target.format);
+    uint32_t discarded = vm.GetDiscardMask();
+
+    // Lanes are in the order the fragments were emitted, so later triangles still land on top
+    for (int l = 0; l < batch.count; l++) {
+        if (discarded & (1u << l))
+            continue;
+
+        // The test is repeated, an earlier fragment of the same batch may have covered this one since
+        if (_lateDepth && target.pDepth != nullptr) {
+            float& stored = target.pDepth[(size_t)batch.y[l] * target.width + batch.x[l]];
+
+            if (!(batch.depth[l] < stored))
+                continue;
+
+            stored = batch.depth[l];
+        }
+
+        uint8_t* pPixel = target.pPixels + (size_t)batch.y[l] * target.pitch + batch.x[l] * pixelSize;
+        std::memcpy(pPixel, resolved + l * pixelSize, pixelSize);
+    }
+
+    _fragmentCounts[worker] += batch.count;
+    batch.count = 0;
+}
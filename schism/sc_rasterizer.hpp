@@ -0,0 +1,199 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_RASTERIZER_HPP
+#define SCHISM_SC_RASTERIZER_HPP
+
+#include <cstdint>
+
+#include <memory>
+#include <vector>
+
+#include <schism/sc_module.hpp>
+#include <schism/sc_hoisting.hpp>
+#include <schism/sc_resolve.hpp>
+#include <schism/sc_texture.hpp>
+#include <schism/sc_vm_wide.hpp>
+#include <schism/sc_worker_pool.hpp>
+#include <schism/sc_vertex_processor.hpp>
+
+// Varying v of a fragment is at SC_FRAGMENT_VARYING_BEGIN + v * 4, x / y and the surface size stay where scRenderer
+// puts them
+constexpr uint32_t SC_FRAGMENT_VARYING_BEGIN = SC_UNIFORM_MEMORY_END;
+
+// Vertex positions are snapped to 1 / 16th of a pixel
+constexpr int SC_RASTER_SUBPIXEL_BITS = 4;
+
+// Coverage is computed for blocks of 8 x 8 pixels at a time
+constexpr int SC_RASTER_BLOCK_SIZE = 8;
+
+// Triangles with a vertex further than this many pixels outside the surface are culled, within it the edge functions
+// of a block always fit in 32 bits
+constexpr int SC_RASTER_GUARD_BAND = 1 << 14;
+
+// struct scRasterTarget
+//   - The surface a draw writes to, pDepth is optional and holds one float per pixel
+struct scRasterTarget {
+    uint8_t* pPixels = nullptr;
+    size_t pitch = 0;
+    scPixelFormat format = scPixelFormat::RGBA8;
+
+    int width = 0;
+    int height = 0;
+
+    float* pDepth = nullptr;
+};
+
+// struct scRasterStats
+//   - What the last draw did
+struct scRasterStats {
+    uint32_t triangles = 0;
+    uint32_t culled = 0;
+
+    uint64_t fragments = 0;
+};
+
+// Rasterizes transformed triangles and shades their fragments with a Fragment scModule
+//   - Positions are the first four vertex outputs in clip space, every output after them is a perspective correct
+//     varying
+//   - Triangles are binned into square tiles, tiles are rasterized in parallel and each keeps the order of the draw
+//   - Both faces are drawn, triangles with a vertex at or behind w = 0 are culled rather than clipped
+//   - With a depth buffer fragments are tested and written before shading, nearer (smaller) z/w passes. Programs that
+//     can discard only write the depth of fragments that survived shading
+class scRasterizer {
+protected:
+    // struct scPlane
+    //   - A value that is linear in screen space, relative to the first pixel of the triangle bounds
+    struct scPlane {
+        float base;
+        float stepX;
+        float stepY;
+
+        [[nodiscard]]
+        float Evaluate(int dx, int dy) const {
+            return base + (float)dx * stepX + (float)dy * stepY;
+        }
+    };
+
+    // struct scTriangle
+    //   - A triangle after setup, edge i is opposite vertex i and positive inside
+    struct scTriangle {
+        int64_t a[3];
+        int64_t b[3];
+        int64_t c[3];
+
+        // -1 for edges that aren't top or left edges, so pixels exactly on them are left to the neighbour
+        int32_t bias[3];
+
+        int minX, minY;
+        int maxX, maxY;
+
+        scPlane invW;
+        scPlane depth;
+
+        // The varyings divided by w are linear too, they start at this index of _varyingPlanes
+        uint32_t firstVarying;
+    };
+
+    // struct scFragmentBatch
+    //   - Fragments waiting for a wide run, their inputs are already in the memory of their lanes
+    struct scFragmentBatch {
+        int count = 0;
+
+        int x[scWideVM::LANE_COUNT];
+        int y[scWideVM::LANE_COUNT];
+
+        float depth[scWideVM::LANE_COUNT];
+    };
+
+    scWorkerPool _pool;
+
+    std::vector<std::unique_ptr<scWideVM>> _contexts;
+    std::vector<scFragmentBatch> _batches;
+    std::vector<uint64_t> _fragmentCounts;
+
+    scModuleRef _program;
+
+    // Set when the program can discard, depth is then written in FlushBatch
+    bool _lateDepth = false;
+
+    int _tileSize = 64;
+
+    std::vector<scTriangle> _triangles;
+    std::vector<scPlane> _varyingPlanes;
+    std::vector<std::vector<uint32_t>> _bins;
+
+    scRasterStats _stats;
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    // threadCount includes the calling thread, 0 uses every hardware thread
+    explicit scRasterizer(int threadCount = 0, size_t memSize = 512);
+
+public:
+    // Returns false and unloads the current program if program isn't a Fragment module or needs more memory than the
+    // contexts have
+    bool LoadProgram(scModuleRef program);
+
+    // Rounded up to a multiple of SC_RASTER_BLOCK_SIZE
+    void SetTileSize(int size);
+
+    // Binds texture to slot of every context, returns false if slot is out of range
+    bool BindTexture(int slot, scTextureRef texture);
+
+    [[nodiscard]]
+    int GetThreadCount() const {
+        return _pool.GetWorkerCount();
+    }
+
+    [[nodiscard]]
+    const scRasterStats& GetStats() const {
+        return _stats;
+    }
+
+    // Draws a triangle list, every three indices of vertices.indices are a triangle, or every three vertices when
+    // there are no indices
+    //   - Returns false if nothing is loaded, there is no position or the varyings don't fit in memory
+    bool Draw(const scTransformedVertices& vertices, const scRasterTarget& target);
+
+protected:
+    bool SetupTriangle(const scTransformedVertices& vertices, const uint32_t indices[3], const scRasterTarget& target, scTriangle& outTriangle);
+
+    void RasterizeTile(int worker, int tileX, int tileY, int varyingCount, const scRasterTarget& target);
+
+    void EmitFragment(int worker, const scTriangle& triangle, int x, int y, int varyingCount, const scRasterTarget& target);
+
+    void FlushBatch(int worker, const scRasterTarget& target);
+};
+
+#endif //SCHISM_SC_RASTERIZER_HPP
@@ -0,0 +1,372 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_renderer.hpp"
+
+#include <cstring>
+
+#include <algorithm>
+
+// Fills the size x size block at x / y, clipped to the surface
+static void WriteBlock(const scRenderer::scRenderTarget& target, int x, int y, int size, float r, float g, float b, float a) {
+    int x1 = std::min(x + size, target.width);
+    int y1 = std::min(y + size, target.height);
+
+    size_t pixelSize = scGetPixelSize(target.format);
+
+    uint8_t pixel[sizeof(float) * 4];
+    scResolvePixel(r, g, b, a, pixel, target.format);
+
+    for (int by = y; by < y1; by++) {
+        uint8_t* pRow = target.GetRow(by);
+
+        for (int bx = x; bx < x1; bx++)
+            std::memcpy(pRow + bx * pixelSize, pixel, pixelSize);
+    }
+}
+
+// Resolves the runs of pixels in a row that weren't discarded
+static void ResolveSurvivors(const float* pPlanes, size_t planeStride, const uint8_t* pDiscarded, int count, uint8_t* pDst, scPixelFormat format) {
+    size_t pixelSize = scGetPixelSize(format);
+
+    for (int x = 0; x < count; ) {
+        while (x < count && pDiscarded[x])
+            x++;
+
+        int begin = x;
+
+        while (x < count && !pDiscarded[x])
+            x++;
+
+        if (x > begin)
+            scResolveRow(pPlanes + begin, planeStride, x - begin, pDst + begin * pixelSize, format);
+    }
+}
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scRenderer::scRenderer(int threadCount, size_t memSize) : _pool(threadCount) {
+    for (int w = 0; w < _pool.GetWorkerCount(); w++) {
+        _wideContexts.emplace_back(std::make_unique<scWideVM>(memSize));
+        _scalarContexts.emplace_back(std::make_unique<scVM>(memSize));
+    }
+
+    _resolvePlanes.resize(_pool.GetWorkerCount());
+    _discardedPixels.resize(_pool.GetWorkerCount());
+
+    SetUniformHoisting(true);
+}
+
+// ===========
+//  Rendering
+// ===========
+bool scRenderer::LoadProgram(scModuleRef program) {
+    if (program != nullptr && program->GetType() != scModuleType::Fragment)
+        program = nullptr;
+
+    if (program != nullptr && program->IsVerified() && program->GetRequiredMemory() > _scalarContexts[0]->GetMemorySize())
+        program = nullptr;
+
+    bool loaded = program != nullptr;
+
+    _program = std::move(program);
+
+    // Every context has the same memory size, so one split fits all of them
+    scHoistedProgramRef hoisted = nullptr;
+
+    if (_uniformHoisting && _program != nullptr)
+        hoisted = scHoistUniforms(*_program, _scalarContexts[0]->GetMemorySize());
+
+    for (std::unique_ptr<scWideVM>& context : _wideContexts)
+        context->LoadProgram(_program, hoisted);
+
+    for (std::unique_ptr<scVM>& context : _scalarContexts)
+        context->LoadProgram(_program, hoisted);
+
+    return loaded;
+}
+
+bool scRenderer::LoadProgram(const scModule& module) {
+    return LoadProgram(scShareModule(module));
+}
+
+void scRenderer::SetTileSize(int width, int height) {
+    _tileWidth = std::max(1, width);
+    _tileHeight = std::max(1, height);
+}
+
+void scRenderer::SetUniformHoisting(bool enabled) {
+    _uniformHoisting = enabled;
+
+    // Contexts would reload and split the program on their own
+    for (std::unique_ptr<scWideVM>& context : _wideContexts) {
+        context->LoadProgram(nullptr);
+        context->SetUniformHoisting(enabled);
+    }
+
+    for (std::unique_ptr<scVM>& context : _scalarContexts) {
+        context->LoadProgram(nullptr);
+        context->SetUniformHoisting(enabled);
+    }
+
+    LoadProgram(_program);
+}
+
+void scRenderer::SetBackend(scRenderBackend backend) {
+    _backend = backend;
+}
+
+scDispatchMode scRenderer::SetDispatchMode(scDispatchMode mode) {
+    for (std::unique_ptr<scVM>& context : _scalarContexts)
+        mode = context->SetDispatchMode(mode);
+
+    return mode;
+}
+
+bool scRenderer::BindTexture(int slot, scTextureRef texture) {
+    bool bound = true;
+
+    for (std::unique_ptr<scWideVM>& context : _wideContexts)
+        bound = context->BindTexture(slot, texture) && bound;
+
+    for (std::unique_ptr<scVM>& context : _scalarContexts)
+        bound = context->BindTexture(slot, texture) && bound;
+
+    return bound;
+}
+
+void scRenderer::Render(int width, int height, uint8_t* pPixels, size_t pitch, scPixelFormat format) {
+    RenderRows({ 1, false, false }, 0, height, { pPixels, pitch, 0, width, height, format });
+}
+
+void scRenderer::RenderBand(int width, int height, int y0, int y1, uint8_t* pPixels, size_t pitch, scPixelFormat format) {
+    // Band buffers are reused, a discarded pixel would otherwise keep what an earlier band left there
+    RenderRows({ 1, false, true }, y0, y1, { pPixels, pitch, y0, width, height, format });
+}
+
+void scRenderer::RenderProgressive(int pass, int width, int height, int y0, int y1, uint8_t* pPixels, size_t pitch, scPixelFormat format) {
+    if (pass < 0 || pass >= SC_PROGRESSIVE_PASS_COUNT)
+        return;
+
+    // The step halves every pass, starting at SC_PROGRESSIVE_ROW_ALIGNMENT
+    int step = SC_PROGRESSIVE_ROW_ALIGNMENT >> pass;
+
+    // A coarser pass may have filled a discarded pixel from a neighbour, so it has to be cleared rather than skipped
+    RenderRows({ step, pass > 0, true }, y0, y1, { pPixels, pitch, 0, width, height, format });
+}
+
+void scRenderer::RenderRows(scSamplePattern pattern, int y0, int y1, const scRenderTarget& target) {
+    int width = target.width;
+    int height = target.height;
+
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, height);
+
+    if (width <= 0 || height <= 0 || y0 >= y1)
+        return;
+
+    for (int w = 0; w < _pool.GetWorkerCount(); w++) {
+        _wideContexts[w]->Poke<float>(sizeof(int) * 2, width - 1);
+        _wideContexts[w]->Poke<float>(sizeof(int) * 3, height - 1);
+
+        _scalarContexts[w]->Poke<float>(sizeof(int) * 2, width - 1);
+        _scalarContexts[w]->Poke<float>(sizeof(int) * 3, height - 1);
+    }
+
+    // Tiles are a multiple of twice the step in size, so no block crosses into a tile another worker owns
+    int align = pattern.step * 2;
+
+    int tileWidth = (_tileWidth + align - 1) / align * align;
+    int tileHeight = (_tileHeight + align - 1) / align * align;
+
+    // The wide backend runs whole lane groups, so the planes hold up to a lane group past the end of a tile
+    _planeStride = (size_t)(tileWidth + scWideVM::LANE_COUNT - 1) / scWideVM::LANE_COUNT * scWideVM::LANE_COUNT;
+
+    for (std::vector<float>& planes : _resolvePlanes)
+        planes.resize(_planeStride * 4);
+
+    for (std::vector<uint8_t>& discarded : _discardedPixels)
+        discarded.resize(_planeStride);
+
+    int tilesX = (width + tileWidth - 1) / tileWidth;
+    int tilesY = (y1 - y0 + tileHeight - 1) / tileHeight;
+
+    _pool.Dispatch(tilesX * tilesY, [&](int worker, int tile) {
+        int tx0 = (tile % tilesX) * tileWidth;
+        int ty0 = y0 + (tile / tilesX) * tileHeight;
+
+        int tx1 = std::min(tx0 + tileWidth, width);
+        int ty1 = std::min(ty0 + tileHeight, y1);
+
+        float* pPlanes = _resolvePlanes[worker].data();
+        uint8_t* pDiscarded = _discardedPixels[worker].data();
+
+        if (_backend == scRenderBackend::Wide)
+            RenderTileWide(*_wideContexts[worker], pPlanes, pDiscarded, pattern, tx0, ty0, tx1, ty1, target);
+        else
+            RenderTileScalar(*_scalarContexts[worker], pPlanes, pDiscarded, pattern, tx0, ty0, tx1, ty1, target);
+    });
+}
+
+void scRenderer::RenderTileWide(scWideVM& vm, float* pPlanes, uint8_t* pDiscarded, scSamplePattern pattern, int x0, int y0, int x1, int y1, const scRenderTarget& target) {
+    const float* pR = vm.GetRegisterLanes(scRegister::FB0);
+    const float* pG = vm.GetRegisterLanes(scRegister::FB1);
+    const float* pB = vm.GetRegisterLanes(scRegister::FB2);
+    const float* pA = vm.GetRegisterLanes(scRegister::FB3);
+
+    int step = pattern.step;
+
+    for (int y = y0; y < y1; y += step) {
+        int xBegin = x0;
+        int xStep = step;
+
+        // Every other pixel of this row belongs to the coarser pass
+        if (pattern.skipCoarse && y % (step * 2) == 0) {
+            xBegin += step;
+            xStep *= 2;
+        }
+
+        // Rows that execute every pixel are collected and resolved at once, anything sparser fills its blocks directly
+        bool resolveRow = xStep == 1;
+        bool anyDiscarded = false;
+
+        for (int x = xBegin; x < x1; x += xStep * scWideVM::LANE_COUNT) {
+            vm.ResetRegisters();
+
+            for (int l = 0; l < scWideVM::LANE_COUNT; l++) {
+                vm.PokeLane<float>(l, 0, x + l * xStep);
+                vm.PokeLane<float>(l, sizeof(int), y);
+            }
+
+            vm.ExecuteTillEnd();
+
+            int lanes = std::min(scWideVM::LANE_COUNT, (x1 - x + xStep - 1) / xStep);
+            uint32_t discarded = vm.GetDiscardMask();
+
+            if (resolveRow) {
+                float* pPlane = pPlanes + (x - x0);
+
+                std::memcpy(pPlane, pR, sizeof(float) * scWideVM::LANE_COUNT);
+                std::memcpy(pPlane + _planeStride, pG, sizeof(float) * scWideVM::LANE_COUNT);
+                std::memcpy(pPlane + _planeStride * 2, pB, sizeof(float) * scWideVM::LANE_COUNT);
+                std::memcpy(pPlane + _planeStride * 3, pA, sizeof(float) * scWideVM::LANE_COUNT);
+
+                for (int l = 0; l < scWideVM::LANE_COUNT; l++) {
+                    bool laneDiscarded = (discarded >> l) & 1;
+
+                    if (laneDiscarded && pattern.clearDiscarded) {
+                        for (int c = 0; c < 4; c++)
+                            pPlane[l + _planeStride * c] = 0.0f;
+                    }
+
+                    pDiscarded[x - x0 + l] = laneDiscarded && !pattern.clearDiscarded;
+                }
+
+                anyDiscarded |= discarded != 0 && !pattern.clearDiscarded;
+            } else {
+                for (int l = 0; l < lanes; l++) {
+                    if (!(discarded & (1u << l)))
+                        WriteBlock(target, x + l * xStep, y, step, pR[l], pG[l], pB[l], pA[l]);
+                    else if (pattern.clearDiscarded)
+                        WriteBlock(target, x + l * xStep, y, step, 0.0f, 0.0f, 0.0f, 0.0f);
+                }
+            }
+        }
+
+        uint8_t* pRow = target.GetRow(y) + x0 * scGetPixelSize(target.format);
+
+        if (resolveRow && anyDiscarded)
+            ResolveSurvivors(pPlanes, _planeStride, pDiscarded, x1 - x0, pRow, target.format);
+        else if (resolveRow)
+            scResolveRow(pPlanes, _planeStride, x1 - x0, pRow, target.format);
+    }
+}
+
+void scRenderer::RenderTileScalar(scVM& vm, float* pPlanes, uint8_t* pDiscarded, scSamplePattern pattern, int x0, int y0, int x1, int y1, const scRenderTarget& target) {
+    int step = pattern.step;
+
+    for (int y = y0; y < y1; y += step) {
+        int xBegin = x0;
+        int xStep = step;
+
+        if (pattern.skipCoarse && y % (step * 2) == 0) {
+            xBegin += step;
+            xStep *= 2;
+        }
+
+        bool resolveRow = xStep == 1;
+        bool anyDiscarded = false;
+
+        for (int x = xBegin; x < x1; x += xStep) {
+            vm.ResetRegisters();
+
+            vm.Poke<float>(0, x);
+            vm.Poke<float>(sizeof(int), y);
+            vm.ExecuteTillEnd();
+
+            bool discarded = vm.IsDiscarded();
+
+            if (resolveRow && !pattern.clearDiscarded) {
+                pDiscarded[x - x0] = discarded;
+                anyDiscarded |= discarded;
+            }
+
+            if (discarded && !pattern.clearDiscarded)
+                continue;
+
+            float r = discarded ? 0.0f : vm.GetRegister(scRegister::FB0).f32;
+            float g = discarded ? 0.0f : vm.GetRegister(scRegister::FB1).f32;
+            float b = discarded ? 0.0f : vm.GetRegister(scRegister::FB2).f32;
+            float a = discarded ? 0.0f : vm.GetRegister(scRegister::FB3).f32;
+
+            if (resolveRow) {
+                float* pPlane = pPlanes + (x - x0);
+
+                pPlane[0] = r;
+                pPlane[_planeStride] = g;
+                pPlane[_planeStride * 2] = b;
+                pPlane[_planeStride * 3] = a;
+
+                continue;
+            }
+
+            WriteBlock(target, x, y, step, r, g, b, a);
+        }
+
+        uint8_t* pRow = target.GetRow(y) + x0 * scGetPixelSize(target.format);
+
+        if (resolveRow && anyDiscarded)
+            ResolveSurvivors(pPlanes, _planeStride, pDiscarded, x1 - x0, pRow, target.format);
+        else if (resolveRow)
+            scResolveRow(pPlanes, _planeStride, x1 - x0, pRow, target.format);
+    }
+}
@@ -0,0 +1,186 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_RENDERER_HPP
+#define SCHISM_SC_RENDERER_HPP
+
+#include <cstdint>
+
+#include <memory>
+#include <vector>
+
+#include <schism/sc_module.hpp>
+#include <schism/sc_vm.hpp>
+#include <schism/sc_vm_wide.hpp>
+#include <schism/sc_worker_pool.hpp>
+#include <schism/sc_resolve.hpp>
+#include <schism/sc_texture.hpp>
+
+// enum scRenderBackend
+//   - The kind of execution context every worker renders with
+enum class scRenderBackend : uint8_t {
+    // scWideVM, LANE_COUNT pixels per run
+    Wide,
+
+    // scVM, one pixel per run using the selected scDispatchMode
+    Scalar,
+};
+
+// Number of passes scRenderer::RenderProgressive splits a surface into
+constexpr int SC_PROGRESSIVE_PASS_COUNT = 3;
+
+// Rows passed to scRenderer::RenderProgressive have to start on a multiple of this
+constexpr int SC_PROGRESSIVE_ROW_ALIGNMENT = 4;
+
+// Renders a fragment scModule over a whole surface
+//   - The surface is split into tiles which are scheduled across a work stealing scWorkerPool
+//   - Every worker owns its own execution contexts, nothing is shared between threads while rendering
+//   - Follows the memory layout of the GUI, x / y at 0x00 / 0x04 and (width - 1) / (height - 1) at 0x08 / 0x0C
+class scRenderer {
+protected:
+    scWorkerPool _pool;
+
+    std::vector<std::unique_ptr<scWideVM>> _wideContexts;
+    std::vector<std::unique_ptr<scVM>> _scalarContexts;
+
+    // A row of a tile in planar FB0 - FB3 floats per worker, resolved into the target once it's complete
+    std::vector<std::vector<float>> _resolvePlanes;
+    size_t _planeStride = 0;
+
+    // Non zero for the pixels of the same row that were discarded, they're left as they are in the target
+    std::vector<std::vector<uint8_t>> _discardedPixels;
+
+    // Shared by every context, they only own their registers and memory
+    scModuleRef _program;
+
+    scRenderBackend _backend = scRenderBackend::Wide;
+
+    bool _uniformHoisting = true;
+
+    int _tileWidth = 64;
+    int _tileHeight = 16;
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    // threadCount includes the calling thread, 0 uses every hardware thread
+    explicit scRenderer(int threadCount = 0, size_t memSize = 512);
+
+public:
+    // Every worker context references program, it's split for uniform hoisting once rather than per context
+    //   - Returns false if program isn't a Fragment module or was verified for more memory than the contexts have,
+    //     nothing is loaded then
+    bool LoadProgram(scModuleRef program);
+
+    bool LoadProgram(const scModule& module);
+
+    [[nodiscard]]
+    int GetThreadCount() const {
+        return _pool.GetWorkerCount();
+    }
+
+    void SetTileSize(int width, int height);
+
+    // On by default, the uniform prologue of the program then runs once per worker per surface size
+    void SetUniformHoisting(bool enabled);
+
+    [[nodiscard]]
+    bool GetUniformHoisting() const {
+        return _uniformHoisting;
+    }
+
+    void SetBackend(scRenderBackend backend);
+
+    [[nodiscard]]
+    scRenderBackend GetBackend() const {
+        return _backend;
+    }
+
+    // Applies to the Scalar backend, returns the mode actually in use
+    scDispatchMode SetDispatchMode(scDispatchMode mode);
+
+    // Binds texture to slot of every context of both backends, returns false if slot is out of range
+    bool BindTexture(int slot, scTextureRef texture);
+
+    // Renders every pixel into pPixels, pitch is the size of a row in bytes
+    void Render(int width, int height, uint8_t* pPixels, size_t pitch, scPixelFormat format = scPixelFormat::RGBA8);
+
+    // Renders the pixels pass adds to the passes before it within rows [y0, y1), each fills the block it stands for
+    //   - Pass 0 renders every 4th pixel of every 4th row as 4x4 blocks, pass 1 the rest of every 2nd as 2x2 blocks,
+    //     pass 2 whatever is left
+    //   - Running every pass once over a surface executes each pixel exactly once and gives the same image as Render
+    //     over a surface cleared to transparent black, discarded samples clear the block they stand for
+    //   - y0 has to be a multiple of SC_PROGRESSIVE_ROW_ALIGNMENT, blocks may write up to that many rows past y1
+    void RenderProgressive(int pass, int width, int height, int y0, int y1, uint8_t* pPixels, size_t pitch, scPixelFormat format = scPixelFormat::RGBA8);
+
+    // Renders rows [y0, y1) of a width x height surface, pPixels only holds those rows and starts at y0
+    //   - Discarded pixels are cleared to transparent black, so bands match Render over a cleared surface whatever
+    //     the buffer held before
+    void RenderBand(int width, int height, int y0, int y1, uint8_t* pPixels, size_t pitch, scPixelFormat format = scPixelFormat::RGBA8);
+
+    // struct scRenderTarget
+    //   - The pixels of a render, pPixels holds row originY of a width x height surface
+    struct scRenderTarget {
+        uint8_t* pPixels;
+        size_t pitch;
+        int originY;
+
+        int width;
+        int height;
+
+        scPixelFormat format;
+
+        [[nodiscard]]
+        uint8_t* GetRow(int y) const {
+            return pPixels + (size_t)(y - originY) * pitch;
+        }
+    };
+
+protected:
+    // struct scSamplePattern
+    //   - Which pixels a render executes, every step-th pixel of every step-th row, filling step x step blocks
+    //   - skipCoarse leaves out the pixels a pattern with twice the step already covered
+    //   - clearDiscarded fills the blocks of discarded pixels with transparent black instead of leaving them alone
+    struct scSamplePattern {
+        int step;
+        bool skipCoarse;
+        bool clearDiscarded;
+    };
+
+    void RenderRows(scSamplePattern pattern, int y0, int y1, const scRenderTarget& target);
+
+    void RenderTileWide(scWideVM& vm, float* pPlanes, uint8_t* pDiscarded, scSamplePattern pattern, int x0, int y0, int x1, int y1, const scRenderTarget& target);
+
+    void RenderTileScalar(scVM& vm, float* pPlanes, uint8_t* pDiscarded, scSamplePattern pattern, int x0, int y0, int x1, int y1, const scRenderTarget& target);
+};
+
+#endif //SCHISM_SC_RENDERER_HPP
@@ -0,0 +1,330 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_resolve.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include <vector>
+#include <algorithm>
+
+#include <schism/sc_cpu.hpp>
+
+#ifdef SCHISM_ARCH_X86
+#include <immintrin.h>
+#endif
+
+const char* scGetPixelFormatName(scPixelFormat format) {
+    switch (format) {
+        case scPixelFormat::RGBA8:
+            return "RGBA8";
+
+        case scPixelFormat::RGBA32F:
+            return "RGBA32F";
+
+        case scPixelFormat::ARGB8888:
+            return "ARGB8888";
+
+        case scPixelFormat::RGB10A2:
+            return "RGB10A2";
+
+        case scPixelFormat::RGBA8Srgb:
+            return "RGBA8Srgb";
+
+        case scPixelFormat::ARGB8888Srgb:
+            return "ARGB8888Srgb";
+
+        default:
+            break;
+    }
+
+    return nullptr;
+}
+
+// ======
+//  sRGB
+// ======
+
+// Encoded 8 bit values are looked up by the top 10 mantissa bits and the exponent of the linear value
+//   - Values below 2^-13 encode to 0 and are clamped up to it, 13 exponents remain below 1.0
+//   - A bucket is 2^-10 of its value wide, that stays well under half a step of the encoded output
+static constexpr uint32_t SRGB_MIN_BITS = (127 - 13) << 23;
+static constexpr int SRGB_INDEX_SHIFT = 23 - 10;
+static constexpr int SRGB_TABLE_SIZE = (13 << 10) + 1;
+
+static const uint8_t* GetSrgbTable() {
+    static const std::vector<uint8_t> table = []() {
+        std::vector<uint8_t> entries(SRGB_TABLE_SIZE);
+
+        for (int i = 0; i < SRGB_TABLE_SIZE; i++) {
+            uint32_t bits = SRGB_MIN_BITS + ((uint32_t)i << SRGB_INDEX_SHIFT) + (1u << (SRGB_INDEX_SHIFT - 1));
+
+            float linear;
+            std::memcpy(&linear, &bits, sizeof(float));
+
+            linear = std::min(linear, 1.0f);
+
+            double encoded = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow((double)linear, 1.0 / 2.4) - 0.055;
+            entries[i] = (uint8_t)(encoded * 255.0 + 0.5);
+        }
+
+        return entries;
+    }();
+
+    return table.data();
+}
+
+// Comparisons are ordered so NaN saturates to 1, the same as minps / maxps with these operands
+static inline float Saturate(float value) {
+    value = value < 1.0f ? value : 1.0f;
+    return value > 0.0f ? value : 0.0f;
+}
+
+static inline uint32_t Quantize(float value, float scale) {
+    return (uint32_t)(Saturate(value) * scale + 0.5f);
+}
+
+static inline uint32_t EncodeSrgb(const uint8_t* pTable, float value) {
+    uint32_t bits;
+
+    value = Saturate(value);
+    std::memcpy(&bits, &value, sizeof(float));
+
+    bits = bits > SRGB_MIN_BITS ? bits : SRGB_MIN_BITS;
+    return pTable[(bits - SRGB_MIN_BITS) >> SRGB_INDEX_SHIFT];
+}
+
+static inline uint32_t PackWord(scPixelFormat format, uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+    switch (format) {
+        case scPixelFormat::ARGB8888:
+        case scPixelFormat::ARGB8888Srgb:
+            return (a << 24) | (r << 16) | (g << 8) | b;
+
+        case scPixelFormat::RGB10A2:
+            return (a << 30) | (b << 20) | (g << 10) | r;
+
+        default: {
+            uint8_t bytes[4] = { (uint8_t)r, (uint8_t)g, (uint8_t)b, (uint8_t)a };
+            uint32_t word;
+
+            std::memcpy(&word, bytes, sizeof(word));
+            return word;
+        }
+    }
+}
+
+static inline bool IsSrgb(scPixelFormat format) {
+    return format == scPixelFormat::RGBA8Srgb || format == scPixelFormat::ARGB8888Srgb;
+}
+
+// =================
+//  Generic Resolve
+// =================
+void scResolvePixel(float r, float g, float b, float a, uint8_t* pDst, scPixelFormat format) {
+    if (format == scPixelFormat::RGBA32F) {
+        float pixel[4] = { r, g, b, a };
+        std::memcpy(pDst, pixel, sizeof(pixel));
+
+        return;
+    }
+
+    uint32_t qr, qg, qb, qa;
+
+    if (IsSrgb(format)) {
+        const uint8_t* pTable = GetSrgbTable();
+
+        qr = EncodeSrgb(pTable, r);
+        qg = EncodeSrgb(pTable, g);
+        qb = EncodeSrgb(pTable, b);
+        qa = Quantize(a, 255.0f);
+    } else if (format == scPixelFormat::RGB10A2) {
+        qr = Quantize(r, 1023.0f);
+        qg = Quantize(g, 1023.0f);
+        qb = Quantize(b, 1023.0f);
+        qa = Quantize(a, 3.0f);
+    } else {
+        qr = Quantize(r, 255.0f);
+        qg = Quantize(g, 255.0f);
+        qb = Quantize(b, 255.0f);
+        qa = Quantize(a, 255.0f);
+    }
+
+    uint32_t word = PackWord(format, qr, qg, qb, qa);
+    std::memcpy(pDst, &word, sizeof(word));
+}
+
+static void ResolveGeneric(const float* pPlanes, size_t planeStride, int begin, int end, uint8_t* pDst, scPixelFormat format) {
+    const float* pR = pPlanes;
+    const float* pG = pR + planeStride;
+    const float* pB = pG + planeStride;
+    const float* pA = pB + planeStride;
+
+    size_t pixelSize = scGetPixelSize(format);
+
+    for (int x = begin; x < end; x++)
+        scResolvePixel(pR[x], pG[x], pB[x], pA[x], pDst + x * pixelSize, format);
+}
+
+#ifdef SCHISM_ARCH_X86
+// ==============
+//  SSE2 Resolve
+// ==============
+SC_TARGET("sse2") static inline __m128 SSE2_Saturate(__m128 value) {
+    return _mm_max_ps(_mm_min_ps(value, _mm_set1_ps(1.0f)), _mm_setzero_ps());
+}
+
+SC_TARGET("sse2") static inline __m128i SSE2_Quantize(__m128 value, float scale) {
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(SSE2_Saturate(value), _mm_set1_ps(scale)), _mm_set1_ps(0.5f)));
+}
+
+// The table lookups stay scalar, only the index math is vectorized
+SC_TARGET("sse2") static inline __m128i SSE2_EncodeSrgb(const uint8_t* pTable, __m128 value) {
+    __m128i bits = _mm_castps_si128(SSE2_Saturate(value));
+    __m128i minBits = _mm_set1_epi32((int)SRGB_MIN_BITS);
+
+    // Saturated values are positive, so a signed comparison orders them correctly
+    bits = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi32(bits, minBits), bits), _mm_andnot_si128(_mm_cmpgt_epi32(bits, minBits), minBits));
+
+    alignas(16) uint32_t indices[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_srli_epi32(_mm_sub_epi32(bits, minBits), SRGB_INDEX_SHIFT));
+
+    return _mm_setr_epi32(pTable[indices[0]], pTable[indices[1]], pTable[indices[2]], pTable[indices[3]]);
+}
+
+SC_TARGET("sse2") static void SSE2_Resolve(const float* pPlanes, size_t planeStride, int count, uint8_t* pDst, scPixelFormat format, bool streaming) {
+    const float* pR = pPlanes;
+    const float* pG = pR + planeStride;
+    const float* pB = pG + planeStride;
+    const float* pA = pB + planeStride;
+
+    size_t pixelSize = scGetPixelSize(format);
+
+    // Pixels before the first 16 byte boundary are resolved one at a time, the rest can be streamed
+    int head = 0;
+
+    if (streaming && format != scPixelFormat::RGBA32F && (uintptr_t)pDst % 4 == 0)
+        head = std::min(count, (int)((16 - (uintptr_t)pDst % 16) % 16 / 4));
+
+    bool stream = streaming && (uintptr_t)(pDst + head * pixelSize) % 16 == 0;
+
+    ResolveGeneric(pPlanes, planeStride, 0, head, pDst, format);
+
+    int x = head;
+    const uint8_t* pTable = IsSrgb(format) ? GetSrgbTable() : nullptr;
+
+    for (; x + 4 <= count; x += 4) {
+        __m128 r = _mm_loadu_ps(pR + x);
+        __m128 g = _mm_loadu_ps(pG + x);
+        __m128 b = _mm_loadu_ps(pB + x);
+        __m128 a = _mm_loadu_ps(pA + x);
+
+        __m128i* pOut = reinterpret_cast<__m128i*>(pDst + x * pixelSize);
+
+        if (format == scPixelFormat::RGBA32F) {
+            _MM_TRANSPOSE4_PS(r, g, b, a);
+
+            __m128i rows[4] = { _mm_castps_si128(r), _mm_castps_si128(g), _mm_castps_si128(b), _mm_castps_si128(a) };
+
+            for (int p = 0; p < 4; p++) {
+                if (stream)
+                    _mm_stream_si128(pOut + p, rows[p]);
+                else
+                    _mm_storeu_si128(pOut + p, rows[p]);
+            }
+
+            continue;
+        }
+
+        __m128i qr, qg, qb, qa, word;
+
+        if (pTable != nullptr) {
+            qr = SSE2_EncodeSrgb(pTable, r);
+            qg = SSE2_EncodeSrgb(pTable, g);
+            qb = SSE2_EncodeSrgb(pTable, b);
+            qa = SSE2_Quantize(a, 255.0f);
+        } else if (format == scPixelFormat::RGB10A2) {
+            qr = SSE2_Quantize(r, 1023.0f);
+            qg = SSE2_Quantize(g, 1023.0f);
+            qb = SSE2_Quantize(b, 1023.0f);
+            qa = SSE2_Quantize(a, 3.0f);
+        } else {
+            qr = SSE2_Quantize(r, 255.0f);
+            qg = SSE2_Quantize(g, 255.0f);
+            qb = SSE2_Quantize(b, 255.0f);
+            qa = SSE2_Quantize(a, 255.0f);
+        }
+
+        // RGBA8 is a byte order, as a little endian word red is in the lowest byte
+        switch (format) {
+            case scPixelFormat::ARGB8888:
+            case scPixelFormat::ARGB8888Srgb:
+                word = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(qa, 24), _mm_slli_epi32(qr, 16)), _mm_or_si128(_mm_slli_epi32(qg, 8), qb));
+                break;
+
+            case scPixelFormat::RGB10A2:
+                word = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(qa, 30), _mm_slli_epi32(qb, 20)), _mm_or_si128(_mm_slli_epi32(qg, 10), qr));
+                break;
+
+            default:
+                word = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(qa, 24), _mm_slli_epi32(qb, 16)), _mm_or_si128(_mm_slli_epi32(qg, 8), qr));
+                break;
+        }
+
+        if (stream)
+            _mm_stream_si128(pOut, word);
+        else
+            _mm_storeu_si128(pOut, word);
+    }
+
+    ResolveGeneric(pPlanes, planeStride, x, count, pDst, format);
+
+    // Streaming stores are weakly ordered, they have to be visible before another thread reads the row
+    if (stream)
+        _mm_sfence();
+}
+#endif
+
+// =========
+//  Resolve
+// =========
+void scResolveRow(const float* pPlanes, size_t planeStride, int count, uint8_t* pDst, scPixelFormat format, bool streaming) {
+#ifdef SCHISM_ARCH_X86
+    static const bool sse2 = scGetCpuFeatures().sse2;
+
+    if (sse2) {
+        SSE2_Resolve(pPlanes, planeStride, count, pDst, format, streaming);
+        return;
+    }
+#endif
+
+    ResolveGeneric(pPlanes, planeStride, 0, count, pDst, format);
+}
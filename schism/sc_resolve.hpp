@@ -0,0 +1,77 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_RESOLVE_HPP
+#define SCHISM_SC_RESOLVE_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+// enum scPixelFormat
+//   - The layout of every pixel a render resolves FB0 - FB3 to
+//   - Integer formats clamp every channel to [0, 1] and round to the nearest step
+//   - Srgb formats encode red, green and blue with the sRGB transfer function, alpha stays linear
+enum class scPixelFormat : uint8_t {
+    // 4 bytes in R, G, B, A order
+    RGBA8,
+
+    // 4 floats, FB0 - FB3 as they are
+    RGBA32F,
+
+    // A native 32 bit word, 0xAARRGGBB, the layout of SDL_PIXELFORMAT_ARGB8888
+    ARGB8888,
+
+    // A native 32 bit word, 10 bits of red in the lowest bits then green and blue, alpha in the top 2 bits
+    RGB10A2,
+
+    RGBA8Srgb,
+    ARGB8888Srgb,
+
+    FORMAT_COUNT
+};
+
+// Size of a single pixel in bytes
+inline size_t scGetPixelSize(scPixelFormat format) {
+    return format == scPixelFormat::RGBA32F ? sizeof(float) * 4 : 4;
+}
+
+extern const char* scGetPixelFormatName(scPixelFormat format);
+
+// Converts count pixels of planar FB0 - FB3 values into a row of packed pixels
+//   - pPlanes holds count red values, then count green values at pPlanes + planeStride and so on
+//   - streaming writes with stores that bypass the cache where the host supports them, for rows that aren't read again
+//     soon, small buffers that are read right away should turn it off
+extern void scResolveRow(const float* pPlanes, size_t planeStride, int count, uint8_t* pDst, scPixelFormat format, bool streaming = true);
+
+// Converts a single pixel, matches scResolveRow exactly
+extern void scResolvePixel(float r, float g, float b, float a, uint8_t* pDst, scPixelFormat format);
+
+#endif //SCHISM_SC_RESOLVE_HPP
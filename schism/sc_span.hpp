@@ -0,0 +1,96 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_SPAN_HPP
+#define SCHISM_SC_SPAN_HPP
+
+#include <cstddef>
+
+#include <vector>
+#include <type_traits>
+
+// A non owning view over contiguous values, stands in for std::span until the project moves past C++17
+//   - Only valid while whatever owns the values is alive and unmodified
+template<typename T>
+class scSpan {
+protected:
+    T* _pData = nullptr;
+    size_t _size = 0;
+
+public:
+    scSpan() = default;
+
+    scSpan(T* pData, size_t size) : _pData(pData), _size(size) {
+
+    }
+
+    template<typename A>
+    scSpan(const std::vector<std::remove_const_t<T>, A>& values) : _pData(values.data()), _size(values.size()) {
+
+    }
+
+    [[nodiscard]]
+    T* data() const {
+        return _pData;
+    }
+
+    [[nodiscard]]
+    size_t size() const {
+        return _size;
+    }
+
+    [[nodiscard]]
+    bool empty() const {
+        return _size == 0;
+    }
+
+    T* begin() const {
+        return _pData;
+    }
+
+    T* end() const {
+        return _pData + _size;
+    }
+
+    T& operator[](size_t index) const {
+        return _pData[index];
+    }
+
+    T& front() const {
+        return _pData[0];
+    }
+
+    T& back() const {
+        return _pData[_size - 1];
+    }
+};
+
+#endif //SCHISM_SC_SPAN_HPP
@@ -0,0 +1,351 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_texture.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+
+#include <schism/sc_cpu.hpp>
+#include <schism/sc_worker_pool.hpp>
+
+#ifdef SCHISM_ARCH_X86
+#include <immintrin.h>
+#endif
+
+static constexpr int TILE = SC_TEXTURE_TILE_SIZE;
+
+// Levels with fewer rows of tiles are filled on the calling thread, handing them out costs more than it saves
+static constexpr int PARALLEL_TILE_ROWS = 8;
+
+// =========
+//  Kernels
+// =========
+static void AverageGeneric(const float* p00, const float* p10, const float* p01, const float* p11, float* pOut) {
+    for (int c = 0; c < 4; c++)
+        pOut[c] = (p00[c] + p10[c] + p01[c] + p11[c]) * 0.25f;
+}
+
+static void BlendGeneric(const float* p00, const float* p10, const float* p01, const float* p11, float tx, float ty, float* pOut) {
+    for (int c = 0; c < 4; c++) {
+        float top = p00[c] + (p10[c] - p00[c]) * tx;
+        float bottom = p01[c] + (p11[c] - p01[c]) * tx;
+
+        pOut[c] = top + (bottom - top) * ty;
+    }
+}
+
+#ifdef SCHISM_ARCH_X86
+// Texels are aligned, a whole texel is one register
+SC_TARGET("sse2") static void AverageSSE2(const float* p00, const float* p10, const float* p01, const float* p11, float* pOut) {
+    __m128 top = _mm_add_ps(_mm_load_ps(p00), _mm_load_ps(p10));
+    __m128 bottom = _mm_add_ps(_mm_load_ps(p01), _mm_load_ps(p11));
+
+    _mm_store_ps(pOut, _mm_mul_ps(_mm_add_ps(top, bottom), _mm_set1_ps(0.25f)));
+}
+
+SC_TARGET("sse2") static void BlendSSE2(const float* p00, const float* p10, const float* p01, const float* p11, float tx, float ty, float* pOut) {
+    __m128 weightX = _mm_set1_ps(tx);
+
+    __m128 t00 = _mm_load_ps(p00);
+    __m128 t01 = _mm_load_ps(p01);
+
+    __m128 top = _mm_add_ps(t00, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p10), t00), weightX));
+    __m128 bottom = _mm_add_ps(t01, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p11), t01), weightX));
+
+    _mm_storeu_ps(pOut, _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(ty))));
+}
+#endif
+
+static void Average(const float* p00, const float* p10, const float* p01, const float* p11, float* pOut) {
+#ifdef SCHISM_ARCH_X86
+    static const bool sse2 = scGetCpuFeatures().sse2;
+
+    if (sse2) {
+        AverageSSE2(p00, p10, p01, p11, pOut);
+        return;
+    }
+#endif
+
+    AverageGeneric(p00, p10, p01, p11, pOut);
+}
+
+static void Blend(const float* p00, const float* p10, const float* p01, const float* p11, float tx, float ty, float* pOut) {
+#ifdef SCHISM_ARCH_X86
+    static const bool sse2 = scGetCpuFeatures().sse2;
+
+    if (sse2) {
+        BlendSSE2(p00, p10, p01, p11, tx, ty, pOut);
+        return;
+    }
+#endif
+
+    BlendGeneric(p00, p10, p01, p11, tx, ty, pOut);
+}
+
+// ==========
+//  Creation
+// ==========
+bool scTexture::Create(int width, int height, const float* pRgba, size_t pitch, bool mipmaps, scWorkerPool* pPool) {
+    _texels = nullptr;
+    _levels.clear();
+
+    if (pRgba == nullptr || width <= 0 || height <= 0 || width > SC_TEXTURE_MAX_SIZE || height > SC_TEXTURE_MAX_SIZE)
+        return false;
+
+    int levelCount = 1;
+
+    while (mipmaps && (std::max(width, height) >> levelCount) > 0)
+        levelCount++;
+
+    size_t texelCount = 0;
+
+    for (int l = 0; l < levelCount; l++) {
+        scMipLevel level {};
+
+        level.width = std::max(1, width >> l);
+        level.height = std::max(1, height >> l);
+        level.tilesX = (level.width + TILE - 1) / TILE;
+        level.offset = texelCount;
+
+        int tilesY = (level.height + TILE - 1) / TILE;
+        texelCount += (size_t)level.tilesX * tilesY * TILE * TILE;
+
+        _levels.push_back(level);
+    }
+
+    _texels.reset(new scTexel[texelCount]);
+
+    const uint8_t* pSource = reinterpret_cast<const uint8_t*>(pRgba);
+
+    // A task is a row of tiles, so every task writes its own contiguous range of texels
+    auto fillTileRow = [&](int l, int tileRow) {
+        int y0 = tileRow * TILE;
+        int y1 = std::min(y0 + TILE, _levels[l].height);
+
+        if (l == 0)
+            Upload(pSource, pitch, y0, y1);
+        else
+            Downsample(l, y0, y1);
+    };
+
+    // Each level is built from the one before it
+    for (int l = 0; l < levelCount; l++) {
+        int tileRows = (_levels[l].height + TILE - 1) / TILE;
+
+        if (pPool != nullptr && tileRows >= PARALLEL_TILE_ROWS) {
+            pPool->Dispatch(tileRows, [&](int /*worker*/, int task) {
+                fillTileRow(l, task);
+            });
+
+            continue;
+        }
+
+        for (int t = 0; t < tileRows; t++)
+            fillTileRow(l, t);
+    }
+
+    return true;
+}
+
+// The 4 texels of a 2x2 quad at an even position are consecutive, in (0, 0), (1, 0), (0, 1), (1, 1) order
+void scTexture::Upload(const uint8_t* pSource, size_t pitch, int y0, int y1) {
+    const scMipLevel& level = _levels[0];
+
+    constexpr size_t PAIR_SIZE = sizeof(scTexel) * 2;
+
+    for (int y = y0; y < y1; y += 2) {
+        const uint8_t* pTop = pSource + (size_t)y * pitch;
+        const uint8_t* pBottom = pTop + pitch;
+
+        bool bottom = y + 1 < y1;
+        int x = 0;
+
+        for (; x + 1 < level.width; x += 2) {
+            scTexel* pQuad = &_texels[GetTexelIndex(level, x, y)];
+
+            std::memcpy(pQuad, pTop + (size_t)x * sizeof(scTexel), PAIR_SIZE);
+
+            if (bottom)
+                std::memcpy(pQuad + 2, pBottom + (size_t)x * sizeof(scTexel), PAIR_SIZE);
+        }
+
+        if (x < level.width) {
+            std::memcpy(&_texels[GetTexelIndex(level, x, y)], pTop + (size_t)x * sizeof(scTexel), sizeof(scTexel));
+
+            if (bottom)
+                std::memcpy(&_texels[GetTexelIndex(level, x, y + 1)], pBottom + (size_t)x * sizeof(scTexel), sizeof(scTexel));
+        }
+    }
+}
+
+void scTexture::Downsample(int level, int y0, int y1) {
+    const scMipLevel& target = _levels[level];
+    const scMipLevel& source = _levels[level - 1];
+
+    // Odd sizes drop their last row or column, except when a dimension is already down to 1
+    for (int y = y0; y < y1; y++) {
+        int sy0 = std::min(y * 2, source.height - 1);
+        int sy1 = std::min(y * 2 + 1, source.height - 1);
+
+        for (int x = 0; x < target.width; x++) {
+            scTexel& texel = _texels[GetTexelIndex(target, x, y)];
+
+            if (x * 2 + 1 < source.width && sy0 != sy1) {
+                const scTexel* pQuad = &_texels[GetTexelIndex(source, x * 2, y * 2)];
+
+                Average(pQuad[0].rgba, pQuad[1].rgba, pQuad[2].rgba, pQuad[3].rgba, texel.rgba);
+                continue;
+            }
+
+            int sx0 = std::min(x * 2, source.width - 1);
+            int sx1 = std::min(x * 2 + 1, source.width - 1);
+
+            Average(
+                _texels[GetTexelIndex(source, sx0, sy0)].rgba,
+                _texels[GetTexelIndex(source, sx1, sy0)].rgba,
+                _texels[GetTexelIndex(source, sx0, sy1)].rgba,
+                _texels[GetTexelIndex(source, sx1, sy1)].rgba,
+                texel.rgba
+            );
+        }
+    }
+}
+
+// ==========
+//  Sampling
+// ==========
+
+// Texel space position of a normalized coordinate, within [0, size] so it always converts to an int
+static inline float ScaleCoordinate(float coord, int size, scTextureWrap wrap) {
+    if (wrap == scTextureWrap::Repeat)
+        coord -= std::floor(coord);
+
+    float scaled = coord * (float)size;
+
+    // NaN fails the comparison and ends up at 0 as well
+    if (!(scaled > 0.0f))
+        return 0.0f;
+
+    return std::min(scaled, (float)size);
+}
+
+// x is within [-1, size]
+static inline int WrapTexel(int x, int size, scTextureWrap wrap) {
+    if (wrap == scTextureWrap::Clamp)
+        return std::clamp(x, 0, size - 1);
+
+    if (x < 0)
+        return x + size;
+
+    return x >= size ? x - size : x;
+}
+
+int scTexture::GetLevel(float lod) const {
+    int last = (int)_levels.size() - 1;
+
+    if (!(lod >= 0.5f))
+        return 0;
+
+    if (lod >= (float)last)
+        return last;
+
+    return (int)(lod + 0.5f);
+}
+
+void scTexture::SampleTexel(scTextureFilter filter, float u, float v, float lod, float* pOut) const {
+    const scMipLevel& level = _levels[GetLevel(lod)];
+
+    float x = ScaleCoordinate(u, level.width, _wrap);
+    float y = ScaleCoordinate(v, level.height, _wrap);
+
+    if (filter == scTextureFilter::Point) {
+        int tx = WrapTexel((int)x, level.width, _wrap);
+        int ty = WrapTexel((int)y, level.height, _wrap);
+
+        std::memcpy(pOut, _texels[GetTexelIndex(level, tx, ty)].rgba, sizeof(scTexel));
+        return;
+    }
+
+    // Texel centers are at half texel offsets
+    x -= 0.5f;
+    y -= 0.5f;
+
+    float floorX = std::floor(x);
+    float floorY = std::floor(y);
+
+    int x0 = (int)floorX;
+    int y0 = (int)floorY;
+
+    int x1 = WrapTexel(x0 + 1, level.width, _wrap);
+    int y1 = WrapTexel(y0 + 1, level.height, _wrap);
+
+    x0 = WrapTexel(x0, level.width, _wrap);
+    y0 = WrapTexel(y0, level.height, _wrap);
+
+    Blend(
+        _texels[GetTexelIndex(level, x0, y0)].rgba,
+        _texels[GetTexelIndex(level, x1, y0)].rgba,
+        _texels[GetTexelIndex(level, x0, y1)].rgba,
+        _texels[GetTexelIndex(level, x1, y1)].rgba,
+        x - floorX,
+        y - floorY,
+        pOut
+    );
+}
+
+void scTexture::Sample(scTextureFilter filter, const float* pU, const float* pV, const float* pLod, int count, float* pOut, size_t outStride) const {
+    if (_levels.empty()) {
+        for (int c = 0; c < 4; c++) {
+            for (int s = 0; s < count; s++)
+                pOut[c * outStride + s] = 0.0f;
+        }
+
+        return;
+    }
+
+    // Samples are taken 4 at a time and transposed into the outputs, all inputs of a group are read before that
+    for (int first = 0; first < count; first += 4) {
+        int groupSize = std::min(4, count - first);
+
+        float results[4][4];
+
+        for (int s = 0; s < groupSize; s++)
+            SampleTexel(filter, pU[first + s], pV[first + s], pLod[first + s], results[s]);
+
+        for (int c = 0; c < 4; c++) {
+            for (int s = 0; s < groupSize; s++)
+                pOut[c * outStride + first + s] = results[s][c];
+        }
+    }
+}
@@ -0,0 +1,163 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_TEXTURE_HPP
+#define SCHISM_SC_TEXTURE_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+#include <memory>
+#include <vector>
+
+class scWorkerPool;
+
+// Number of textures an execution context can have bound at once
+constexpr int SC_TEXTURE_SLOT_COUNT = 8;
+
+// Neither dimension of a texture can be larger than this
+constexpr int SC_TEXTURE_MAX_SIZE = 16384;
+
+// Mip levels are stored as square tiles of this many texels a side
+constexpr int SC_TEXTURE_TILE_SIZE = 8;
+
+// enum scTextureFilter
+//   - How a sample instruction reads a mip level, the level itself is always the one nearest to the LOD
+enum class scTextureFilter : uint8_t {
+    // The texel the coordinate falls in
+    Point,
+
+    // Weighted between the 4 texels around the coordinate
+    Linear,
+};
+
+// enum scTextureWrap
+//   - What coordinates outside of [0, 1] read
+enum class scTextureWrap : uint8_t {
+    Repeat,
+    Clamp,
+};
+
+// An immutable RGBA float image with a mip chain, shared between execution contexts through scTextureRef
+//   - Every level is split into SC_TEXTURE_TILE_SIZE tiles in row major order, the texels of a tile are in Morton
+//     order, so the 2x2 footprint of a bilinear sample is nearly always within one tile
+//   - Coordinates are normalized, (0, 0) is the top left corner of the first texel
+class scTexture {
+protected:
+    struct alignas(16) scTexel {
+        float rgba[4];
+    };
+
+    // struct scMipLevel
+    //   - offset is the index of the first texel of the level within _texels
+    struct scMipLevel {
+        int width;
+        int height;
+        int tilesX;
+
+        size_t offset;
+    };
+
+    // Left uninitialized, texels past the edge of a level only fill out its last tiles and are never read
+    std::unique_ptr<scTexel[]> _texels;
+    std::vector<scMipLevel> _levels;
+
+    scTextureWrap _wrap = scTextureWrap::Repeat;
+
+public:
+    // Copies a width x height image of RGBA floats, pitch is the size of a row in bytes
+    //   - With mipmaps every level down to 1x1 is generated with a box filter, spread over pPool when it isn't null
+    //   - Returns false and leaves the texture empty if either dimension is out of range
+    bool Create(int width, int height, const float* pRgba, size_t pitch, bool mipmaps = true, scWorkerPool* pPool = nullptr);
+
+    void SetWrap(scTextureWrap wrap) {
+        _wrap = wrap;
+    }
+
+    [[nodiscard]]
+    scTextureWrap GetWrap() const {
+        return _wrap;
+    }
+
+    [[nodiscard]]
+    int GetLevelCount() const {
+        return (int)_levels.size();
+    }
+
+    [[nodiscard]]
+    int GetWidth(int level = 0) const {
+        return _levels[level].width;
+    }
+
+    [[nodiscard]]
+    int GetHeight(int level = 0) const {
+        return _levels[level].height;
+    }
+
+    // Returns the 4 channels of a texel, x and y have to be within the level
+    [[nodiscard]]
+    const float* GetTexel(int level, int x, int y) const {
+        return _texels[GetTexelIndex(_levels[level], x, y)].rgba;
+    }
+
+    // Samples count coordinates, channel c of sample i is written to pOut[c * outStride + i]
+    //   - The LOD picks the nearest mip level, level 0 for anything below 0.5 or NaN
+    //   - Every input of a sample is read before any of its outputs are written, so they may overlap
+    void Sample(scTextureFilter filter, const float* pU, const float* pV, const float* pLod, int count, float* pOut, size_t outStride) const;
+
+protected:
+    [[nodiscard]]
+    static size_t GetTexelIndex(const scMipLevel& level, int x, int y) {
+        // Bits of the position within a tile spread to every other bit
+        static constexpr uint8_t SPREAD[SC_TEXTURE_TILE_SIZE] = { 0, 1, 4, 5, 16, 17, 20, 21 };
+
+        constexpr int TILE_SHIFT = 3;
+        constexpr int TILE_MASK = SC_TEXTURE_TILE_SIZE - 1;
+
+        size_t tile = (size_t)(y >> TILE_SHIFT) * level.tilesX + (x >> TILE_SHIFT);
+        return level.offset + tile * (SC_TEXTURE_TILE_SIZE * SC_TEXTURE_TILE_SIZE) + (SPREAD[x & TILE_MASK] | (SPREAD[y & TILE_MASK] << 1));
+    }
+
+    [[nodiscard]]
+    int GetLevel(float lod) const;
+
+    void SampleTexel(scTextureFilter filter, float u, float v, float lod, float* pOut) const;
+
+    // Copies rows [y0, y1) of the source image into level 0
+    void Upload(const uint8_t* pSource, size_t pitch, int y0, int y1);
+
+    // Fills rows [y0, y1) of a level from the level above it
+    void Downsample(int level, int y0, int y1);
+};
+
+typedef std::shared_ptr<const scTexture> scTextureRef;
+
+#endif //SCHISM_SC_TEXTURE_HPP
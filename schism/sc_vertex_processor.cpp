@@ -0,0 +1,189 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_vertex_processor.hpp"
+
+#include <algorithm>
+
+// Lane groups per task, enough that scheduling doesn't show up next to shading
+static constexpr int BATCHES_PER_TASK = 8;
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scVertexProcessor::scVertexProcessor(int threadCount, size_t memSize) : _pool(threadCount) {
+    for (int w = 0; w < _pool.GetWorkerCount(); w++) {
+        _contexts.emplace_back(std::make_unique<scWideVM>(memSize));
+        _contexts.back()->SetUniformHoisting(true);
+    }
+}
+
+// =======
+//  Setup
+// =======
+bool scVertexProcessor::LoadProgram(scModuleRef program) {
+    if (program != nullptr && program->GetType() != scModuleType::Vertex)
+        program = nullptr;
+
+    if (program != nullptr && program->IsVerified() && program->GetRequiredMemory() > _contexts[0]->GetMemorySize())
+        program = nullptr;
+
+    bool loaded = program != nullptr;
+
+    _program = std::move(program);
+
+    scHoistedProgramRef hoisted = nullptr;
+
+    if (_program != nullptr)
+        hoisted = scHoistUniforms(*_program, _contexts[0]->GetMemorySize());
+
+    for (std::unique_ptr<scWideVM>& context : _contexts)
+        context->LoadProgram(_program, hoisted);
+
+    return loaded;
+}
+
+void scVertexProcessor::SetOutputCount(int count) {
+    _outputCount = std::clamp(count, 1, SC_VERTEX_MAX_OUTPUTS);
+}
+
+void scVertexProcessor::SetUniform(uint32_t index, float value) {
+    for (std::unique_ptr<scWideVM>& context : _contexts)
+        context->Poke<float>(index, value);
+}
+
+bool scVertexProcessor::BindTexture(int slot, scTextureRef texture) {
+    bool bound = true;
+
+    for (std::unique_ptr<scWideVM>& context : _contexts)
+        bound = context->BindTexture(slot, texture) && bound;
+
+    return bound;
+}
+
+// ============
+//  Processing
+// ============
+bool scVertexProcessor::CanProcess(const scVertexInputs& inputs) const {
+    if (_program == nullptr || inputs.streamCount < 0 || inputs.vertexCount < 0)
+        return false;
+
+    return SC_VERTEX_INPUT_BEGIN + inputs.streamCount * sizeof(float) <= _contexts[0]->GetMemorySize();
+}
+
+void scVertexProcessor::Prepare(scTransformedVertices& outVertices, int vertexCount) const {
+    constexpr int LANES = scWideVM::LANE_COUNT;
+
+    // Every stream is padded to whole lane groups, so a batch is always copied out in full
+    outVertices.stride = (size_t)(vertexCount + LANES - 1) / LANES * LANES;
+    outVertices.values.resize(outVertices.stride * _outputCount);
+
+    outVertices.streamCount = _outputCount;
+    outVertices.vertexCount = vertexCount;
+}
+
+bool scVertexProcessor::Process(const scVertexInputs& inputs, scTransformedVertices& outVertices) {
+    if (!CanProcess(inputs))
+        return false;
+
+    Prepare(outVertices, inputs.vertexCount);
+    outVertices.indices.clear();
+
+    Transform(inputs, nullptr, outVertices);
+    return true;
+}
+
+bool scVertexProcessor::ProcessIndexed(const scVertexInputs& inputs, scSpan<const uint32_t> indices, scTransformedVertices& outVertices) {
+    if (!CanProcess(inputs))
+        return false;
+
+    _cacheSlots.assign(inputs.vertexCount, -1);
+    _cacheVertices.clear();
+
+    outVertices.indices.resize(indices.size());
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        uint32_t vertex = indices[i];
+
+        if (vertex >= (uint32_t)inputs.vertexCount)
+            return false;
+
+        int32_t& slot = _cacheSlots[vertex];
+
+        if (slot < 0) {
+            slot = (int32_t)_cacheVertices.size();
+            _cacheVertices.push_back(vertex);
+        }
+
+        outVertices.indices[i] = (uint32_t)slot;
+    }
+
+    Prepare(outVertices, (int)_cacheVertices.size());
+
+    Transform(inputs, _cacheVertices.data(), outVertices);
+    return true;
+}
+
+void scVertexProcessor::Transform(const scVertexInputs& inputs, const uint32_t* pVertices, scTransformedVertices& outVertices) {
+    constexpr int LANES = scWideVM::LANE_COUNT;
+    constexpr int TASK_SIZE = LANES * BATCHES_PER_TASK;
+
+    int count = outVertices.vertexCount;
+    int taskCount = (count + TASK_SIZE - 1) / TASK_SIZE;
+
+    _pool.Dispatch(taskCount, [&](int worker, int task) {
+        scWideVM& vm = *_contexts[worker];
+
+        int taskEnd = std::min((task + 1) * TASK_SIZE, count);
+
+        for (int first = task * TASK_SIZE; first < taskEnd; first += LANES) {
+            int lanes = std::min(LANES, taskEnd - first);
+
+            vm.ResetRegisters();
+
+            for (int l = 0; l < lanes; l++) {
+                uint32_t vertex = pVertices != nullptr ? pVertices[first + l] : (uint32_t)(first + l);
+
+                vm.PokeLane<float>(l, SC_VERTEX_INDEX_ADDRESS, (float)vertex);
+
+                for (int s = 0; s < inputs.streamCount; s++)
+                    vm.PokeLane<float>(l, SC_VERTEX_INPUT_BEGIN + s * sizeof(float), inputs.pStreams[s][vertex]);
+            }
+
+            vm.ExecuteTillEnd();
+
+            for (int o = 0; o < outVertices.streamCount; o++) {
+                const float* pLanes = vm.GetRegisterLanes((scRegister)((int)scRegister::S0 + o));
+                std::memcpy(outVertices.values.data() + o * outVertices.stride + first, pLanes, sizeof(float) * LANES);
+            }
+        }
+    });
+}
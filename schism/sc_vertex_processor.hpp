@@ -0,0 +1,151 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_VERTEX_PROCESSOR_HPP
+#define SCHISM_SC_VERTEX_PROCESSOR_HPP
+
+#include <cstdint>
+
+#include <memory>
+#include <vector>
+
+#include <schism/sc_span.hpp>
+#include <schism/sc_module.hpp>
+#include <schism/sc_hoisting.hpp>
+#include <schism/sc_texture.hpp>
+#include <schism/sc_vm_wide.hpp>
+#include <schism/sc_worker_pool.hpp>
+
+// Vertex modules find the index of their vertex here as a float
+constexpr uint32_t SC_VERTEX_INDEX_ADDRESS = 0x00;
+
+// Attribute stream s of the vertex is at SC_VERTEX_INPUT_BEGIN + s * 4, after the uniform memory
+constexpr uint32_t SC_VERTEX_INPUT_BEGIN = SC_UNIFORM_MEMORY_END;
+
+// Outputs are read back from S0 onwards, the first four are the position by convention
+constexpr int SC_VERTEX_MAX_OUTPUTS = 32;
+
+// struct scVertexInputs
+//   - Attribute streams in structure of arrays layout, pStreams[s][v] is attribute s of vertex v
+struct scVertexInputs {
+    const float* const* pStreams = nullptr;
+    int streamCount = 0;
+
+    int vertexCount = 0;
+};
+
+// struct scTransformedVertices
+//   - Vertex outputs in structure of arrays layout, output s of transformed vertex v is GetStream(s)[v]
+//   - Indexed draws only transform every vertex once, indices maps each index of the draw to its transformed vertex
+struct scTransformedVertices {
+    std::vector<float> values;
+    size_t stride = 0;
+
+    int streamCount = 0;
+    int vertexCount = 0;
+
+    std::vector<uint32_t> indices;
+
+    [[nodiscard]]
+    const float* GetStream(int stream) const {
+        return values.data() + stream * stride;
+    }
+};
+
+// Runs a Vertex scModule over batches of vertices
+//   - Every batch is LANE_COUNT vertices on an scWideVM, batches are spread across a work stealing scWorkerPool
+//   - Indexed draws go through a post-transform cache keyed by vertex index, so vertices shared between primitives
+//     are shaded once and the cost follows the number of unique vertices rather than indices
+class scVertexProcessor {
+protected:
+    scWorkerPool _pool;
+
+    std::vector<std::unique_ptr<scWideVM>> _contexts;
+
+    scModuleRef _program;
+
+    int _outputCount = 4;
+
+    // Transformed slot of every vertex of the current draw, -1 if it wasn't referenced yet
+    std::vector<int32_t> _cacheSlots;
+
+    // Vertex index of every transformed slot, in order of first use
+    std::vector<uint32_t> _cacheVertices;
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    // threadCount includes the calling thread, 0 uses every hardware thread
+    explicit scVertexProcessor(int threadCount = 0, size_t memSize = 512);
+
+public:
+    // Returns false and unloads the current program if program isn't a Vertex module or needs more memory than the
+    // contexts have
+    bool LoadProgram(scModuleRef program);
+
+    // Number of registers from S0 onwards that are read back per vertex
+    void SetOutputCount(int count);
+
+    [[nodiscard]]
+    int GetOutputCount() const {
+        return _outputCount;
+    }
+
+    [[nodiscard]]
+    int GetThreadCount() const {
+        return _pool.GetWorkerCount();
+    }
+
+    // Writes uniform memory of every context, see scIsUniformMemory
+    void SetUniform(uint32_t index, float value);
+
+    // Binds texture to slot of every context, returns false if slot is out of range
+    bool BindTexture(int slot, scTextureRef texture);
+
+    // Transforms every vertex in order, outVertices.indices is left empty
+    //   - Returns false if nothing is loaded or the attribute streams don't fit in memory
+    bool Process(const scVertexInputs& inputs, scTransformedVertices& outVertices);
+
+    // Transforms the vertices indices reference, each once, in order of first use
+    //   - Returns false if an index is out of range, on top of the reasons of Process
+    bool ProcessIndexed(const scVertexInputs& inputs, scSpan<const uint32_t> indices, scTransformedVertices& outVertices);
+
+protected:
+    bool CanProcess(const scVertexInputs& inputs) const;
+
+    void Prepare(scTransformedVertices& outVertices, int vertexCount) const;
+
+    // pVertices lists the vertex of every slot, null shades slot v from vertex v
+    void Transform(const scVertexInputs& inputs, const uint32_t* pVertices, scTransformedVertices& outVertices);
+};
+
+#endif //SCHISM_SC_VERTEX_PROCESSOR_HPP
@@ -1,4 +1,5 @@
 #include "sc_vm.hpp"
+#include "sc_profiler.hpp"
 
 #include <iostream>
 
@@ -58,14 +59,125 @@ const char* scGetRegisterName(scRegister regIndex) {
 // ===============
 scVM::scVM(size_t memSize) {
     this->_memory.resize(memSize);
+
+    SetDispatchMode(scDispatchMode::SCHISM_DEFAULT_DISPATCH);
 }
 
 // ======================
 //  Program Manipulation
 // ======================
-void scVM::LoadProgram(const scModule& module) {
+bool scVM::LoadProgram(scModuleRef program, scHoistedProgramRef hoisted) {
+    bool fits = program == nullptr || !program->IsVerified() || program->GetRequiredMemory() <= _memory.size();
+
+    if (!fits)
+        program = nullptr;
+
+    _sourceProgram = std::move(program);
+    _hoisted = nullptr;
+
+    if (_uniformHoisting && _sourceProgram != nullptr)
+        _hoisted = hoisted != nullptr ? std::move(hoisted) : scHoistUniforms(*_sourceProgram, _memory.size());
+
+    // Aliases the body, keeping the whole split alive
+    if (_hoisted != nullptr)
+        _program = scModuleRef(_hoisted, &_hoisted->body);
+    else
+        _program = _sourceProgram;
+
+    _uniformsDirty = true;
+    _threadedCode.clear();
+
+    _jitProgram = nullptr;
+    _jitAttempted = false;
+
     ResetRegisters();
-    _program = module;
+    return fits;
+}
+
+bool scVM::LoadProgram(const scModule& module) {
+    return LoadProgram(scShareModule(module));
+}
+
+void scVM::SetUniformHoisting(bool enabled) {
+    if (enabled == _uniformHoisting)
+        return;
+
+    _uniformHoisting = enabled;
+
+    if (_sourceProgram != nullptr)
+        LoadProgram(_sourceProgram);
+}
+
+bool scVM::BindTexture(int slot, scTextureRef texture) {
+    if (slot < 0 || slot >= SC_TEXTURE_SLOT_COUNT)
+        return false;
+
+    _textures[slot] = std::move(texture);
+    return true;
+}
+
+scDispatchMode scVM::SetDispatchMode(scDispatchMode mode) {
+    if (!IsDispatchModeSupported(mode))
+        mode = scDispatchMode::Switch;
+
+    if (mode != _dispatchMode)
+        _threadedCode.clear();
+
+    _dispatchMode = mode;
+    return mode;
+}
+
+bool scVM::SetProfiler(scProfiler* pProfiler) {
+#ifdef SCHISM_PROFILER
+    _pProfiler = pProfiler;
+    return true;
+#else
+    return pProfiler == nullptr;
+#endif
+}
+
+bool scVM::IsDispatchModeSupported(scDispatchMode mode) {
+    switch (mode) {
+        case scDispatchMode::Switch:
+            return true;
+
+        case scDispatchMode::Threaded:
+#ifdef SCHISM_HAS_COMPUTED_GOTO
+            return true;
+#else
+            return false;
+#endif
+
+        case scDispatchMode::TailCall:
+#ifdef SCHISM_HAS_MUSTTAIL
+            return true;
+#else
+            return false;
+#endif
+
+        case scDispatchMode::Jit:
+            return scJitProgram::IsSupported();
+    }
+
+    return false;
+}
+
+const char* scGetDispatchModeName(scDispatchMode mode) {
+    switch (mode) {
+        case scDispatchMode::Switch:
+            return "Switch";
+
+        case scDispatchMode::Threaded:
+            return "Threaded";
+
+        case scDispatchMode::TailCall:
+            return "TailCall";
+
+        case scDispatchMode::Jit:
+            return "Jit";
+    }
+
+    return nullptr;
 }
 
 // =======================
@@ -170,169 +282,102 @@ bool scVM::PopValue(scVariable& operand) {
 // ===================
 //  Program Execution
 // ===================
-bool scVM::ExecuteOperation(const scModule& module, uint32_t encoded) {
-    //std::cout << "EXECUTING: " << scGetOperationName(op) << "\n";
-
-    // Begin to decode the instruction
-    scInstructionGroup group = (scInstructionGroup)(encoded & 0xF);
-
-    switch (group) {
-        case scInstructionGroup::GroupZero: {
-            scGroupZeroOperations op = (scGroupZeroOperations)((encoded >> 4) & 0xFF);
-            switch (op) {
-                case scGroupZeroOperations::OpExitProgram:
-                    return false;
-            }
-        }
-
-        case scInstructionGroup::GroupOne: {
-            scGroupOneOperations op = (scGroupOneOperations)((encoded >> 4) & 0xFF);
-            scGroupOneSubOperations subOp = (scGroupOneSubOperations)((encoded >> 12) & 0xF);
-
-            scRegister aRegister = (scRegister)((encoded >> 16) & 0xFF);
-            scRegister bRegister = (scRegister)((encoded >> 24) & 0xFF);
-
-            switch (op) {
-                case scGroupOneOperations::OpMOV: {
-                    SetRegister(aRegister, GetRegister(bRegister));
-                    break;
-                }
-
-                case scGroupOneOperations::OpALUF32F32: {
-                    int simd = 1;
-
-                    // TODO: Add a helper rather than this bs
-                    if (aRegister == scRegister::V0) {
-                        simd = 4;
-                        aRegister = scRegister::S0;
-                    }
-
-                    if (bRegister == scRegister::V1) {
-                        simd = 4;
-                        bRegister = scRegister::S4;
-                    }
-
-
-                    for (int d = 0; d < simd; d++) {
-                        scValue_u aValue = GetRegister((scRegister)((int)aRegister + d));
-                        scValue_u bValue = GetRegister((scRegister)((int)bRegister + d));
-
-                        //std::cout << "LHS | " << (int)aRegister + d << " | " << aValue.f32 << std::endl;
-                        //std::cout << "RHS | " << (int)bRegister + d << " | " << bValue.f32 << std::endl;
-
-                        switch (subOp) {
-                            case scGroupOneSubOperations::SubOpAdd: {
-                                aValue.f32 = aValue.f32 + bValue.f32;
-                                break;
-                            }
-
-                            case scGroupOneSubOperations::SubOpSub: {
-                                aValue.f32 = aValue.f32 - bValue.f32;
-                                break;
-                            }
-
-                            case scGroupOneSubOperations::SubOpMul: {
-                                aValue.f32 = aValue.f32 * bValue.f32;
-                                break;
-                            }
-
-                            case scGroupOneSubOperations::SubOpDiv: {
-                                aValue.f32 = aValue.f32 / bValue.f32;
-                                break;
-                            }
-
-                            case scGroupOneSubOperations::SubOpMod: {
-                                aValue.f32 = std::fmod(aValue.f32, bValue.f32);
-                                break;
-                            }
-
-                            case scGroupOneSubOperations::SubOpPow: {
-                                aValue.f32 = powf(aValue.f32, bValue.f32);
-                                break;
-                            }
-                        }
-
-                        SetRegister((scRegister)((int)aRegister + d), aValue);
-                    }
-
-                    break;
-                }
-            }
-
-            break;
-        }
-
-        case scInstructionGroup::GroupTwo: {
-            scGroupTwoOperations op = (scGroupTwoOperations)((encoded >> 4) & 0xFF);
-            scRegister targetRegister = (scRegister)((encoded >> 12) & 0xFF);
+void scVM::ResetRegisters() {
+    _discarded = false;
 
-            // TODO: Break this into functions
-            switch (op) {
-                case scGroupTwoOperations::OpSetF32: {
-                    scValue_u value;
-                    module.ReadValue(GetRegister(scRegister::IP).u32, value.f32);
+    if (_hoisted != nullptr) {
+        if (_uniformsDirty)
+            RunPrologue();
 
-                    MoveInstructionPointer(sizeof(float));
+        _registers = _uniformRegisters;
+        return;
+    }
 
-                    SetRegister(targetRegister, value);
-                    break;
-                }
+    for (int r = 0; r < (int)scRegister::REGISTER_COUNT; r++) {
+        _registers[r].u32 = 0;
+    }
+}
 
-                case scGroupTwoOperations::OpLoadF32: {
-                    uint32_t ptr;
-                    module.ReadValue(GetRegister(scRegister::IP).u32, ptr);
+void scVM::RunPrologue() {
+    for (int r = 0; r < (int)scRegister::REGISTER_COUNT; r++) {
+        _registers[r].u32 = 0;
+    }
 
-                    MoveInstructionPointer(sizeof(uint32_t));
+    // Hoisted loads are always in range, so the prologue only stops at its EXIT
+    for (const scInstruction& instruction : _hoisted->prologue.GetInstructions()) {
+        if (!ExecuteInstruction(instruction))
+            break;
+    }
 
-                    scValue_u value;
+    _uniformRegisters = _registers;
+    _uniformsDirty = false;
+}
 
-                    if (!ReadValue(ptr, value.f32)) {
-                        return false;
-                    }
+void scVM::ExecuteTillEnd() {
+    if (_program == nullptr)
+        return;
 
-                    SetRegister(targetRegister, value);
-                    break;
-                }
+    scSpan<const scInstruction> instructions = _program->GetInstructions();
+    uint32_t ip = GetRegister(scRegister::IP).u32;
 
-                case scGroupTwoOperations::OpABSF32: {
-                    scValue_u value = GetRegister(targetRegister);
+    if (ip >= instructions.size())
+        return;
 
-                    value.f32 = fabs(value.f32);
+#ifdef SCHISM_PROFILER
+    if (_pProfiler != nullptr) {
+        RunProfiled(ip);
 
-                    SetRegister(targetRegister, value);
-                }
-            }
+        _registers[(int)scRegister::IP].u32 = ip;
+        return;
+    }
+#endif
 
+    switch (_dispatchMode) {
+        case scDispatchMode::Switch:
+            RunSwitch(ip);
             break;
-        }
-    }
 
-    //PrintStack();
+        case scDispatchMode::Threaded:
+            RunThreaded(ip);
+            break;
 
-    return true;
-}
+        case scDispatchMode::TailCall:
+            RunTailCall(ip);
+            break;
 
-void scVM::ResetRegisters() {
-    for (int r = 0; r < (int)scRegister::REGISTER_COUNT; r++) {
-        _registers[r].u32 = 0;
+        case scDispatchMode::Jit:
+            RunJit(ip);
+            break;
     }
-}
-
-void scVM::ExecuteTillEnd() {
-    bool alive = true;
-
-    while (ExecuteStep()) {
 
-    }
+    _registers[(int)scRegister::IP].u32 = ip;
 }
 
 bool scVM::ExecuteStep() {
     // TODO: Report the VM CRASH!
-    uint32_t encoded;
-    if (_program->ReadValue<uint32_t>(GetRegister(scRegister::IP).u32, encoded) != scModuleState::OK)
+    if (_program == nullptr)
         return false;
 
-    MoveInstructionPointer(sizeof(uint32_t));
+    uint32_t ip = GetRegister(scRegister::IP).u32;
+
+    if (ip >= _program->GetInstructions().size())
+        return false;
+
+    bool running;
+
+#ifdef SCHISM_PROFILER
+    if (_pProfiler != nullptr) {
+        if (ip == 0)
+            _pProfiler->BeginRun(_program->GetInstructions().size());
+
+        running = ExecuteProfiled(ip);
+    } else {
+        running = Step(_program->GetInstructions().data(), ip);
+    }
+#else
+    running = Step(_program->GetInstructions().data(), ip);
+#endif
 
-    return ExecuteOperation(_program.value(), encoded);
+    _registers[(int)scRegister::IP].u32 = ip;
+    return running;
 }
\ No newline at end of file
@@ -33,6 +33,7 @@
 #define SCHISM_SC_VM_HPP
 
 #include <cstdint>
+#include <cstring>
 
 #include <array>
 #include <vector>
@@ -43,16 +44,9 @@
 #include <schism/sc_module.hpp>
 #include <schism/sc_operations.hpp>
 #include <schism/sc_assembler.hpp>
-
-typedef union scValue {
-    int16_t i16;
-    int32_t i32;
-
-    uint16_t u16;
-    uint32_t u32;
-
-    float f32;
-} scValue_u;
+#include <schism/sc_jit.hpp>
+#include <schism/sc_hoisting.hpp>
+#include <schism/sc_texture.hpp>
 
 enum class scValueType : uint16_t {
     F32,
@@ -70,6 +64,43 @@ public:
 
 extern const char* scGetRegisterName(scRegister regIndex);
 
+// Labels as values are a GNU extension, supported by GCC and Clang
+#if defined(__GNUC__) || defined(__clang__)
+#define SCHISM_HAS_COMPUTED_GOTO 1
+#endif
+
+// Guaranteed tail calls are required for the tail call core, otherwise every instruction would cost a stack frame
+#if defined(__clang__) && defined(__has_cpp_attribute)
+#if __has_cpp_attribute(clang::musttail)
+#define SCHISM_HAS_MUSTTAIL 1
+#endif
+#endif
+
+#ifndef SCHISM_DEFAULT_DISPATCH
+#define SCHISM_DEFAULT_DISPATCH Switch
+#endif
+
+// enum scDispatchMode
+//   - Selects the interpreter core used by scVM::ExecuteTillEnd
+//   - Unsupported cores fall back to Switch
+enum class scDispatchMode : uint8_t {
+    // A single switch over the decoded opcode per instruction
+    Switch,
+
+    // Direct threaded code, each instruction jumps straight to the handler of the next one
+    Threaded,
+
+    // One function per operation, chained together with [[clang::musttail]]
+    TailCall,
+
+    // Native code from scJitProgram, programs it can't compile run on Switch instead
+    Jit,
+};
+
+extern const char* scGetDispatchModeName(scDispatchMode mode);
+
+class scProfiler;
+
 // Represents the virtual machine that handles state for a provided scModule
 class scVM {
 protected:
@@ -78,7 +109,38 @@ protected:
 
     std::array<scValue_u, static_cast<int>(scRegister::REGISTER_COUNT)> _registers;
 
-    std::optional<scModule> _program;
+    // The shared module that is executed, points into _hoisted when the loaded program was split
+    scModuleRef _program;
+
+    // The module as passed to LoadProgram
+    scModuleRef _sourceProgram;
+
+    // Set when the loaded program has a uniform prologue, ResetRegisters restores the registers it left behind
+    scHoistedProgramRef _hoisted;
+    std::array<scValue_u, static_cast<int>(scRegister::REGISTER_COUNT)> _uniformRegisters {};
+
+    bool _uniformHoisting = false;
+    bool _uniformsDirty = true;
+
+    std::array<scTextureRef, SC_TEXTURE_SLOT_COUNT> _textures {};
+
+    // Set when the program stopped at a discard since the last ResetRegisters
+    bool _discarded = false;
+
+    scDispatchMode _dispatchMode = scDispatchMode::Switch;
+
+    // Handler addresses for the loaded program, built on first use by the threaded and tail call cores
+    std::vector<const void*> _threadedCode {};
+
+    // Compiled on first use by the JIT core, stays null if the program could not be compiled
+    std::shared_ptr<const scJitProgram> _jitProgram;
+    bool _jitAttempted = false;
+
+#ifdef SCHISM_PROFILER
+    scProfiler* _pProfiler = nullptr;
+#endif
+
+    friend struct scTailDispatch;
 
     // ===============
     //  Ctor and Dtor
@@ -90,18 +152,66 @@ public:
     // ======================
     //  Program Manipulation
     // ======================
-    void LoadProgram(const scModule& module);
+    // Only keeps a reference to program, nothing is copied
+    //   - hoisted is used instead of splitting program again while uniform hoisting is on, it has to come from
+    //     scHoistUniforms for program and this memory size
+    //   - Returns false and unloads the current program if program was verified for more memory than this context has
+    bool LoadProgram(scModuleRef program, scHoistedProgramRef hoisted = nullptr);
 
+    // Copies module into a new shared module
+    bool LoadProgram(const scModule& module);
+
+    // The program that is executed, which is the body of the loaded module when uniform hoisting split it
     [[nodiscard]]
-    std::optional<scModule> GetProgram() const {
+    const scModuleRef& GetProgram() const {
         return _program;
     }
 
+    // Splits programs into a uniform prologue and a body with scHoistUniforms, reloads the current program
+    //   - Uniform memory has to be written before ResetRegisters, which reruns the prologue when it changed
+    void SetUniformHoisting(bool enabled);
+
+    [[nodiscard]]
+    bool GetUniformHoisting() const {
+        return _uniformHoisting;
+    }
+
+    [[nodiscard]]
+    bool HasUniformPrologue() const {
+        return _hoisted != nullptr;
+    }
+
+    [[nodiscard]]
+    size_t GetMemorySize() const {
+        return _memory.size();
+    }
+
     //void LoadFragProgram(const scModule& module);
 
+    // Sample instructions naming slot read texture, an empty slot samples as 0 in every channel
+    //   - Returns false if slot is out of range
+    bool BindTexture(int slot, scTextureRef texture);
+
+    // Returns the mode actually in use, which is Switch if the requested core was not compiled in
+    scDispatchMode SetDispatchMode(scDispatchMode mode);
+
+    [[nodiscard]]
+    scDispatchMode GetDispatchMode() const {
+        return _dispatchMode;
+    }
+
+    static bool IsDispatchModeSupported(scDispatchMode mode);
+
+    // Counts every instruction executed from now on into pProfiler, which has to outlive the VM, null detaches it
+    //   - Programs run on the Switch core while a profiler is attached, whatever the dispatch mode
+    //   - Returns false when the library was built without SCHISM_PROFILER, nothing is counted then
+    bool SetProfiler(scProfiler* pProfiler);
+
     // =======================
     //  Register Manipulation
     // =======================
+
+    // IP is an index into the decoded instruction stream of the loaded program
     void MoveInstructionPointer(int offset);
 
     void SetRegister(scRegister regIndex, const scValue_u& value);
@@ -119,6 +229,9 @@ public:
         if (index + sizeof(T) - 1 > _memory.size())
             return false;
 
+        if (scIsUniformMemory(index, sizeof(T)) && std::memcmp(_memory.data() + index, &value, sizeof(T)) != 0)
+            _uniformsDirty = true;
+
         uint8_t* valPtr = (uint8_t*)&value;
         for (int m = 0; m < sizeof(T); m++) {
             _memory[index + m] = valPtr[m];
@@ -155,13 +268,52 @@ public:
     // ===================
     //  Program Execution
     // ===================
-    bool ExecuteOperation(const scModule& pModule, uint32_t encoded);
+    // Runs a single instruction on its own, branches are skipped as there is no instruction pointer to move
+    bool ExecuteInstruction(const scInstruction& instruction);
 
+    // Zeroes every register, or restores them to where the uniform prologue left them
     void ResetRegisters();
 
     void ExecuteTillEnd();
 
     bool ExecuteStep();
+
+    // The registers of a discarded invocation are left where the discard stopped them, its output shouldn't be written
+    [[nodiscard]]
+    bool IsDiscarded() const {
+        return _discarded;
+    }
+
+protected:
+    // Runs the uniform prologue from zeroed registers and keeps the result
+    void RunPrologue();
+
+    template<scOpcode OP>
+    bool ExecuteOp(const scInstruction& instruction);
+
+    // Returns how far to move the instruction pointer, 1 when the branch isn't taken
+    template<scOpcode OP>
+    int32_t ExecuteBranch(const scInstruction& instruction);
+
+    // Runs the instruction at ip and moves ip to the one that runs next
+    bool Step(const scInstruction* pInstructions, uint32_t& ip);
+
+    void SampleTexture(const scInstruction& instruction, scTextureFilter filter);
+
+    // Each core runs from ip until the program stops, ip is left one past the last executed instruction
+    void RunSwitch(uint32_t& ip);
+
+    void RunThreaded(uint32_t& ip);
+
+    void RunTailCall(uint32_t& ip);
+
+    void RunJit(uint32_t& ip);
+
+#ifdef SCHISM_PROFILER
+    void RunProfiled(uint32_t& ip);
+
+    bool ExecuteProfiled(uint32_t& ip);
+#endif
 };
 
 #endif //SCHISM_SC_VM_HPP
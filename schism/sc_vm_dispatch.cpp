@@ -0,0 +1,507 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_vm.hpp"
+#include "sc_profiler.hpp"
+#include "sc_matrix.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include <schism/sc_cpu.hpp>
+
+#ifdef SCHISM_ARCH_X86_64
+#include <immintrin.h>
+#endif
+
+// =====================
+//  Operation Handlers
+// =====================
+
+// Every interpreter core shares these, so they only differ in how they get from one instruction to the next
+//   - Opcodes are listed in enum order, branches go through BRANCH as they move the instruction pointer themselves
+#define SC_FOREACH_OPCODE(X, BRANCH) \
+    X(Exit)                          \
+    X(Nop)                           \
+    X(Mov)                           \
+    X(AddF32)                        \
+    X(SubF32)                        \
+    X(MulF32)                        \
+    X(DivF32)                        \
+    X(ModF32)                        \
+    X(PowF32)                        \
+    X(AddV4F32)                      \
+    X(SubV4F32)                      \
+    X(MulV4F32)                      \
+    X(DivV4F32)                      \
+    X(ModV4F32)                      \
+    X(PowV4F32)                      \
+    X(SetF32)                        \
+    X(LoadF32)                       \
+    X(AbsF32)                        \
+    X(LoadF32Unchecked)              \
+    X(SamplePoint)                   \
+    X(SampleLinear)                  \
+    X(MulM4V4)                       \
+    X(MulM4M4)                       \
+    X(TransposeM4)                   \
+    X(Dot3V4)                        \
+    X(Dot4V4)                        \
+    X(CrossV4)                       \
+    X(CmpLtF32)                      \
+    X(CmpLeF32)                      \
+    X(CmpGtF32)                      \
+    X(CmpGeF32)                      \
+    X(CmpEqF32)                      \
+    X(CmpNeF32)                      \
+    X(SelectF32)                     \
+    BRANCH(Jump)                     \
+    BRANCH(BranchZero)               \
+    BRANCH(BranchNotZero)            \
+    BRANCH(Loop)                     \
+    X(Discard)                       \
+    X(DiscardNotZero)
+
+#define SC_COUNT_OPCODE(OP) + 1
+static_assert(0 SC_FOREACH_OPCODE(SC_COUNT_OPCODE, SC_COUNT_OPCODE) == (int)scOpcode::OPCODE_COUNT, "SC_FOREACH_OPCODE is missing an opcode");
+
+#define SC_VM_OP(OP) \
+    template<>       \
+    inline bool scVM::ExecuteOp<scOpcode::OP>([[maybe_unused]] const scInstruction& instruction)
+
+// The lanes are processed in order, A and B are allowed to overlap
+#define SC_VM_OP_V4(OP, EXPR)                                       \
+    SC_VM_OP(OP) {                                                  \
+        for (int d = 0; d < 4; d++) {                               \
+            float& a = _registers[(int)instruction.a + d].f32;      \
+            float b = _registers[(int)instruction.b + d].f32;       \
+            a = EXPR;                                               \
+        }                                                           \
+                                                                    \
+        return true;                                                \
+    }
+
+// x86-64 always has SSE2, so the 4 components go through a single packed operation. When A starts inside B the
+// components have to be processed in order as each one reads the result of an earlier one, V registers never do
+#ifdef SCHISM_ARCH_X86_64
+#define SC_VM_OP_V4_PACKED(OP, EXPR, PACKED)                                        \
+    SC_VM_OP(OP) {                                                                  \
+        int first = (int)instruction.a;                                             \
+        int second = (int)instruction.b;                                            \
+                                                                                    \
+        if (first <= second || first >= second + 4) {                               \
+            float* pA = &_registers[first].f32;                                     \
+            const float* pB = &_registers[second].f32;                              \
+                                                                                    \
+            _mm_storeu_ps(pA, PACKED(_mm_loadu_ps(pA), _mm_loadu_ps(pB)));          \
+            return true;                                                            \
+        }                                                                           \
+                                                                                    \
+        for (int d = 0; d < 4; d++) {                                               \
+            float& a = _registers[first + d].f32;                                   \
+            float b = _registers[second + d].f32;                                   \
+            a = EXPR;                                                               \
+        }                                                                           \
+                                                                                    \
+        return true;                                                                \
+    }
+#else
+#define SC_VM_OP_V4_PACKED(OP, EXPR, PACKED) SC_VM_OP_V4(OP, EXPR)
+#endif
+
+#define SC_VM_OP_F32(OP, EXPR)                                      \
+    SC_VM_OP(OP) {                                                  \
+        float& a = _registers[(int)instruction.a].f32;              \
+        float b = _registers[(int)instruction.b].f32;               \
+        a = EXPR;                                                   \
+                                                                    \
+        return true;                                                \
+    }
+
+SC_VM_OP(Exit) {
+    return false;
+}
+
+SC_VM_OP(Nop) {
+    return true;
+}
+
+SC_VM_OP(Mov) {
+    SetRegister(instruction.a, GetRegister(instruction.b));
+    return true;
+}
+
+SC_VM_OP_F32(AddF32, a + b)
+SC_VM_OP_F32(SubF32, a - b)
+SC_VM_OP_F32(MulF32, a * b)
+SC_VM_OP_F32(DivF32, a / b)
+SC_VM_OP_F32(ModF32, std::fmod(a, b))
+SC_VM_OP_F32(PowF32, powf(a, b))
+
+SC_VM_OP_V4_PACKED(AddV4F32, a + b, _mm_add_ps)
+SC_VM_OP_V4_PACKED(SubV4F32, a - b, _mm_sub_ps)
+SC_VM_OP_V4_PACKED(MulV4F32, a * b, _mm_mul_ps)
+SC_VM_OP_V4_PACKED(DivV4F32, a / b, _mm_div_ps)
+SC_VM_OP_V4(ModV4F32, std::fmod(a, b))
+SC_VM_OP_V4(PowV4F32, powf(a, b))
+
+SC_VM_OP(SetF32) {
+    SetRegister(instruction.a, instruction.immediate);
+    return true;
+}
+
+SC_VM_OP(LoadF32) {
+    scValue_u value;
+
+    if (!ReadValue(instruction.immediate.u32, value.f32)) {
+        return false;
+    }
+
+    SetRegister(instruction.a, value);
+    return true;
+}
+
+// Verified modules never load past the memory of a context they are loaded into
+SC_VM_OP(LoadF32Unchecked) {
+    std::memcpy(&_registers[(int)instruction.a], _memory.data() + instruction.immediate.u32, sizeof(float));
+    return true;
+}
+
+SC_VM_OP(AbsF32) {
+    scValue_u& value = _registers[(int)instruction.a];
+    value.f32 = fabsf(value.f32);
+
+    return true;
+}
+
+SC_VM_OP(SamplePoint) {
+    SampleTexture(instruction, scTextureFilter::Point);
+    return true;
+}
+
+SC_VM_OP(SampleLinear) {
+    SampleTexture(instruction, scTextureFilter::Linear);
+    return true;
+}
+
+// Matrices and vectors are consecutive registers
+#define SC_VM_OP_MATRIX(OP, KERNEL)                                                         \
+    SC_VM_OP(OP) {                                                                          \
+        KERNEL(&_registers[(int)instruction.a].f32, &_registers[(int)instruction.b].f32);   \
+        return true;                                                                        \
+    }
+
+SC_VM_OP_MATRIX(MulM4V4, scMulMatrixVector)
+SC_VM_OP_MATRIX(MulM4M4, scMulMatrixMatrix)
+SC_VM_OP_MATRIX(Dot3V4, scDot3)
+SC_VM_OP_MATRIX(Dot4V4, scDot4)
+SC_VM_OP_MATRIX(CrossV4, scCross)
+
+SC_VM_OP(TransposeM4) {
+    scTransposeMatrix(&_registers[(int)instruction.a].f32);
+    return true;
+}
+
+SC_VM_OP_F32(CmpLtF32, a < b ? 1.0f : 0.0f)
+SC_VM_OP_F32(CmpLeF32, a <= b ? 1.0f : 0.0f)
+SC_VM_OP_F32(CmpGtF32, a > b ? 1.0f : 0.0f)
+SC_VM_OP_F32(CmpGeF32, a >= b ? 1.0f : 0.0f)
+SC_VM_OP_F32(CmpEqF32, a == b ? 1.0f : 0.0f)
+SC_VM_OP_F32(CmpNeF32, a != b ? 1.0f : 0.0f)
+
+SC_VM_OP(SelectF32) {
+    if (_registers[(int)scGetSelectCondition(instruction)].f32 != 0)
+        _registers[(int)instruction.a] = _registers[(int)instruction.b];
+
+    return true;
+}
+
+// Both stop the program the same way Exit does
+SC_VM_OP(Discard) {
+    _discarded = true;
+    return false;
+}
+
+SC_VM_OP(DiscardNotZero) {
+    _discarded = _registers[(int)instruction.a].f32 != 0;
+    return !_discarded;
+}
+
+#define SC_VM_BRANCH(OP) \
+    template<>           \
+    inline int32_t scVM::ExecuteBranch<scOpcode::OP>(const scInstruction& instruction)
+
+SC_VM_BRANCH(Jump) {
+    return scGetBranchDisplacement(instruction);
+}
+
+SC_VM_BRANCH(BranchZero) {
+    return _registers[(int)instruction.a].f32 == 0 ? scGetBranchDisplacement(instruction) : 1;
+}
+
+SC_VM_BRANCH(BranchNotZero) {
+    return _registers[(int)instruction.a].f32 != 0 ? scGetBranchDisplacement(instruction) : 1;
+}
+
+SC_VM_BRANCH(Loop) {
+    float& counter = _registers[(int)instruction.a].f32;
+    counter -= 1;
+
+    return counter > 0 ? scGetBranchDisplacement(instruction) : 1;
+}
+
+void scVM::SampleTexture(const scInstruction& instruction, scTextureFilter filter) {
+    uint32_t slot = scGetSampleSlot(instruction);
+    const scTexture* pTexture = slot < SC_TEXTURE_SLOT_COUNT ? _textures[slot].get() : nullptr;
+
+    float* pResult = &_registers[(int)instruction.a].f32;
+
+    if (pTexture == nullptr) {
+        std::memset(pResult, 0, sizeof(float) * 4);
+        return;
+    }
+
+    const float* pCoord = &_registers[(int)instruction.b].f32;
+    const float* pLod = &_registers[(int)scGetSampleLod(instruction)].f32;
+
+    pTexture->Sample(filter, pCoord, pCoord + 1, pLod, 1, pResult, 1);
+}
+
+// ===================
+//  Program Execution
+// ===================
+bool scVM::ExecuteInstruction(const scInstruction& instruction) {
+#define SC_SWITCH_CASE(OP)      \
+    case scOpcode::OP:          \
+        return ExecuteOp<scOpcode::OP>(instruction);
+
+#define SC_SWITCH_SKIP(OP)      \
+    case scOpcode::OP:          \
+        return true;
+
+    switch (instruction.opcode) {
+        SC_FOREACH_OPCODE(SC_SWITCH_CASE, SC_SWITCH_SKIP)
+
+        default:
+            return true;
+    }
+
+#undef SC_SWITCH_SKIP
+#undef SC_SWITCH_CASE
+}
+
+bool scVM::Step(const scInstruction* pInstructions, uint32_t& ip) {
+#define SC_STEP_CASE(OP)                                    \
+    case scOpcode::OP:                                      \
+        ip++;                                               \
+        return ExecuteOp<scOpcode::OP>(instruction);
+
+#define SC_STEP_BRANCH(OP)                                  \
+    case scOpcode::OP:                                      \
+        ip += ExecuteBranch<scOpcode::OP>(instruction);     \
+        return true;
+
+    const scInstruction& instruction = pInstructions[ip];
+
+    switch (instruction.opcode) {
+        SC_FOREACH_OPCODE(SC_STEP_CASE, SC_STEP_BRANCH)
+
+        default:
+            ip++;
+            return true;
+    }
+
+#undef SC_STEP_BRANCH
+#undef SC_STEP_CASE
+}
+
+void scVM::RunSwitch(uint32_t& ip) {
+    // The decoded stream always ends in an EXIT and verified branches land inside it, so IP never has to be checked
+    const scInstruction* pInstructions = _program->GetInstructions().data();
+
+    while (Step(pInstructions, ip)) {
+
+    }
+}
+
+void scVM::RunThreaded(uint32_t& ip) {
+#ifdef SCHISM_HAS_COMPUTED_GOTO
+#define SC_THREADED_LABEL(OP) &&Handle##OP,
+
+    static const void* const handlers[] = {
+        SC_FOREACH_OPCODE(SC_THREADED_LABEL, SC_THREADED_LABEL)
+    };
+
+#undef SC_THREADED_LABEL
+
+    scSpan<const scInstruction> instructions = _program->GetInstructions();
+
+    // Translate the program into handler addresses once, the opcode is never looked at again
+    if (_threadedCode.empty()) {
+        _threadedCode.reserve(instructions.size());
+
+        for (const scInstruction& instruction : instructions)
+            _threadedCode.push_back(handlers[(int)instruction.opcode]);
+    }
+
+    const scInstruction* pInstructions = instructions.data();
+    const void* const* pCode = _threadedCode.data();
+
+    uint32_t pc = ip;
+
+    goto *pCode[pc];
+
+#define SC_THREADED_HANDLER(OP)                                 \
+    Handle##OP:                                                 \
+        if (!ExecuteOp<scOpcode::OP>(pInstructions[pc++]))      \
+            goto Done;                                          \
+                                                                \
+        goto *pCode[pc];
+
+#define SC_THREADED_BRANCH(OP)                                          \
+    Handle##OP:                                                         \
+        pc += ExecuteBranch<scOpcode::OP>(pInstructions[pc]);           \
+        goto *pCode[pc];
+
+    SC_FOREACH_OPCODE(SC_THREADED_HANDLER, SC_THREADED_BRANCH)
+
+#undef SC_THREADED_BRANCH
+#undef SC_THREADED_HANDLER
+
+Done:
+    ip = pc;
+#else
+    RunSwitch(ip);
+#endif
+}
+
+#ifdef SCHISM_HAS_MUSTTAIL
+#define SC_MUSTTAIL [[clang::musttail]]
+
+struct scTailDispatch {
+    // Returns one past the instruction that stopped the program
+    typedef const scInstruction* (*Handler)(scVM& vm, const scInstruction* pInstruction, const void* const* pCode);
+
+    template<scOpcode OP>
+    static const scInstruction* Handle(scVM& vm, const scInstruction* pInstruction, const void* const* pCode) {
+        if (!vm.ExecuteOp<OP>(*pInstruction))
+            return pInstruction + 1;
+
+        SC_MUSTTAIL return reinterpret_cast<Handler>(pCode[1])(vm, pInstruction + 1, pCode + 1);
+    }
+
+    template<scOpcode OP>
+    static const scInstruction* Branch(scVM& vm, const scInstruction* pInstruction, const void* const* pCode) {
+        int32_t displacement = vm.ExecuteBranch<OP>(*pInstruction);
+
+        SC_MUSTTAIL return reinterpret_cast<Handler>(pCode[displacement])(vm, pInstruction + displacement, pCode + displacement);
+    }
+};
+#endif
+
+void scVM::RunTailCall(uint32_t& ip) {
+#ifdef SCHISM_HAS_MUSTTAIL
+#define SC_TAIL_HANDLER(OP) reinterpret_cast<const void*>(&scTailDispatch::Handle<scOpcode::OP>),
+#define SC_TAIL_BRANCH(OP) reinterpret_cast<const void*>(&scTailDispatch::Branch<scOpcode::OP>),
+
+    static const void* const handlers[] = {
+        SC_FOREACH_OPCODE(SC_TAIL_HANDLER, SC_TAIL_BRANCH)
+    };
+
+#undef SC_TAIL_BRANCH
+#undef SC_TAIL_HANDLER
+
+    scSpan<const scInstruction> instructions = _program->GetInstructions();
+
+    if (_threadedCode.empty()) {
+        _threadedCode.reserve(instructions.size());
+
+        for (const scInstruction& instruction : instructions)
+            _threadedCode.push_back(handlers[(int)instruction.opcode]);
+    }
+
+    const scInstruction* pInstructions = instructions.data();
+    const void* const* pCode = _threadedCode.data();
+
+    auto entry = reinterpret_cast<scTailDispatch::Handler>(pCode[ip]);
+    ip = entry(*this, pInstructions + ip, pCode + ip) - pInstructions;
+#else
+    RunSwitch(ip);
+#endif
+}
+
+void scVM::RunJit(uint32_t& ip) {
+    if (!_jitAttempted) {
+        _jitProgram = scJitProgram::Compile(*_program, _memory.size());
+        _jitAttempted = true;
+    }
+
+    // Compiled code always starts from the first instruction, a program that was stepped part way is interpreted
+    if (_jitProgram == nullptr || ip != 0) {
+        RunSwitch(ip);
+        return;
+    }
+
+    ip = _jitProgram->GetFunction()(_registers.data(), _memory.data());
+}
+
+#ifdef SCHISM_PROFILER
+bool scVM::ExecuteProfiled(uint32_t& ip) {
+    const scInstruction* pInstructions = _program->GetInstructions().data();
+
+    uint32_t current = ip;
+    scOpcode opcode = pInstructions[current].opcode;
+
+    bool running;
+
+    if (_pProfiler->ShouldSample()) {
+        uint64_t begin = scReadTimestamp();
+        running = Step(pInstructions, ip);
+
+        _pProfiler->AddSample(opcode, scReadTimestamp() - begin);
+    } else {
+        running = Step(pInstructions, ip);
+    }
+
+    _pProfiler->Count(current, opcode);
+    return running;
+}
+
+void scVM::RunProfiled(uint32_t& ip) {
+    // A program that was stepped part way already started its run
+    if (ip == 0)
+        _pProfiler->BeginRun(_program->GetInstructions().size());
+
+    while (ExecuteProfiled(ip)) {
+
+    }
+}
+#endif
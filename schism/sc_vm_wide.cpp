@@ -0,0 +1,628 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_vm_wide.hpp"
+#include "sc_profiler.hpp"
+
+#include <cmath>
+
+#include <algorithm>
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scWideVM::scWideVM(size_t memSize) {
+    _memorySize = memSize;
+    _memory.resize(memSize * LANE_COUNT);
+
+    _kernels = &scGetBestWideKernels();
+
+    for (int l = 0; l < LANE_COUNT; l++)
+        _laneMap[l] = (uint8_t)l;
+
+    ResetRegisters();
+}
+
+// ======================
+//  Program Manipulation
+// ======================
+bool scWideVM::LoadProgram(scModuleRef program, scHoistedProgramRef hoisted) {
+    bool fits = program == nullptr || !program->IsVerified() || program->GetRequiredMemory() <= _memorySize;
+
+    if (!fits)
+        program = nullptr;
+
+    _sourceProgram = std::move(program);
+    _hoisted = nullptr;
+
+    if (_uniformHoisting && _sourceProgram != nullptr)
+        _hoisted = hoisted != nullptr ? std::move(hoisted) : scHoistUniforms(*_sourceProgram, _memorySize);
+
+    if (_hoisted != nullptr)
+        _program = scModuleRef(_hoisted, &_hoisted->body);
+    else
+        _program = _sourceProgram;
+
+    _hasBranches = false;
+
+    if (_program != nullptr) {
+        for (const scInstruction& instruction : _program->GetInstructions())
+            _hasBranches |= scIsBranchOpcode(instruction.opcode);
+    }
+
+    _uniformsDirty = true;
+    ResetRegisters();
+
+    return fits;
+}
+
+bool scWideVM::LoadProgram(const scModule& module) {
+    return LoadProgram(scShareModule(module));
+}
+
+void scWideVM::SetUniformHoisting(bool enabled) {
+    if (enabled == _uniformHoisting)
+        return;
+
+    _uniformHoisting = enabled;
+
+    if (_sourceProgram != nullptr)
+        LoadProgram(_sourceProgram);
+}
+
+bool scWideVM::SetProfiler(scProfiler* pProfiler) {
+#ifdef SCHISM_PROFILER
+    _pProfiler = pProfiler;
+    return true;
+#else
+    return pProfiler == nullptr;
+#endif
+}
+
+bool scWideVM::BindTexture(int slot, scTextureRef texture) {
+    if (slot < 0 || slot >= SC_TEXTURE_SLOT_COUNT)
+        return false;
+
+    _textures[slot] = std::move(texture);
+    return true;
+}
+
+scWideIsa scWideVM::SetIsa(scWideIsa isa) {
+    _kernels = &scGetWideKernels(isa);
+    return _kernels->isa;
+}
+
+// ===================
+//  Program Execution
+// ===================
+void scWideVM::ResetRegisters() {
+    _discardMask = 0;
+
+    if (_hoisted != nullptr) {
+        if (_uniformsDirty)
+            RunPrologue();
+
+        _registers = _uniformRegisters;
+        return;
+    }
+
+    for (scWideRegister& reg : _registers)
+        _kernels->fill(reg.lanes, 0, LANE_COUNT);
+}
+
+void scWideVM::RunPrologue() {
+    for (scWideRegister& reg : _registers)
+        _kernels->fill(reg.lanes, 0, LANE_COUNT);
+
+    const scInstruction* pInstruction = _hoisted->prologue.GetInstructions().data();
+
+    while (ExecuteInstruction(*pInstruction++)) {
+
+    }
+
+    _uniformRegisters = _registers;
+    _uniformsDirty = false;
+}
+
+void scWideVM::ExecuteTillEnd() {
+    if (_program == nullptr)
+        return;
+
+    if (_hasBranches) {
+        RunBranching();
+        return;
+    }
+
+#ifdef SCHISM_PROFILER
+    if (_pProfiler != nullptr) {
+        RunProfiled();
+        ExpandLanes();
+        return;
+    }
+#endif
+
+    // The decoded stream always ends in an EXIT
+    const scInstruction* pInstruction = _program->GetInstructions().data();
+
+    while (ExecuteInstruction(*pInstruction++)) {
+
+    }
+
+    ExpandLanes();
+}
+
+void scWideVM::RunBranching() {
+    const scInstruction* pInstructions = _program->GetInstructions().data();
+
+    uint32_t laneIp[LANE_COUNT] {};
+    uint32_t running = (1u << LANE_COUNT) - 1;
+
+#ifdef SCHISM_PROFILER
+    if (_pProfiler != nullptr)
+        _pProfiler->BeginRun(_program->GetInstructions().size());
+#endif
+
+    while (running != 0) {
+        uint32_t ip = UINT32_MAX;
+
+        for (int l = 0; l < LANE_COUNT; l++) {
+            if (running & (1u << l))
+                ip = std::min(ip, laneIp[l]);
+        }
+
+        // The closest instruction a lane outside of the group waits at
+        uint32_t active = 0;
+        uint32_t parked = UINT32_MAX;
+
+        for (int l = 0; l < LANE_COUNT; l++) {
+            if (!(running & (1u << l)))
+                continue;
+
+            if (laneIp[l] == ip)
+                active |= 1u << l;
+            else
+                parked = std::min(parked, laneIp[l]);
+        }
+
+        // The group runs on its own until it branches, exits or reaches the parked lanes, which then join it. Discarded
+        // lanes only leave the group, the others carry on
+        for (;;) {
+            const scInstruction& instruction = pInstructions[ip];
+            bool stepped;
+
+#ifdef SCHISM_PROFILER
+            if (_pProfiler != nullptr && _pProfiler->ShouldSample()) {
+                uint64_t begin = scReadTimestamp();
+                stepped = ExecuteGroup(instruction, ip, active, laneIp);
+
+                _pProfiler->AddSample(instruction.opcode, scReadTimestamp() - begin);
+            } else {
+                stepped = ExecuteGroup(instruction, ip, active, laneIp);
+            }
+
+            if (_pProfiler != nullptr)
+                _pProfiler->Count(ip, instruction.opcode);
+#else
+            stepped = ExecuteGroup(instruction, ip, active, laneIp);
+#endif
+
+            running &= ~_discardMask;
+
+            if (!stepped) {
+                running &= ~active;
+                break;
+            }
+
+            if (scIsBranchOpcode(instruction.opcode))
+                break;
+
+            if (++ip == parked) {
+                for (int l = 0; l < LANE_COUNT; l++) {
+                    if (active & (1u << l))
+                        laneIp[l] = ip;
+                }
+
+                break;
+            }
+        }
+    }
+}
+
+bool scWideVM::ExecuteGroup(const scInstruction& instruction, uint32_t ip, uint32_t& active, uint32_t* pLaneIp) {
+    float* pA = _registers[(int)instruction.a].lanes;
+
+    // Lanes keep their place while branches can still split them, they're only masked off
+    if (instruction.opcode == scOpcode::Discard || instruction.opcode == scOpcode::DiscardNotZero) {
+        uint32_t discarded = active;
+
+        for (int l = 0; l < LANE_COUNT && instruction.opcode == scOpcode::DiscardNotZero; l++) {
+            if (pA[l] == 0)
+                discarded &= ~(1u << l);
+        }
+
+        _discardMask |= discarded;
+        active &= ~discarded;
+
+        return active != 0;
+    }
+
+    // Lanes that already exited keep their registers too, they hold the results
+    if (!scIsBranchOpcode(instruction.opcode))
+        return active == (1u << LANE_COUNT) - 1 ? ExecuteInstruction(instruction) : ExecuteMasked(instruction, active);
+    int32_t displacement = scGetBranchDisplacement(instruction);
+
+    for (int l = 0; l < LANE_COUNT; l++) {
+        if (!(active & (1u << l)))
+            continue;
+
+        bool taken;
+
+        switch (instruction.opcode) {
+            case scOpcode::BranchZero:
+                taken = pA[l] == 0;
+                break;
+
+            case scOpcode::BranchNotZero:
+                taken = pA[l] != 0;
+                break;
+
+            case scOpcode::Loop:
+                pA[l] -= 1;
+                taken = pA[l] > 0;
+                break;
+
+            default:
+                taken = true;
+                break;
+        }
+
+        pLaneIp[l] = taken ? ip + displacement : ip + 1;
+    }
+
+    return true;
+}
+
+bool scWideVM::ExecuteMasked(const scInstruction& instruction, uint32_t active) {
+    scRegisterAccess access;
+
+    // Exit and Nop don't touch any register
+    if (!scGetRegisterAccess(instruction, access) || access.width == 0)
+        return ExecuteInstruction(instruction);
+
+    alignas(64) float inactive[LANE_COUNT];
+
+    for (int l = 0; l < LANE_COUNT; l++)
+        inactive[l] = (active & (1u << l)) ? 0.0f : 1.0f;
+
+    scWideRegister saved[16];
+    std::copy_n(_registers.begin() + access.write, access.width, saved);
+
+    bool running = ExecuteInstruction(instruction);
+
+    for (int r = 0; r < access.width; r++)
+        _kernels->select(_registers[access.write + r].lanes, saved[r].lanes, inactive, LANE_COUNT);
+
+    return running;
+}
+
+bool scWideVM::CompactLanes(uint32_t discarded) {
+    int live = 0;
+    int kept[LANE_COUNT];
+
+    for (int l = 0; l < _liveCount; l++) {
+        if (discarded & (1u << l))
+            _discardMask |= 1u << _laneMap[l];
+        else
+            kept[live++] = l;
+    }
+
+    _liveCount = live;
+
+    if (live == 0)
+        return false;
+
+    // Lanes only ever move down, so they can be moved in place
+    for (scWideRegister& reg : _registers) {
+        for (int l = 0; l < live; l++)
+            reg.lanes[l] = reg.lanes[kept[l]];
+    }
+
+    for (int l = 0; l < live; l++)
+        _laneMap[l] = _laneMap[kept[l]];
+
+    return true;
+}
+
+void scWideVM::ExpandLanes() {
+    if (_liveCount == LANE_COUNT)
+        return;
+
+    for (scWideRegister& reg : _registers) {
+        scWideRegister packed = reg;
+
+        for (int l = 0; l < _liveCount; l++)
+            reg.lanes[_laneMap[l]] = packed.lanes[l];
+    }
+
+    for (int l = 0; l < LANE_COUNT; l++)
+        _laneMap[l] = (uint8_t)l;
+
+    _liveCount = LANE_COUNT;
+}
+
+#ifdef SCHISM_PROFILER
+void scWideVM::RunProfiled() {
+    scSpan<const scInstruction> instructions = _program->GetInstructions();
+    _pProfiler->BeginRun(instructions.size());
+
+    for (uint32_t ip = 0; ; ip++) {
+        const scInstruction& instruction = instructions[ip];
+        bool running;
+
+        if (_pProfiler->ShouldSample()) {
+            uint64_t begin = scReadTimestamp();
+            running = ExecuteInstruction(instruction);
+
+            _pProfiler->AddSample(instruction.opcode, scReadTimestamp() - begin);
+        } else {
+            running = ExecuteInstruction(instruction);
+        }
+
+        _pProfiler->Count(ip, instruction.opcode);
+
+        if (!running)
+            break;
+    }
+}
+#endif
+
+bool scWideVM::ExecuteInstruction(const scInstruction& instruction) {
+    float* pA = _registers[(int)instruction.a].lanes;
+    const float* pB = _registers[(int)instruction.b].lanes;
+
+    const scWideKernels& kernels = *_kernels;
+
+    // Only the live lanes are run, see CompactLanes
+    int count = _liveCount;
+
+    switch (instruction.opcode) {
+        case scOpcode::Exit:
+            return false;
+
+        case scOpcode::Nop:
+            break;
+
+        case scOpcode::Mov:
+            std::memmove(pA, pB, sizeof(scWideRegister));
+            break;
+
+        case scOpcode::AddF32:
+            kernels.add(pA, pB, count);
+            break;
+
+        case scOpcode::SubF32:
+            kernels.sub(pA, pB, count);
+            break;
+
+        case scOpcode::MulF32:
+            kernels.mul(pA, pB, count);
+            break;
+
+        case scOpcode::DivF32:
+            kernels.div(pA, pB, count);
+            break;
+
+        case scOpcode::ModF32:
+            for (int l = 0; l < count; l++)
+                pA[l] = std::fmod(pA[l], pB[l]);
+
+            break;
+
+        case scOpcode::PowF32:
+            for (int l = 0; l < count; l++)
+                pA[l] = powf(pA[l], pB[l]);
+
+            break;
+
+        // Each component is a full row, they are processed in order as A and B are allowed to overlap
+        case scOpcode::AddV4F32:
+            for (int d = 0; d < 4; d++)
+                kernels.add(pA + d * LANE_COUNT, pB + d * LANE_COUNT, count);
+
+            break;
+
+        case scOpcode::SubV4F32:
+            for (int d = 0; d < 4; d++)
+                kernels.sub(pA + d * LANE_COUNT, pB + d * LANE_COUNT, count);
+
+            break;
+
+        case scOpcode::MulV4F32:
+            for (int d = 0; d < 4; d++)
+                kernels.mul(pA + d * LANE_COUNT, pB + d * LANE_COUNT, count);
+
+            break;
+
+        case scOpcode::DivV4F32:
+            for (int d = 0; d < 4; d++)
+                kernels.div(pA + d * LANE_COUNT, pB + d * LANE_COUNT, count);
+
+            break;
+
+        case scOpcode::ModV4F32:
+            for (int d = 0; d < 4; d++) {
+                for (int l = 0; l < count; l++)
+                    pA[d * LANE_COUNT + l] = std::fmod(pA[d * LANE_COUNT + l], pB[d * LANE_COUNT + l]);
+            }
+
+            break;
+
+        case scOpcode::PowV4F32:
+            for (int d = 0; d < 4; d++) {
+                for (int l = 0; l < count; l++)
+                    pA[d * LANE_COUNT + l] = powf(pA[d * LANE_COUNT + l], pB[d * LANE_COUNT + l]);
+            }
+
+            break;
+
+        case scOpcode::SetF32:
+            kernels.fill(pA, instruction.immediate.f32, count);
+            break;
+
+        case scOpcode::LoadF32: {
+            // The address is an immediate so it is the same for every lane
+            uint32_t ptr = instruction.immediate.u32;
+
+            if (ptr + sizeof(float) > _memorySize)
+                return false;
+
+            const uint8_t* pMemory = _memory.data() + ptr;
+
+            for (int l = 0; l < count; l++)
+                std::memcpy(pA + l, pMemory + _laneMap[l] * _memorySize, sizeof(float));
+
+            break;
+        }
+
+        case scOpcode::LoadF32Unchecked: {
+            const uint8_t* pMemory = _memory.data() + instruction.immediate.u32;
+
+            for (int l = 0; l < count; l++)
+                std::memcpy(pA + l, pMemory + _laneMap[l] * _memorySize, sizeof(float));
+
+            break;
+        }
+
+        case scOpcode::AbsF32:
+            kernels.abs(pA, count);
+            break;
+
+        // U and V are consecutive rows, as are the 4 rows of the result
+        case scOpcode::SamplePoint:
+        case scOpcode::SampleLinear: {
+            uint32_t slot = scGetSampleSlot(instruction);
+            const scTexture* pTexture = slot < SC_TEXTURE_SLOT_COUNT ? _textures[slot].get() : nullptr;
+
+            if (pTexture == nullptr) {
+                kernels.fill(pA, 0, LANE_COUNT * 4);
+                break;
+            }
+
+            scTextureFilter filter = instruction.opcode == scOpcode::SamplePoint ? scTextureFilter::Point : scTextureFilter::Linear;
+            const float* pLod = _registers[(int)scGetSampleLod(instruction)].lanes;
+
+            pTexture->Sample(filter, pB, pB + LANE_COUNT, pLod, count, pA, LANE_COUNT);
+            break;
+        }
+
+        // The vector kernels take the lane count as the distance between rows too, so they always run every lane
+        case scOpcode::MulM4V4:
+            kernels.mulMatrixVector(pA, pB, LANE_COUNT);
+            break;
+
+        case scOpcode::MulM4M4:
+            kernels.mulMatrixMatrix(pA, pB, LANE_COUNT);
+            break;
+
+        // Whole rows are swapped, no lane ever moves
+        case scOpcode::TransposeM4:
+            for (int i = 0; i < 4; i++) {
+                for (int j = i + 1; j < 4; j++)
+                    std::swap(_registers[(int)instruction.a + i * 4 + j], _registers[(int)instruction.a + j * 4 + i]);
+            }
+
+            break;
+
+        case scOpcode::Dot3V4:
+            kernels.dot3(pA, pB, LANE_COUNT);
+            break;
+
+        case scOpcode::Dot4V4:
+            kernels.dot4(pA, pB, LANE_COUNT);
+            break;
+
+        case scOpcode::CrossV4:
+            kernels.cross(pA, pB, LANE_COUNT);
+            break;
+
+        // Greater than is less than with the operands swapped
+        case scOpcode::CmpLtF32:
+            kernels.less(pA, pA, pB, count);
+            break;
+
+        case scOpcode::CmpLeF32:
+            kernels.lessEqual(pA, pA, pB, count);
+            break;
+
+        case scOpcode::CmpGtF32:
+            kernels.less(pA, pB, pA, count);
+            break;
+
+        case scOpcode::CmpGeF32:
+            kernels.lessEqual(pA, pB, pA, count);
+            break;
+
+        case scOpcode::CmpEqF32:
+            kernels.equal(pA, pA, pB, count);
+            break;
+
+        case scOpcode::CmpNeF32:
+            kernels.notEqual(pA, pA, pB, count);
+            break;
+
+        case scOpcode::Discard:
+            CompactLanes((1u << count) - 1);
+            return false;
+
+        case scOpcode::DiscardNotZero: {
+            uint32_t discarded = 0;
+
+            for (int l = 0; l < count; l++) {
+                if (pA[l] != 0)
+                    discarded |= 1u << l;
+            }
+
+            if (discarded != 0 && !CompactLanes(discarded))
+                return false;
+
+            break;
+        }
+
+        case scOpcode::SelectF32:
+            kernels.select(pA, pB, _registers[(int)scGetSelectCondition(instruction)].lanes, count);
+            break;
+
+        default:
+            break;
+    }
+
+    return true;
+}
@@ -0,0 +1,282 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_VM_WIDE_HPP
+#define SCHISM_SC_VM_WIDE_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#include <array>
+#include <vector>
+#include <optional>
+
+#include <schism/sc_module.hpp>
+#include <schism/sc_operations.hpp>
+#include <schism/sc_hoisting.hpp>
+#include <schism/sc_texture.hpp>
+
+// enum scWideIsa
+//   - The instruction set the wide VM kernels are executed with
+enum class scWideIsa : uint8_t {
+    Generic,
+    SSE2,
+    AVX2,
+    AVX512,
+};
+
+// struct scWideKernels
+//   - A set of kernels that each process count lanes of a register row
+//   - count may be anything up to LANE_COUNT, rows are padded so kernels may run up to the next multiple of width
+struct scWideKernels {
+    scWideIsa isa;
+    int width;
+
+    void (*add)(float* pA, const float* pB, int count);
+    void (*sub)(float* pA, const float* pB, int count);
+    void (*mul)(float* pA, const float* pB, int count);
+    void (*div)(float* pA, const float* pB, int count);
+
+    void (*abs)(float* pA, int count);
+    void (*fill)(float* pA, float value, int count);
+
+    // Same operand order as the group three instructions, the rows of a vector or matrix are count floats apart
+    void (*mulMatrixVector)(float* pA, const float* pB, int count);
+    void (*mulMatrixMatrix)(float* pA, const float* pB, int count);
+
+    void (*dot3)(float* pA, const float* pB, int count);
+    void (*dot4)(float* pA, const float* pB, int count);
+    void (*cross)(float* pA, const float* pB, int count);
+
+    // pOut is 1.0 where the comparison of pLhs and pRhs holds and 0.0 elsewhere, any of them may be the same row
+    void (*less)(float* pOut, const float* pLhs, const float* pRhs, int count);
+    void (*lessEqual)(float* pOut, const float* pLhs, const float* pRhs, int count);
+    void (*equal)(float* pOut, const float* pLhs, const float* pRhs, int count);
+    void (*notEqual)(float* pOut, const float* pLhs, const float* pRhs, int count);
+
+    // pA = pB where pCondition isn't 0
+    void (*select)(float* pA, const float* pB, const float* pCondition, int count);
+};
+
+extern const char* scGetWideIsaName(scWideIsa isa);
+
+extern bool scIsWideIsaSupported(scWideIsa isa);
+
+// Returns the kernels for the given ISA, or the best the host supports if it isn't
+extern const scWideKernels& scGetWideKernels(scWideIsa isa);
+
+extern const scWideKernels& scGetBestWideKernels();
+
+class scProfiler;
+
+// Executes a single scModule for LANE_COUNT invocations in lockstep
+//   - Every register is a row of lanes (structure of arrays), each instruction runs once for all of them
+//   - Memory is private to each lane, Poke writes to every lane while PokeLane writes to one
+class scWideVM {
+public:
+    static constexpr int LANE_COUNT = 16;
+
+    struct alignas(64) scWideRegister {
+        float lanes[LANE_COUNT];
+    };
+
+protected:
+    std::array<scWideRegister, static_cast<int>(scRegister::REGISTER_COUNT)> _registers;
+
+    // Lane major, each lane owns _memorySize contiguous bytes
+    std::vector<uint8_t> _memory {};
+    size_t _memorySize;
+
+    // Same as scVM, _program points into _hoisted when the loaded program was split
+    scModuleRef _program;
+    scModuleRef _sourceProgram;
+
+    scHoistedProgramRef _hoisted;
+    std::array<scWideRegister, static_cast<int>(scRegister::REGISTER_COUNT)> _uniformRegisters;
+
+    bool _uniformHoisting = false;
+    bool _uniformsDirty = true;
+
+    std::array<scTextureRef, SC_TEXTURE_SLOT_COUNT> _textures {};
+
+    const scWideKernels* _kernels;
+
+    // Programs with branches let every lane follow its own path, see RunBranching
+    bool _hasBranches = false;
+
+    // Bit per lane, set once the lane was discarded
+    uint32_t _discardMask = 0;
+
+    // Without branches the lanes still running are packed into the first _liveCount lanes of every row, lane l of
+    // memory is in _laneMap[l]. Both are restored before ExecuteTillEnd returns
+    int _liveCount = LANE_COUNT;
+    std::array<uint8_t, LANE_COUNT> _laneMap;
+
+#ifdef SCHISM_PROFILER
+    scProfiler* _pProfiler = nullptr;
+#endif
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    scWideVM(size_t memSize);
+
+public:
+    // ======================
+    //  Program Manipulation
+    // ======================
+    // Only keeps a reference to program, follows the same rules as scVM::LoadProgram
+    bool LoadProgram(scModuleRef program, scHoistedProgramRef hoisted = nullptr);
+
+    // Copies module into a new shared module
+    bool LoadProgram(const scModule& module);
+
+    [[nodiscard]]
+    const scModuleRef& GetProgram() const {
+        return _program;
+    }
+
+    // Memory size of a single lane
+    [[nodiscard]]
+    size_t GetMemorySize() const {
+        return _memorySize;
+    }
+
+    // Uniform memory has to be written with Poke, the prologue runs once for every lane
+    void SetUniformHoisting(bool enabled);
+
+    [[nodiscard]]
+    bool GetUniformHoisting() const {
+        return _uniformHoisting;
+    }
+
+    // Same as scVM::BindTexture
+    bool BindTexture(int slot, scTextureRef texture);
+
+    // Returns the ISA actually in use
+    scWideIsa SetIsa(scWideIsa isa);
+
+    [[nodiscard]]
+    scWideIsa GetIsa() const {
+        return _kernels->isa;
+    }
+
+    // Same as scVM::SetProfiler, each instruction is counted once for all lanes
+    bool SetProfiler(scProfiler* pProfiler);
+
+    // =======================
+    //  Register Manipulation
+    // =======================
+    [[nodiscard]]
+    const float* GetRegisterLanes(scRegister regIndex) const {
+        return _registers[static_cast<int>(regIndex)].lanes;
+    }
+
+    [[nodiscard]]
+    scValue_u GetRegister(scRegister regIndex, int lane) const {
+        scValue_u value;
+        value.f32 = _registers[static_cast<int>(regIndex)].lanes[lane];
+
+        return value;
+    }
+
+    // =====================
+    //  Memory Manipulation
+    // =====================
+    template<typename T>
+    bool PokeLane(int lane, uint32_t index, T value) {
+        if (index + sizeof(T) > _memorySize)
+            return false;
+
+        uint8_t* pLane = _memory.data() + lane * _memorySize;
+
+        if (scIsUniformMemory(index, sizeof(T)) && std::memcmp(pLane + index, &value, sizeof(T)) != 0)
+            _uniformsDirty = true;
+
+        std::memcpy(pLane + index, &value, sizeof(T));
+        return true;
+    }
+
+    template<typename T>
+    bool Poke(uint32_t index, T value) {
+        for (int l = 0; l < LANE_COUNT; l++) {
+            if (!PokeLane(l, index, value))
+                return false;
+        }
+
+        return true;
+    }
+
+    // ===================
+    //  Program Execution
+    // ===================
+    // Zeroes every register, or restores them to where the uniform prologue left them
+    void ResetRegisters();
+
+    // Runs every lane until the program exits
+    void ExecuteTillEnd();
+
+    // Lanes that stopped at a discard since the last ResetRegisters, their registers hold nothing meaningful
+    [[nodiscard]]
+    uint32_t GetDiscardMask() const {
+        return _discardMask;
+    }
+
+protected:
+    void RunPrologue();
+
+    bool ExecuteInstruction(const scInstruction& instruction);
+
+    // Lanes keep their own instruction pointer, the lanes at the lowest one run together under an active mask
+    //   - Lanes that branched ahead wait for the others to catch up, so diverged lanes rejoin where their paths meet
+    //   - When every lane agrees on a branch nothing is masked and the whole group moves at once
+    void RunBranching();
+
+    // Runs a single instruction for the lanes in active, branches move their entries of pLaneIp and discards take
+    // lanes out of active. Returns false once no lane of active is left running
+    bool ExecuteGroup(const scInstruction& instruction, uint32_t ip, uint32_t& active, uint32_t* pLaneIp);
+
+    // Lanes outside of active keep the registers instruction writes
+    bool ExecuteMasked(const scInstruction& instruction, uint32_t active);
+
+    // Drops the live lanes set in discarded and packs the rest together, returns false when none are left
+    bool CompactLanes(uint32_t discarded);
+
+    // Moves every live lane back to where it started
+    void ExpandLanes();
+
+#ifdef SCHISM_PROFILER
+    void RunProfiled();
+#endif
+};
+
+#endif //SCHISM_SC_VM_WIDE_HPP
@@ -0,0 +1,410 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_vm_wide.hpp"
+
+#include <cmath>
+
+#include <schism/sc_cpu.hpp>
+
+#ifdef SCHISM_ARCH_X86
+#include <immintrin.h>
+#endif
+
+// ================
+//  Vector Kernels
+// ================
+
+// Components are rows count floats apart, every input is loaded before the first store as A and B may overlap
+#define SC_VECTOR_KERNELS(ISA, TARGET, WIDTH, LOAD, STORE, ADD, SUB, MUL)                            \
+    TARGET static void ISA##_MulMatrixVector(float* pA, const float* pB, int count) {               \
+        for (int l = 0; l < count; l += WIDTH) {                                                    \
+            auto x = LOAD(pA + l);                                                                  \
+            auto y = LOAD(pA + count + l);                                                          \
+            auto z = LOAD(pA + count * 2 + l);                                                      \
+            auto w = LOAD(pA + count * 3 + l);                                                      \
+                                                                                                    \
+            decltype(x) result[4];                                                                  \
+                                                                                                    \
+            for (int i = 0; i < 4; i++) {                                                           \
+                const float* pRow = pB + count * i * 4 + l;                                         \
+                                                                                                    \
+                result[i] = ADD(ADD(MUL(LOAD(pRow), x), MUL(LOAD(pRow + count), y)),                \
+                                ADD(MUL(LOAD(pRow + count * 2), z), MUL(LOAD(pRow + count * 3), w)));\
+            }                                                                                       \
+                                                                                                    \
+            for (int i = 0; i < 4; i++)                                                             \
+                STORE(pA + count * i + l, result[i]);                                               \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    TARGET static void ISA##_MulMatrixMatrix(float* pA, const float* pB, int count) {               \
+        for (int l = 0; l < count; l += WIDTH) {                                                    \
+            decltype(LOAD(pB)) b[16];                                                               \
+                                                                                                    \
+            for (int e = 0; e < 16; e++)                                                            \
+                b[e] = LOAD(pB + count * e + l);                                                    \
+                                                                                                    \
+            /* Row i of A is only read by row i of the result, so it can be written straight back */\
+            for (int i = 0; i < 4; i++) {                                                           \
+                float* pRow = pA + count * i * 4 + l;                                               \
+                                                                                                    \
+                auto a0 = LOAD(pRow);                                                               \
+                auto a1 = LOAD(pRow + count);                                                       \
+                auto a2 = LOAD(pRow + count * 2);                                                   \
+                auto a3 = LOAD(pRow + count * 3);                                                   \
+                                                                                                    \
+                for (int j = 0; j < 4; j++) {                                                       \
+                    STORE(pRow + count * j, ADD(ADD(MUL(a0, b[j]), MUL(a1, b[4 + j])),              \
+                                                ADD(MUL(a2, b[8 + j]), MUL(a3, b[12 + j]))));       \
+                }                                                                                   \
+            }                                                                                       \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    TARGET static void ISA##_Dot3(float* pA, const float* pB, int count) {                          \
+        for (int l = 0; l < count; l += WIDTH) {                                                    \
+            auto dot = ADD(ADD(MUL(LOAD(pA + l), LOAD(pB + l)),                                     \
+                               MUL(LOAD(pA + count + l), LOAD(pB + count + l))),                    \
+                           MUL(LOAD(pA + count * 2 + l), LOAD(pB + count * 2 + l)));                \
+                                                                                                    \
+            for (int d = 0; d < 4; d++)                                                             \
+                STORE(pA + count * d + l, dot);                                                     \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    TARGET static void ISA##_Dot4(float* pA, const float* pB, int count) {                          \
+        for (int l = 0; l < count; l += WIDTH) {                                                    \
+            auto dot = ADD(ADD(MUL(LOAD(pA + l), LOAD(pB + l)),                                     \
+                               MUL(LOAD(pA + count + l), LOAD(pB + count + l))),                    \
+                           ADD(MUL(LOAD(pA + count * 2 + l), LOAD(pB + count * 2 + l)),             \
+                               MUL(LOAD(pA + count * 3 + l), LOAD(pB + count * 3 + l))));           \
+                                                                                                    \
+            for (int d = 0; d < 4; d++)                                                             \
+                STORE(pA + count * d + l, dot);                                                     \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    TARGET static void ISA##_Cross(float* pA, const float* pB, int count) {                         \
+        for (int l = 0; l < count; l += WIDTH) {                                                    \
+            auto ax = LOAD(pA + l);                                                                 \
+            auto ay = LOAD(pA + count + l);                                                         \
+            auto az = LOAD(pA + count * 2 + l);                                                     \
+            auto bx = LOAD(pB + l);                                                                 \
+            auto by = LOAD(pB + count + l);                                                         \
+            auto bz = LOAD(pB + count * 2 + l);                                                     \
+                                                                                                    \
+            STORE(pA + l, SUB(MUL(ay, bz), MUL(az, by)));                                           \
+            STORE(pA + count + l, SUB(MUL(az, bx), MUL(ax, bz)));                                   \
+            STORE(pA + count * 2 + l, SUB(MUL(ax, by), MUL(ay, bx)));                               \
+        }                                                                                           \
+    }
+
+// =================
+//  Generic Kernels
+// =================
+#define SC_GENERIC_BINARY(NAME, EXPR)                                   \
+    static void Generic_##NAME(float* pA, const float* pB, int count) { \
+        for (int l = 0; l < count; l++) {                               \
+            float a = pA[l];                                            \
+            float b = pB[l];                                            \
+            pA[l] = EXPR;                                               \
+        }                                                               \
+    }
+
+SC_GENERIC_BINARY(Add, a + b)
+SC_GENERIC_BINARY(Sub, a - b)
+SC_GENERIC_BINARY(Mul, a * b)
+SC_GENERIC_BINARY(Div, a / b)
+
+static void Generic_Abs(float* pA, int count) {
+    for (int l = 0; l < count; l++)
+        pA[l] = fabsf(pA[l]);
+}
+
+static void Generic_Fill(float* pA, float value, int count) {
+    for (int l = 0; l < count; l++)
+        pA[l] = value;
+}
+
+static inline float Generic_Load(const float* pValue) {
+    return *pValue;
+}
+
+static inline void Generic_Store(float* pValue, float value) {
+    *pValue = value;
+}
+
+static inline float Generic_AddSs(float a, float b) {
+    return a + b;
+}
+
+static inline float Generic_SubSs(float a, float b) {
+    return a - b;
+}
+
+static inline float Generic_MulSs(float a, float b) {
+    return a * b;
+}
+
+SC_VECTOR_KERNELS(Generic, , 1, Generic_Load, Generic_Store, Generic_AddSs, Generic_SubSs, Generic_MulSs)
+
+#define SC_GENERIC_COMPARE(NAME, OP)                                                                    \
+    static void Generic_##NAME(float* pOut, const float* pLhs, const float* pRhs, int count) {          \
+        for (int l = 0; l < count; l++)                                                                 \
+            pOut[l] = pLhs[l] OP pRhs[l] ? 1.0f : 0.0f;                                                 \
+    }
+
+SC_GENERIC_COMPARE(Less, <)
+SC_GENERIC_COMPARE(LessEqual, <=)
+SC_GENERIC_COMPARE(Equal, ==)
+SC_GENERIC_COMPARE(NotEqual, !=)
+
+static void Generic_Select(float* pA, const float* pB, const float* pCondition, int count) {
+    for (int l = 0; l < count; l++)
+        pA[l] = pCondition[l] != 0 ? pB[l] : pA[l];
+}
+
+static const scWideKernels GENERIC_KERNELS = {
+    scWideIsa::Generic, 1,
+    Generic_Add, Generic_Sub, Generic_Mul, Generic_Div,
+    Generic_Abs, Generic_Fill,
+    Generic_MulMatrixVector, Generic_MulMatrixMatrix,
+    Generic_Dot3, Generic_Dot4, Generic_Cross,
+    Generic_Less, Generic_LessEqual, Generic_Equal, Generic_NotEqual,
+    Generic_Select
+};
+
+#ifdef SCHISM_ARCH_X86
+// ===========================
+//  x86 Kernels, SSE2 / AVX2 / AVX-512
+// ===========================
+
+// Register rows are 64 byte aligned so every load and store here is aligned
+#define SC_X86_BINARY(ISA, TARGET, WIDTH, LOAD, STORE, NAME, OP)                \
+    TARGET static void ISA##_##NAME(float* pA, const float* pB, int count) {    \
+        for (int l = 0; l < count; l += WIDTH)                                  \
+            STORE(pA + l, OP(LOAD(pA + l), LOAD(pB + l)));                      \
+    }
+
+// COMPARE is a template over the _CMP_ predicate that returns 1.0 where it holds and 0.0 elsewhere
+#define SC_X86_COMPARE(ISA, TARGET, WIDTH, LOAD, STORE, NAME, COMPARE, PREDICATE)                        \
+    TARGET static void ISA##_##NAME(float* pOut, const float* pLhs, const float* pRhs, int count) {     \
+        for (int l = 0; l < count; l += WIDTH)                                                          \
+            STORE(pOut + l, COMPARE<PREDICATE>(LOAD(pLhs + l), LOAD(pRhs + l)));                        \
+    }
+
+#define SC_X86_KERNELS(ISA, TARGET, WIDTH, LOAD, STORE, SET1, ADD, SUB, MUL, DIV, ABS, COMPARE, BLEND)  \
+    SC_X86_BINARY(ISA, TARGET, WIDTH, LOAD, STORE, Add, ADD)                            \
+    SC_X86_BINARY(ISA, TARGET, WIDTH, LOAD, STORE, Sub, SUB)                            \
+    SC_X86_BINARY(ISA, TARGET, WIDTH, LOAD, STORE, Mul, MUL)                            \
+    SC_X86_BINARY(ISA, TARGET, WIDTH, LOAD, STORE, Div, DIV)                            \
+                                                                                        \
+    TARGET static void ISA##_Abs(float* pA, int count) {                                \
+        for (int l = 0; l < count; l += WIDTH)                                          \
+            STORE(pA + l, ABS(LOAD(pA + l)));                                           \
+    }                                                                                   \
+                                                                                        \
+    TARGET static void ISA##_Fill(float* pA, float value, int count) {                  \
+        for (int l = 0; l < count; l += WIDTH)                                          \
+            STORE(pA + l, SET1(value));                                                 \
+    }                                                                                   \
+                                                                                        \
+    SC_VECTOR_KERNELS(ISA, TARGET, WIDTH, LOAD, STORE, ADD, SUB, MUL)                   \
+                                                                                        \
+    SC_X86_COMPARE(ISA, TARGET, WIDTH, LOAD, STORE, Less, COMPARE, _CMP_LT_OQ)          \
+    SC_X86_COMPARE(ISA, TARGET, WIDTH, LOAD, STORE, LessEqual, COMPARE, _CMP_LE_OQ)     \
+    SC_X86_COMPARE(ISA, TARGET, WIDTH, LOAD, STORE, Equal, COMPARE, _CMP_EQ_OQ)         \
+    SC_X86_COMPARE(ISA, TARGET, WIDTH, LOAD, STORE, NotEqual, COMPARE, _CMP_NEQ_UQ)     \
+                                                                                        \
+    TARGET static void ISA##_Select(float* pA, const float* pB, const float* pCondition, int count) {   \
+        for (int l = 0; l < count; l += WIDTH)                                          \
+            STORE(pA + l, BLEND(LOAD(pA + l), LOAD(pB + l), LOAD(pCondition + l)));     \
+    }                                                                                   \
+                                                                                        \
+    static const scWideKernels ISA##_KERNELS = {                                        \
+        scWideIsa::ISA, WIDTH,                                                          \
+        ISA##_Add, ISA##_Sub, ISA##_Mul, ISA##_Div,                                     \
+        ISA##_Abs, ISA##_Fill,                                                          \
+        ISA##_MulMatrixVector, ISA##_MulMatrixMatrix,                                   \
+        ISA##_Dot3, ISA##_Dot4, ISA##_Cross,                                            \
+        ISA##_Less, ISA##_LessEqual, ISA##_Equal, ISA##_NotEqual,                       \
+        ISA##_Select                                                                    \
+    };
+
+SC_TARGET("sse2") static inline __m128 SSE2_AbsPs(__m128 value) {
+    return _mm_and_ps(value, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+}
+
+SC_TARGET("avx2") static inline __m256 AVX2_AbsPs(__m256 value) {
+    return _mm256_and_ps(value, _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)));
+}
+
+// SSE2 has one compare per predicate instead of an immediate
+template<int PREDICATE>
+SC_TARGET("sse2") static inline __m128 SSE2_Compare(__m128 lhs, __m128 rhs) {
+    __m128 mask;
+
+    if constexpr (PREDICATE == _CMP_LT_OQ)
+        mask = _mm_cmplt_ps(lhs, rhs);
+    else if constexpr (PREDICATE == _CMP_LE_OQ)
+        mask = _mm_cmple_ps(lhs, rhs);
+    else if constexpr (PREDICATE == _CMP_EQ_OQ)
+        mask = _mm_cmpeq_ps(lhs, rhs);
+    else
+        mask = _mm_cmpneq_ps(lhs, rhs);
+
+    return _mm_and_ps(mask, _mm_set1_ps(1.0f));
+}
+
+template<int PREDICATE>
+SC_TARGET("avx2") static inline __m256 AVX2_Compare(__m256 lhs, __m256 rhs) {
+    return _mm256_and_ps(_mm256_cmp_ps(lhs, rhs, PREDICATE), _mm256_set1_ps(1.0f));
+}
+
+template<int PREDICATE>
+SC_TARGET("avx512f") static inline __m512 AVX512_Compare(__m512 lhs, __m512 rhs) {
+    return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(lhs, rhs, PREDICATE), _mm512_set1_ps(1.0f));
+}
+
+// b where condition isn't 0, a elsewhere
+SC_TARGET("sse2") static inline __m128 SSE2_Blend(__m128 a, __m128 b, __m128 condition) {
+    __m128 mask = _mm_cmpneq_ps(condition, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+SC_TARGET("avx2") static inline __m256 AVX2_Blend(__m256 a, __m256 b, __m256 condition) {
+    return _mm256_blendv_ps(a, b, _mm256_cmp_ps(condition, _mm256_setzero_ps(), _CMP_NEQ_UQ));
+}
+
+SC_TARGET("avx512f") static inline __m512 AVX512_Blend(__m512 a, __m512 b, __m512 condition) {
+    return _mm512_mask_mov_ps(a, _mm512_cmp_ps_mask(condition, _mm512_setzero_ps(), _CMP_NEQ_UQ), b);
+}
+
+SC_X86_KERNELS(SSE2, SC_TARGET("sse2"), 4,
+               _mm_load_ps, _mm_store_ps, _mm_set1_ps,
+               _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_div_ps, SSE2_AbsPs,
+               SSE2_Compare, SSE2_Blend)
+
+SC_X86_KERNELS(AVX2, SC_TARGET("avx2"), 8,
+               _mm256_load_ps, _mm256_store_ps, _mm256_set1_ps,
+               _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_div_ps, AVX2_AbsPs,
+               AVX2_Compare, AVX2_Blend)
+
+SC_X86_KERNELS(AVX512, SC_TARGET("avx512f"), 16,
+               _mm512_load_ps, _mm512_store_ps, _mm512_set1_ps,
+               _mm512_add_ps, _mm512_sub_ps, _mm512_mul_ps, _mm512_div_ps, _mm512_abs_ps,
+               AVX512_Compare, AVX512_Blend)
+#endif
+
+static_assert(scWideVM::LANE_COUNT % 16 == 0, "The widest kernel processes 16 lanes at once");
+
+// ==================
+//  Kernel Selection
+// ==================
+const char* scGetWideIsaName(scWideIsa isa) {
+    switch (isa) {
+        case scWideIsa::Generic:
+            return "Generic";
+
+        case scWideIsa::SSE2:
+            return "SSE2";
+
+        case scWideIsa::AVX2:
+            return "AVX2";
+
+        case scWideIsa::AVX512:
+            return "AVX512";
+    }
+
+    return nullptr;
+}
+
+bool scIsWideIsaSupported(scWideIsa isa) {
+#ifdef SCHISM_ARCH_X86
+    const scCpuFeatures& features = scGetCpuFeatures();
+#endif
+
+    switch (isa) {
+        case scWideIsa::Generic:
+            return true;
+
+#ifdef SCHISM_ARCH_X86
+        case scWideIsa::SSE2:
+            return features.sse2;
+
+        case scWideIsa::AVX2:
+            return features.avx2;
+
+        case scWideIsa::AVX512:
+            return features.avx512f;
+#endif
+
+        default:
+            return false;
+    }
+}
+
+const scWideKernels& scGetWideKernels(scWideIsa isa) {
+    if (!scIsWideIsaSupported(isa))
+        return scGetBestWideKernels();
+
+    switch (isa) {
+#ifdef SCHISM_ARCH_X86
+        case scWideIsa::SSE2:
+            return SSE2_KERNELS;
+
+        case scWideIsa::AVX2:
+            return AVX2_KERNELS;
+
+        case scWideIsa::AVX512:
+            return AVX512_KERNELS;
+#endif
+
+        default:
+            return GENERIC_KERNELS;
+    }
+}
+
+const scWideKernels& scGetBestWideKernels() {
+    static const scWideKernels& best = []() -> const scWideKernels& {
+        const scWideIsa preferred[] = { scWideIsa::AVX512, scWideIsa::AVX2, scWideIsa::SSE2 };
+
+        for (scWideIsa isa : preferred) {
+            if (scIsWideIsaSupported(isa))
+                return scGetWideKernels(isa);
+        }
+
+        return GENERIC_KERNELS;
+    }();
+
+    return best;
+}
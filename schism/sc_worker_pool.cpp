@@ -0,0 +1,166 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include "sc_worker_pool.hpp"
+
+#include <algorithm>
+
+// ===============
+//  Ctor and Dtor
+// ===============
+scWorkerPool::scWorkerPool(int threadCount) {
+    if (threadCount <= 0)
+        threadCount = (int)std::max(1U, std::thread::hardware_concurrency());
+
+    for (int w = 0; w < threadCount; w++)
+        _queues.emplace_back(std::make_unique<scWorkerQueue>());
+
+    // The caller is the last worker
+    for (int w = 0; w < threadCount - 1; w++)
+        _threads.emplace_back(&scWorkerPool::WorkerMain, this, w);
+}
+
+scWorkerPool::~scWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+
+    _wake.notify_all();
+
+    for (std::thread& thread : _threads)
+        thread.join();
+}
+
+// ==================
+//  Task Dispatching
+// ==================
+void scWorkerPool::Dispatch(int taskCount, const scTaskFunction& function) {
+    if (taskCount <= 0)
+        return;
+
+    int workers = GetWorkerCount();
+
+    // Hand out contiguous runs, the first few workers take one extra task if it doesn't divide evenly
+    int task = 0;
+
+    for (int w = 0; w < workers; w++) {
+        int count = taskCount / workers + (w < taskCount % workers ? 1 : 0);
+
+        std::lock_guard<std::mutex> lock(_queues[w]->mutex);
+
+        for (int t = 0; t < count; t++)
+            _queues[w]->tasks.push_back(task++);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _function = &function;
+        _busy = (int)_threads.size();
+        _generation++;
+    }
+
+    _wake.notify_all();
+
+    RunTasks(workers - 1);
+
+    // Every queue is empty at this point, but other workers may still be finishing their last task
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this]() { return _busy == 0; });
+
+    _function = nullptr;
+}
+
+void scWorkerPool::WorkerMain(int worker) {
+    uint64_t seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&]() { return _quit || _generation != seen; });
+
+            if (_quit)
+                return;
+
+            seen = _generation;
+        }
+
+        RunTasks(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (--_busy == 0)
+                _idle.notify_one();
+        }
+    }
+}
+
+void scWorkerPool::RunTasks(int worker) {
+    int task;
+
+    while (PopTask(worker, task) || StealTask(worker, task))
+        (*_function)(worker, task);
+}
+
+bool scWorkerPool::PopTask(int worker, int& outTask) {
+    scWorkerQueue& queue = *_queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (queue.tasks.empty())
+        return false;
+
+    outTask = queue.tasks.front();
+    queue.tasks.pop_front();
+
+    return true;
+}
+
+bool scWorkerPool::StealTask(int worker, int& outTask) {
+    int workers = GetWorkerCount();
+
+    // Thieves take from the back, the far end from where the owner is working
+    for (int v = 1; v < workers; v++) {
+        scWorkerQueue& queue = *_queues[(worker + v) % workers];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.tasks.empty())
+            continue;
+
+        outTask = queue.tasks.back();
+        queue.tasks.pop_back();
+
+        return true;
+    }
+
+    return false;
+}
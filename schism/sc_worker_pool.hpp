@@ -0,0 +1,105 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#ifndef SCHISM_SC_WORKER_POOL_HPP
+#define SCHISM_SC_WORKER_POOL_HPP
+
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs batches of indexed tasks across a fixed set of threads
+//   - Every worker owns a queue, an idle worker steals from the back of the others
+//   - The thread calling Dispatch takes part as the last worker, so there is always at least one
+class scWorkerPool {
+public:
+    typedef std::function<void(int worker, int task)> scTaskFunction;
+
+protected:
+    struct scWorkerQueue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    std::vector<std::thread> _threads;
+    std::vector<std::unique_ptr<scWorkerQueue>> _queues;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+
+    const scTaskFunction* _function = nullptr;
+
+    uint64_t _generation = 0;
+    int _busy = 0;
+    bool _quit = false;
+
+    // ===============
+    //  Ctor and Dtor
+    // ===============
+public:
+    // threadCount includes the calling thread, 0 uses every hardware thread
+    explicit scWorkerPool(int threadCount = 0);
+
+    ~scWorkerPool();
+
+    scWorkerPool(const scWorkerPool&) = delete;
+    scWorkerPool& operator=(const scWorkerPool&) = delete;
+
+public:
+    [[nodiscard]]
+    int GetWorkerCount() const {
+        return (int)_queues.size();
+    }
+
+    // Runs function for every task in [0, taskCount) and returns once all of them are done
+    //   - Tasks are handed out in contiguous runs so neighbouring tasks tend to stay on one worker
+    //   - Not reentrant, function must not call Dispatch
+    void Dispatch(int taskCount, const scTaskFunction& function);
+
+protected:
+    void WorkerMain(int worker);
+
+    void RunTasks(int worker);
+
+    bool PopTask(int worker, int& outTask);
+
+    bool StealTask(int worker, int& outTask);
+};
+
+#endif //SCHISM_SC_WORKER_POOL_HPP
@@ -0,0 +1,531 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include <cstdio>
+#include <cstring>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+#include <schism/sc_assembler.hpp>
+#include <schism/sc_module.hpp>
+#include <schism/sc_vm.hpp>
+#include <schism/sc_vm_wide.hpp>
+#include <schism/sc_renderer.hpp>
+
+// Every result is printed in this order with the same keys, so two runs can be diffed directly
+struct scBenchResult {
+    std::string name;
+
+    uint64_t iterations;
+    double nsPerOp;
+
+    // What a single op processes, lines, instructions or pixels
+    uint64_t itemsPerOp;
+};
+
+struct scBenchArguments {
+    std::string asmDir;
+    std::string outputPath;
+    std::string filter;
+
+    double minTime = 0.2;
+    int threads = 0;
+};
+
+struct scBenchShader {
+    std::string name;
+    scModuleRef module;
+};
+
+class scBench {
+protected:
+    scBenchArguments _arguments;
+    std::vector<scBenchResult> _results;
+
+public:
+    explicit scBench(const scBenchArguments& arguments) : _arguments(arguments) {
+
+    }
+
+    // fn(iterations) runs the op that many times
+    //   - Iterations double until a run takes at least minTime, the fastest of 3 runs at that count is kept
+    template<typename F>
+    void Measure(const std::string& name, uint64_t itemsPerOp, F&& fn) {
+        if (!_arguments.filter.empty() && name.find(_arguments.filter) == std::string::npos)
+            return;
+
+        std::fprintf(stderr, "[schism_bench]: %s\n", name.c_str());
+
+        auto time = [&](uint64_t iterations) {
+            auto start = std::chrono::steady_clock::now();
+            fn(iterations);
+
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        uint64_t iterations = 1;
+        double seconds = time(iterations);
+
+        while (seconds < _arguments.minTime) {
+            iterations *= 2;
+            seconds = time(iterations);
+        }
+
+        for (int r = 0; r < 2; r++)
+            seconds = std::min(seconds, time(iterations));
+
+        _results.push_back({ name, iterations, seconds * 1e9 / (double)iterations, itemsPerOp });
+    }
+
+    void WriteJson(FILE* pFile) const {
+        std::fprintf(pFile, "{\n");
+        std::fprintf(pFile, "  \"version\": 1,\n");
+        std::fprintf(pFile, "  \"min_time\": %.3f,\n", _arguments.minTime);
+        std::fprintf(pFile, "  \"results\": [\n");
+
+        for (size_t r = 0; r < _results.size(); r++) {
+            const scBenchResult& result = _results[r];
+
+            double nsPerItem = result.nsPerOp / (double)result.itemsPerOp;
+
+            std::fprintf(
+                pFile,
+                "    { \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"items_per_op\": %llu, \"ns_per_item\": %.3f, \"items_per_second\": %.0f }%s\n",
+                result.name.c_str(),
+                (unsigned long long)result.iterations,
+                result.nsPerOp,
+                (unsigned long long)result.itemsPerOp,
+                nsPerItem,
+                1e9 / nsPerItem,
+                r + 1 < _results.size() ? "," : ""
+            );
+        }
+
+        std::fprintf(pFile, "  ]\n");
+        std::fprintf(pFile, "}\n");
+    }
+};
+
+// Keeps results alive so the compiler can't drop the work that produced them
+static volatile float gSink;
+
+// ==================
+//  Program Sources
+// ==================
+static const char* GENERATED_LINES[] = {
+    "; generated",
+    "ld_f32 %S0 00",
+    "ld_f32 %S1 04",
+    "set_f32 %S2 0.5",
+    "set_f32 %S3 1.0",
+    "alu_f32_f32 mul %V0 %V1",
+    "alu_f32_f32 add %S8 %S9",
+    "mov %FB0 %S0",
+    "abs_f32 %S4",
+};
+
+std::string GenerateSource(int lineCount) {
+    std::string source;
+
+    for (int l = 0; l < lineCount; l++) {
+        source += GENERATED_LINES[l % (sizeof(GENERATED_LINES) / sizeof(GENERATED_LINES[0]))];
+        source += "\n";
+    }
+
+    return source + "exit\n";
+}
+
+struct scOpcodeBench {
+    const char* pName;
+    const char* pLine;
+};
+
+// One entry per scOpcode that can be written in assembly, EXIT, NOP, DISCARD and branches excluded
+static const scOpcodeBench OPCODE_BENCHES[] = {
+    { "mov", "mov %S2 %S1" },
+    { "add_f32", "alu_f32_f32 add %S0 %S1" },
+    { "sub_f32", "alu_f32_f32 sub %S0 %S1" },
+    { "mul_f32", "alu_f32_f32 mul %S0 %S1" },
+    { "div_f32", "alu_f32_f32 div %S0 %S1" },
+    { "mod_f32", "alu_f32_f32 mod %S0 %S1" },
+    { "pow_f32", "alu_f32_f32 pow %S0 %S1" },
+    { "add_v4f32", "alu_f32_f32 add %V0 %V1" },
+    { "sub_v4f32", "alu_f32_f32 sub %V0 %V1" },
+    { "mul_v4f32", "alu_f32_f32 mul %V0 %V1" },
+    { "div_v4f32", "alu_f32_f32 div %V0 %V1" },
+    { "mod_v4f32", "alu_f32_f32 mod %V0 %V1" },
+    { "pow_v4f32", "alu_f32_f32 pow %V0 %V1" },
+    { "add_v4f32_v6_v3", "alu_f32_f32 add %V6 %V3" },
+    { "mul_v4f32_s_v", "alu_f32_f32 mul %S1 %V0" },
+    { "set_f32", "set_f32 %S2 1.0" },
+    { "ld_f32", "ld_f32 %S2 08" },
+    { "abs_f32", "abs_f32 %S2" },
+    { "smp_point", "smp_point %V2 %S0 %S2 0" },
+    { "smp_linear", "smp_linear %V2 %S0 %S2 0" },
+    { "mat_mul_vec", "mat_mul_vec %V1 %M1" },
+    { "mat_mul_mat", "mat_mul_mat %M1 %M0" },
+    { "mat_transpose", "mat_transpose %M0" },
+    { "vec_dot3", "vec_dot3 %V2 %V1" },
+    { "vec_dot4", "vec_dot4 %V2 %V1" },
+    { "vec_cross", "vec_cross %V2 %V1" },
+    { "cmp_f32", "cmp_f32 lt %S2 %S1" },
+    { "sel_f32", "sel_f32 %S2 %S1 %S0" },
+    { "discard_nz", "discard_nz %S8" },
+};
+
+// S0 - S7 start at 1.0, so repeating any operation never reaches denormals
+std::string GenerateOpcodeSource(const char* pLine, int count) {
+    std::string source;
+
+    for (int r = 0; r < 8; r++)
+        source += "set_f32 %S" + std::to_string(r) + " 1.0\n";
+
+    for (int c = 0; c < count; c++) {
+        source += pLine;
+        source += "\n";
+    }
+
+    return source + "exit\n";
+}
+
+bool Assemble(const std::string& source, scModule& outModule) {
+    scAssembler assembler;
+    scAssembledProgram program;
+
+    if (assembler.CompileSourceText(source, program) != scAssemblerState::OK)
+        return false;
+
+    outModule = program.CreateModule();
+    outModule.Verify();
+
+    return true;
+}
+
+// ============
+//  Benchmarks
+// ============
+void BenchAssembler(scBench& bench) {
+    const int LINE_COUNT = 20000;
+
+    std::string source = GenerateSource(LINE_COUNT);
+
+    bench.Measure("assembler/compile_text/lines_20000", LINE_COUNT, [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            scAssembler assembler;
+            scAssembledProgram program;
+
+            assembler.CompileSourceText(source, program);
+            gSink = (float)program.binary.size();
+        }
+    });
+}
+
+void BenchModuleLoad(scBench& bench) {
+    scAssembler assembler;
+    scAssembledProgram program;
+
+    assembler.CompileSourceText(GenerateSource(20000), program);
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "schism_bench.scsm";
+    program.WriteToFile(path.string());
+
+    uint64_t instructionCount = program.CreateModule().GetInstructions().size();
+
+    bench.Measure("module/load_from_file/lines_20000", instructionCount, [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            scModule module;
+
+            module.LoadFromFile(path.string());
+            gSink = (float)module.GetInstructions().size();
+        }
+    });
+
+    std::error_code error;
+    std::filesystem::remove(path, error);
+}
+
+void BenchDispatch(scBench& bench) {
+    const int COUNT = 1000;
+
+    const scDispatchMode modes[] = { scDispatchMode::Switch, scDispatchMode::Threaded, scDispatchMode::TailCall, scDispatchMode::Jit };
+
+    // Bound to slot 0 for the sample instructions
+    const int TEXTURE_SIZE = 256;
+
+    std::vector<float> texels((size_t)TEXTURE_SIZE * TEXTURE_SIZE * 4, 0.5f);
+    std::shared_ptr<scTexture> texture = std::make_shared<scTexture>();
+
+    texture->Create(TEXTURE_SIZE, TEXTURE_SIZE, texels.data(), TEXTURE_SIZE * 4 * sizeof(float));
+
+    for (const scOpcodeBench& opcode : OPCODE_BENCHES) {
+        scModule module;
+
+        if (!Assemble(GenerateOpcodeSource(opcode.pLine, COUNT), module))
+            continue;
+
+        for (scDispatchMode mode : modes) {
+            if (!scVM::IsDispatchModeSupported(mode))
+                continue;
+
+            scVM vm(512);
+            vm.SetDispatchMode(mode);
+            vm.LoadProgram(module);
+            vm.BindTexture(0, texture);
+
+            std::string name = std::string("dispatch/") + scGetDispatchModeName(mode) + "/" + opcode.pName;
+
+            bench.Measure(name, COUNT, [&](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    vm.ResetRegisters();
+                    vm.ExecuteTillEnd();
+                }
+
+                gSink = vm.GetRegister(scRegister::S0).f32;
+            });
+        }
+    }
+}
+
+void BenchPixels(scBench& bench, const std::vector<scBenchShader>& shaders) {
+    const int SIZE = 64;
+
+    const scDispatchMode modes[] = { scDispatchMode::Switch, scDispatchMode::Threaded, scDispatchMode::TailCall, scDispatchMode::Jit };
+
+    for (const scBenchShader& shader : shaders) {
+        for (scDispatchMode mode : modes) {
+            if (!scVM::IsDispatchModeSupported(mode))
+                continue;
+
+            scVM vm(512);
+            vm.SetDispatchMode(mode);
+            vm.LoadProgram(shader.module);
+
+            vm.Poke<float>(sizeof(int) * 2, SIZE - 1);
+            vm.Poke<float>(sizeof(int) * 3, SIZE - 1);
+
+            std::string name = std::string("pixel/") + scGetDispatchModeName(mode) + "/" + shader.name;
+
+            bench.Measure(name, SIZE * SIZE, [&](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    for (int y = 0; y < SIZE; y++) {
+                        for (int x = 0; x < SIZE; x++) {
+                            vm.ResetRegisters();
+
+                            vm.Poke<float>(0, x);
+                            vm.Poke<float>(sizeof(int), y);
+                            vm.ExecuteTillEnd();
+                        }
+                    }
+                }
+
+                gSink = vm.GetRegister(scRegister::FB0).f32;
+            });
+        }
+
+        const scWideIsa isas[] = { scWideIsa::Generic, scWideIsa::SSE2, scWideIsa::AVX2, scWideIsa::AVX512 };
+
+        for (scWideIsa isa : isas) {
+            if (!scIsWideIsaSupported(isa))
+                continue;
+
+            scWideVM vm(512);
+            vm.SetIsa(isa);
+            vm.LoadProgram(shader.module);
+
+            vm.Poke<float>(sizeof(int) * 2, SIZE - 1);
+            vm.Poke<float>(sizeof(int) * 3, SIZE - 1);
+
+            std::string name = std::string("pixel/Wide") + scGetWideIsaName(isa) + "/" + shader.name;
+
+            bench.Measure(name, SIZE * SIZE, [&](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    for (int y = 0; y < SIZE; y++) {
+                        for (int x = 0; x < SIZE; x += scWideVM::LANE_COUNT) {
+                            vm.ResetRegisters();
+
+                            for (int l = 0; l < scWideVM::LANE_COUNT; l++) {
+                                vm.PokeLane<float>(l, 0, x + l);
+                                vm.PokeLane<float>(l, sizeof(int), y);
+                            }
+
+                            vm.ExecuteTillEnd();
+                        }
+                    }
+                }
+
+                gSink = vm.GetRegister(scRegister::FB0, 0).f32;
+            });
+        }
+    }
+}
+
+void BenchFrames(scBench& bench, const std::vector<scBenchShader>& shaders, int threads) {
+    const int SIZES[] = { 256, 1024, 4096 };
+
+    scRenderer renderer(threads);
+
+    for (const scBenchShader& shader : shaders) {
+        renderer.LoadProgram(shader.module);
+
+        for (scRenderBackend backend : { scRenderBackend::Wide, scRenderBackend::Scalar }) {
+            renderer.SetBackend(backend);
+
+            for (int size : SIZES) {
+                std::vector<uint8_t> pixels((size_t)size * size * 4);
+
+                std::string name = std::string("frame/")
+                                   + (backend == scRenderBackend::Wide ? "Wide" : "Scalar")
+                                   + "/" + shader.name
+                                   + "/" + std::to_string(size);
+
+                bench.Measure(name, (uint64_t)size * size, [&](uint64_t iterations) {
+                    for (uint64_t i = 0; i < iterations; i++)
+                        renderer.Render(size, size, pixels.data(), (size_t)size * 4);
+
+                    gSink = pixels[0];
+                });
+            }
+        }
+    }
+}
+
+// ======
+//  Main
+// ======
+void PrintUsage() {
+    std::printf(
+        "usage: schism_bench [options]\n"
+        "\n"
+        "  --asm-dir <dir>      directory with the .scsa shaders to render, defaults to asm next to the executable\n"
+        "  --output <path>      writes the JSON results to a file instead of stdout\n"
+        "  --filter <text>      only runs benchmarks whose name contains text\n"
+        "  --min-time <sec>     minimum duration of a measured run, defaults to 0.2\n"
+        "  --threads <count>    renderer threads for the frame benchmarks, 0 uses every hardware thread\n"
+    );
+}
+
+bool ParseArguments(int argc, char* argv[], scBenchArguments& outArguments) {
+    outArguments.asmDir = (std::filesystem::path(argv[0]).parent_path() / "asm").string();
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+
+        if (a + 1 >= argc)
+            return false;
+
+        if (arg == "--asm-dir")
+            outArguments.asmDir = argv[++a];
+        else if (arg == "--output")
+            outArguments.outputPath = argv[++a];
+        else if (arg == "--filter")
+            outArguments.filter = argv[++a];
+        else if (arg == "--min-time")
+            outArguments.minTime = std::atof(argv[++a]);
+        else if (arg == "--threads")
+            outArguments.threads = std::atoi(argv[++a]);
+        else
+            return false;
+    }
+
+    return true;
+}
+
+std::vector<scBenchShader> LoadShaders(const std::string& directory) {
+    std::vector<scBenchShader> shaders;
+    std::error_code error;
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.path().extension() != ".scsa")
+            continue;
+
+        scAssembler assembler;
+        scAssembledProgram program;
+
+        if (assembler.CompileSourceFile(entry.path().string(), program) != scAssemblerState::OK)
+            continue;
+
+        scModule module = program.CreateModule();
+        module.Verify();
+
+        shaders.push_back({ entry.path().stem().string(), scShareModule(std::move(module)) });
+    }
+
+    // Directory order isn't stable
+    std::sort(shaders.begin(), shaders.end(), [](const scBenchShader& a, const scBenchShader& b) {
+        return a.name < b.name;
+    });
+
+    return shaders;
+}
+
+int main(int argc, char* argv[]) {
+    scBenchArguments arguments;
+
+    if (!ParseArguments(argc, argv, arguments)) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<scBenchShader> shaders = LoadShaders(arguments.asmDir);
+
+    if (shaders.empty())
+        std::fprintf(stderr, "[schism_bench]: No shaders found in (%s)\n", arguments.asmDir.c_str());
+
+    scBench bench(arguments);
+
+    BenchAssembler(bench);
+    BenchModuleLoad(bench);
+    BenchDispatch(bench);
+    BenchPixels(bench, shaders);
+    BenchFrames(bench, shaders, arguments.threads);
+
+    FILE* pFile = stdout;
+
+    if (!arguments.outputPath.empty()) {
+        pFile = std::fopen(arguments.outputPath.c_str(), "w");
+
+        if (pFile == nullptr) {
+            std::fprintf(stderr, "[schism_bench]: Failed to open (%s)\n", arguments.outputPath.c_str());
+            return 1;
+        }
+    }
+
+    bench.WriteJson(pFile);
+
+    if (pFile != stdout)
+        std::fclose(pFile);
+
+    return 0;
+}
@@ -30,6 +30,8 @@
 //====================================================================================
 
 #include <string>
+#include <thread>
+#include <algorithm>
 
 #include <SDL.h>
 
@@ -40,6 +42,9 @@
 
 #include <schism/sc_assembler.hpp>
 #include <schism/sc_vm.hpp>
+#include <schism/sc_renderer.hpp>
+#include <schism/sc_progressive_renderer.hpp>
+#include <schism/sc_profiler.hpp>
 
 template<size_t START, size_t END>
 void PrintRegisterTable(const scVM& vm, const char* pTable) {
@@ -70,40 +75,16 @@ void PrintRegisterTable(const scVM& vm, const char* pTable) {
     ImGui::EndTable();
 }
 
-void RenderAsync(scVM& vm, SDL_Texture* pSurfaceTex, int curSurfaceWidth, int curSurfaceHeight) {
-    uint8_t* pRenderPixels;
-    int pitch;
-    SDL_LockTexture(pSurfaceTex, nullptr, (void **) &pRenderPixels, &pitch);
-
-    for (int y = 0; y < curSurfaceHeight; y++) {
-        for (int x = 0; x < curSurfaceWidth; x++) {
-            vm.ResetRegisters();
-
-            vm.Poke<float>(0, x);
-            vm.Poke<float>(sizeof(int), y);
-            vm.ExecuteTillEnd();
-
-            int index = (y * curSurfaceWidth * 4) + (x * 4);
-
-            // A
-            pRenderPixels[index + 3] = vm.GetRegister(scRegister::FB3).f32 * 255;
-
-            // R
-            pRenderPixels[index + 2] = vm.GetRegister(scRegister::FB0).f32 * 255;
-
-            // G
-            pRenderPixels[index + 1] = vm.GetRegister(scRegister::FB1).f32 * 255;
-
-            // B
-            pRenderPixels[index + 0] = vm.GetRegister(scRegister::FB2).f32 * 255;
-        }
-    }
+void RenderPixel() {
 
-    SDL_UnlockTexture(pSurfaceTex);
 }
 
-void RenderPixel() {
+// The surface texture only comes in formats SDL can display without converting
+Uint32 GetSurfaceTextureFormat(scPixelFormat format) {
+    if (format == scPixelFormat::RGBA8 || format == scPixelFormat::RGBA8Srgb)
+        return SDL_PIXELFORMAT_RGBA32;
 
+    return SDL_PIXELFORMAT_ARGB8888;
 }
 
 int main(int argc, char* argv[]) {
@@ -138,10 +119,22 @@ int main(int argc, char* argv[]) {
     scAssembler assembler;
     scAssembledProgram program;
     scAssemblerState lastAsmState = scAssemblerState::OK;
+    scVerifierResult lastVerifierResult {};
 
     scVM vm(512);
     vm.ResetRegisters();
 
+    // Counts what vm executes while profiling is on
+    scProfiler profiler;
+    bool profiling = false;
+    int sampleInterval = 0;
+
+    // Used for whole surface renders, one hardware thread is left to the UI
+    scRenderer renderer(std::max(1, (int) std::thread::hardware_concurrency() - 1));
+
+    // Fills the surface in the background, the renderer must not be touched without stopping it first
+    scProgressiveRenderer progressiveRenderer(renderer);
+
     int curSurfaceWidth = 64;
     int curSurfaceHeight = 64;
 
@@ -152,9 +145,12 @@ int main(int argc, char* argv[]) {
 
     int renderPoint[2] = {0, 0};
 
+    // ARGB8888 is what SDL textures use natively, so uploads don't have to be converted again
+    scPixelFormat surfaceFormat = scPixelFormat::ARGB8888;
+
     SDL_Texture* pSurfaceTex = SDL_CreateTexture(
         pRenderer,
-        SDL_PIXELFORMAT_ARGB8888,
+        GetSurfaceTextureFormat(surfaceFormat),
         SDL_TEXTUREACCESS_STREAMING,
         curSurfaceWidth,
         curSurfaceHeight
@@ -168,8 +164,6 @@ int main(int argc, char* argv[]) {
     bool needStepInit = false;
     int autoSubSteps = 1;
 
-    //std::thread renderThread;
-
     while (run) {
         while (SDL_PollEvent(&sdlEvent)) {
             ImGui_ImplSDL2_ProcessEvent(&sdlEvent);
@@ -210,31 +204,32 @@ int main(int argc, char* argv[]) {
                 }
 
 
-                uint8_t * pRenderPixels;
-                int pitch;
-                SDL_LockTexture(pSurfaceTex, nullptr, (void**) &pRenderPixels, &pitch);
-
-                int index = (renderPoint[1] * curSurfaceWidth * 4) + (renderPoint[0] * 4);
+                uint8_t pixel[4];
 
-                // A
-                pRenderPixels[index + 3] = vm.GetRegister(scRegister::FB3).f32 * 255;
+                scResolvePixel(
+                    vm.GetRegister(scRegister::FB0).f32,
+                    vm.GetRegister(scRegister::FB1).f32,
+                    vm.GetRegister(scRegister::FB2).f32,
+                    vm.GetRegister(scRegister::FB3).f32,
+                    pixel,
+                    surfaceFormat
+                );
 
-                // R
-                pRenderPixels[index + 2] = vm.GetRegister(scRegister::FB0).f32 * 255;
-
-                // G
-                pRenderPixels[index + 1] = vm.GetRegister(scRegister::FB1).f32 * 255;
-
-                // B
-                pRenderPixels[index + 0] = vm.GetRegister(scRegister::FB2).f32 * 255;
-
-                SDL_UnlockTexture(pSurfaceTex);
+                // Only the pixel being stepped changes
+                SDL_Rect pixelRect = { renderPoint[0], renderPoint[1], 1, 1 };
+                SDL_UpdateTexture(pSurfaceTex, &pixelRect, pixel, sizeof(pixel));
             }
         } else {
             autoPixIsDone = false;
             needStepInit = true;
         }
 
+        // Progressive rendering, at most one upload of whatever changed since the last frame
+        progressiveRenderer.Upload([&](const scDirtyRegion& region, const uint8_t* pPixels, size_t pitch) {
+            SDL_Rect dirtyRect = { region.x0, region.y0, region.x1 - region.x0, region.y1 - region.y0 };
+            SDL_UpdateTexture(pSurfaceTex, &dirtyRect, pPixels, (int) pitch);
+        });
+
         ImGui_ImplSDL2_NewFrame();
         ImGui_ImplSDLRenderer2_NewFrame();
         ImGui::NewFrame();
@@ -252,12 +247,23 @@ int main(int argc, char* argv[]) {
             lastAsmState = assembler.CompileSourceText(strSource, program);
 
             if (lastAsmState == scAssemblerState::OK) {
-                vm.LoadProgram(program.CreateModule());
+                // Unverified modules still run, just with every load bound checked
+                scModule module = program.CreateModule();
+                lastVerifierResult = module.Verify();
+
+                scModuleRef sharedModule = scShareModule(std::move(module));
+
+                progressiveRenderer.Stop();
+
+                vm.LoadProgram(sharedModule);
+                renderer.LoadProgram(sharedModule);
             }
         }
 
         if (lastAsmState != scAssemblerState::OK) {
             ImGui::Text("Compilation returned code %i", (int) lastAsmState);
+        } else if (lastVerifierResult.state != scVerifierState::OK) {
+            ImGui::Text("Compilation successful, verification failed (%s at 0x%x)", scGetVerifierStateName(lastVerifierResult.state), lastVerifierResult.offset);
         } else {
             ImGui::Text("Compilation successful!");
         }
@@ -279,11 +285,42 @@ int main(int argc, char* argv[]) {
             ImGui::SameLine();
 
             if (ImGui::Button("Render Surface")) {
-                //if (renderThread.joinable())
-                //    renderThread.join(); // Kill the previous thread first
+                progressiveRenderer.Start(curSurfaceWidth, curSurfaceHeight, surfaceFormat);
+            }
+
+            ImGui::SameLine();
+
+            if (ImGui::Button("Stop")) {
+                progressiveRenderer.Stop();
+            }
+
+            ImGui::ProgressBar(progressiveRenderer.GetProgress());
+        }
+        {
+            const char* dispatchModes[] = { "Switch", "Threaded", "TailCall", "Jit" };
+            int dispatchMode = (int) vm.GetDispatchMode();
+
+            if (ImGui::Combo("Dispatch", &dispatchMode, dispatchModes, IM_ARRAYSIZE(dispatchModes))) {
+                progressiveRenderer.Stop();
 
-                //renderThread = std::thread(RenderAsync, vm, pSurfaceTex, curSurfaceWidth, curSurfaceHeight);
-                RenderAsync(vm, pSurfaceTex, curSurfaceWidth, curSurfaceHeight);
+                vm.SetDispatchMode((scDispatchMode) dispatchMode);
+                renderer.SetDispatchMode((scDispatchMode) dispatchMode);
+            }
+
+            // Scalar renders use the dispatch mode above
+            const char* renderBackends[] = { "Wide", "Scalar" };
+            int renderBackend = (int) renderer.GetBackend();
+
+            if (ImGui::Combo("Render Backend", &renderBackend, renderBackends, IM_ARRAYSIZE(renderBackends))) {
+                progressiveRenderer.Stop();
+                renderer.SetBackend((scRenderBackend) renderBackend);
+            }
+
+            bool hoistUniforms = renderer.GetUniformHoisting();
+
+            if (ImGui::Checkbox("Hoist Uniforms", &hoistUniforms)) {
+                progressiveRenderer.Stop();
+                renderer.SetUniformHoisting(hoistUniforms);
             }
         }
         {
@@ -444,12 +481,22 @@ int main(int argc, char* argv[]) {
         //
         ImGui::Begin("Loaded Program");
 
-        if (vm.GetProgram().has_value()) {
+        const scModuleRef& loadedProgram = vm.GetProgram();
+
+        if (loadedProgram != nullptr) {
             ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 0));
 
+            // IP indexes the decoded instructions, map it back onto the byte code
+            scSpan<const scInstruction> instructions = loadedProgram->GetInstructions();
+            uint32_t ip = vm.GetRegister(scRegister::IP).u32;
+
+            uint32_t atBegin = ip < instructions.size() ? instructions[ip].offset : UINT32_MAX;
+            uint32_t atEnd = ip < instructions.size() ? atBegin + instructions[ip].size : UINT32_MAX;
+
             size_t idx = 0;
-            for (uint8_t byte: vm.GetProgram()->GetCode()) {
-                bool at = idx++ == vm.GetRegister(scRegister::IP).u32;
+            for (uint8_t byte: loadedProgram->GetCode()) {
+                bool at = idx >= atBegin && idx < atEnd;
+                idx++;
 
                 ImGui::Text("0x%02x %c", byte, at ? '<' : ' ');
             }
@@ -459,6 +506,103 @@ int main(int argc, char* argv[]) {
 
         ImGui::End();
 
+        //
+        // Profiler
+        //
+        ImGui::Begin("Profile");
+
+        if (!scProfiler::IsSupported()) {
+            ImGui::Text("Schism was built without SCHISM_PROFILER");
+        } else {
+            if (ImGui::Checkbox("Profile", &profiling)) {
+                vm.SetProfiler(profiling ? &profiler : nullptr);
+            }
+
+            ImGui::SameLine();
+
+            if (ImGui::DragInt("Sample Interval", &sampleInterval, 0.1F, 0, 1000)) {
+                profiler.SetSampleInterval(sampleInterval);
+            }
+
+            if (ImGui::Button("Profile Surface")) {
+                vm.SetProfiler(&profiler);
+
+                for (int y = 0; y < curSurfaceHeight; y++) {
+                    for (int x = 0; x < curSurfaceWidth; x++) {
+                        vm.Poke<float>(0, x);
+                        vm.Poke<float>(sizeof(int), y);
+
+                        vm.ResetRegisters();
+                        vm.ExecuteTillEnd();
+                    }
+                }
+
+                vm.SetProfiler(profiling ? &profiler : nullptr);
+                vm.ResetRegisters();
+            }
+
+            ImGui::SameLine();
+
+            if (ImGui::Button("Clear")) {
+                profiler.Reset();
+            }
+
+            ImGui::SameLine();
+
+            if (ImGui::Button("Copy JSON") && vm.GetProgram() != nullptr) {
+                ImGui::SetClipboardText(profiler.ToJson(*vm.GetProgram()).c_str());
+            }
+
+            const scProfile& profile = profiler.GetProfile();
+            uint64_t total = profile.GetTotalCount();
+
+            ImGui::Text("%llu runs, %llu instructions", (unsigned long long) profile.runs, (unsigned long long) total);
+
+            if (ImGui::BeginTable("Classes", 3)) {
+                for (int c = 0; c < SC_OPCODE_CLASS_COUNT; c++) {
+                    scOpcodeClass opcodeClass = (scOpcodeClass) c;
+
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", scGetOpcodeClassName(opcodeClass));
+
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu samples", (unsigned long long) profile.classSamples[c]);
+
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.1f cycles", profile.GetAverageCycles(opcodeClass));
+                }
+
+                ImGui::EndTable();
+            }
+
+            // The loaded program annotated with how often each instruction ran
+            const scModuleRef& profiledProgram = vm.GetProgram();
+
+            if (profiledProgram != nullptr && ImGui::BeginTable("Listing", 4, ImGuiTableFlags_RowBg)) {
+                scSpan<const scInstruction> instructions = profiledProgram->GetInstructions();
+
+                for (size_t i = 0; i < instructions.size(); i++) {
+                    uint64_t count = i < profile.instructionCounts.size() ? profile.instructionCounts[i] : 0;
+
+                    ImGui::TableNextColumn();
+                    ImGui::Text("0x%04x", instructions[i].offset);
+
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", scGetOpcodeName(instructions[i].opcode));
+
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", (unsigned long long) count);
+
+                    ImGui::TableNextColumn();
+                    ImGui::ProgressBar(total > 0 ? (float) count / (float) total : 0.0F, ImVec2(-FLT_MIN, 0));
+                }
+
+                ImGui::EndTable();
+            }
+        }
+
+        ImGui::End();
+
         //
         // Surface GUI
         //
@@ -467,15 +611,35 @@ int main(int argc, char* argv[]) {
         ImGui::InputInt("Width", &newSurfaceWidth);
         ImGui::InputInt("Height", &newSurfaceHeight);
 
-        if (ImGui::Button("Update")) {
-            SDL_DestroyTexture(pSurfaceTex);
+        bool recreateSurface = false;
 
+        if (ImGui::Button("Update")) {
             curSurfaceWidth = newSurfaceWidth;
             curSurfaceHeight = newSurfaceHeight;
 
+            recreateSurface = true;
+        }
+
+        {
+            const char* surfaceFormats[] = { "ARGB8888", "ARGB8888 sRGB", "RGBA8", "RGBA8 sRGB" };
+            const scPixelFormat surfaceFormatValues[] = { scPixelFormat::ARGB8888, scPixelFormat::ARGB8888Srgb, scPixelFormat::RGBA8, scPixelFormat::RGBA8Srgb };
+
+            int surfaceFormatIndex = (int) (std::find(std::begin(surfaceFormatValues), std::end(surfaceFormatValues), surfaceFormat) - std::begin(surfaceFormatValues));
+
+            if (ImGui::Combo("Format", &surfaceFormatIndex, surfaceFormats, IM_ARRAYSIZE(surfaceFormats))) {
+                surfaceFormat = surfaceFormatValues[surfaceFormatIndex];
+                recreateSurface = true;
+            }
+        }
+
+        if (recreateSurface) {
+            progressiveRenderer.Stop();
+
+            SDL_DestroyTexture(pSurfaceTex);
+
             pSurfaceTex = SDL_CreateTexture(
                 pRenderer,
-                SDL_PIXELFORMAT_ARGB8888,
+                GetSurfaceTextureFormat(surfaceFormat),
                 SDL_TEXTUREACCESS_STREAMING,
                 curSurfaceWidth,
                 curSurfaceHeight
@@ -504,68 +668,4 @@ int main(int argc, char* argv[]) {
     }
 
     return 0;
-
-    /*
-    scAssembler assembler;
-
-    scAssembledProgram program;
-    scAssemblerState state = assembler.CompileSourceFile("./asm/circular_uvs.scsa", program);
-
-    if (state != scAssemblerState::OK) {
-        return 1;
-    }
-
-    program.WriteToFile("test.scsm");
-
-    scModule module;
-
-    module.LoadFromFile("test.scsm");
-
-    const int WIDTH = 64;
-    const int HEIGHT = 64;
-
-    std::vector<char> bytes;
-    bytes.resize(WIDTH * HEIGHT * 3);
-
-    scVM<512> vm;
-
-    // Tell the VM about our pixel info
-    vm.Poke<float>(sizeof(int) * 2, WIDTH - 1);
-    vm.Poke<float>(sizeof(int) * 3, HEIGHT - 1);
-
-    std::cout << "[SCHISM] Executing test.scsm | " << WIDTH << "x" << HEIGHT << std::endl;
-
-    auto start = std::chrono::high_resolution_clock::now();
-
-    // For each pixel, we will execute the virtual machine, starting anew each time
-    for (int y = 0; y < HEIGHT; y++) {
-        for (int x = 0; x < WIDTH; x++) {
-            int stride = (y * WIDTH * 3) + (x * 3);
-
-            vm.Poke<float>(0, x);
-            vm.Poke<float>(sizeof(int), y);
-
-            vm.ResetRegisters();
-            vm.ExecuteModule(module);
-
-            bytes[stride] = vm.GetRegister(scRegister::FB0).f32;
-            bytes[stride + 1] = vm.GetRegister(scRegister::FB1).f32;
-            bytes[stride + 2] = vm.GetRegister(scRegister::FB2).f32;
-        }
-    }
-
-    auto end = std::chrono::high_resolution_clock::now();
-    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-
-    std::cout << "[SCHISM] Test.scsm took " << millis.count() << "ms (" << micros.count() << "us) to execute" << std::endl;
-
-    stbi_write_jpg("./test.jpg", WIDTH, HEIGHT, 3, bytes.data(), 100);
-
-    //std::cout.flush();
-    return 0;
-
-    //vm.PrintStack();
-    //vm.PrintRegisters();
-     */
 }
@@ -0,0 +1,531 @@
+//====================================================================================
+// BSD 3-Clause License
+//
+// Copyright (c) 2024, Liam Reese
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//====================================================================================
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#include <chrono>
+#include <string>
+#include <memory>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include <schism/sc_assembler.hpp>
+#include <schism/sc_compile_cache.hpp>
+#include <schism/sc_module.hpp>
+#include <schism/sc_renderer.hpp>
+#include <schism/sc_band_renderer.hpp>
+#include <schism/sc_texture.hpp>
+#include <schism/sc_worker_pool.hpp>
+
+struct scRenderArguments {
+    std::string inputPath;
+    std::string outputPath;
+    std::string cacheDirectory;
+
+    // Bound to slots 0 onwards in order
+    std::vector<std::string> texturePaths;
+
+    int width = 0;
+    int height = 0;
+
+    int threads = 0;
+    int frames = 1;
+
+    // Rows per band when streaming, 0 keeps the whole image in memory
+    int streamRows = 0;
+
+    // Pixel format of .raw output, PPM and PFM always use RGBA8 and RGBA32F
+    scPixelFormat rawFormat = scPixelFormat::RGBA8;
+
+    scRenderBackend backend = scRenderBackend::Wide;
+    scDispatchMode dispatchMode = scDispatchMode::SCHISM_DEFAULT_DISPATCH;
+
+    bool optimize = false;
+    bool hoistUniforms = true;
+};
+
+void PrintUsage() {
+    std::printf(
+        "usage: schism_render <input.scsa | input.scsm> <width> <height> [options]\n"
+        "\n"
+        "  -o <path>            writes the image, .ppm (8 bit), .pfm (32 bit float) or .raw (rows without a header)\n"
+        "  -t <threads>         worker threads including the main thread, 0 uses every hardware thread\n"
+        "  -f <frames>          renders the image this many times, timings are averaged\n"
+        "  --backend <name>     wide or scalar\n"
+        "  --dispatch <name>    switch, threaded, tailcall or jit, used by the scalar backend\n"
+        "  --optimize           runs scOptimizer on .scsa input\n"
+        "  --no-hoist           disables uniform hoisting\n"
+        "  --cache <dir>        keeps assembled .scsa input in dir and maps it from there on later runs\n"
+        "  --format <name>      pixel format of .raw output, RGBA8, ARGB8888, RGB10A2, RGBA8Srgb, ARGB8888Srgb or RGBA32F\n"
+        "  --stream <rows>      renders bands of this many rows and writes each while the next renders, renders one frame\n"
+        "  --texture <path>     binds a .ppm or .pfm image to the next texture slot, can be given up to 8 times\n"
+    );
+}
+
+bool EndsWith(const std::string& str, const char* pSuffix) {
+    size_t len = std::strlen(pSuffix);
+    return str.size() >= len && str.compare(str.size() - len, len, pSuffix) == 0;
+}
+
+bool ParseArguments(int argc, char* argv[], scRenderArguments& outArguments) {
+    std::vector<std::string> positional;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        bool hasValue = a + 1 < argc;
+
+        if (arg == "-o" && hasValue) {
+            outArguments.outputPath = argv[++a];
+        } else if (arg == "-t" && hasValue) {
+            outArguments.threads = std::atoi(argv[++a]);
+        } else if (arg == "-f" && hasValue) {
+            outArguments.frames = std::max(1, std::atoi(argv[++a]));
+        } else if (arg == "--backend" && hasValue) {
+            std::string name = argv[++a];
+
+            if (name == "wide")
+                outArguments.backend = scRenderBackend::Wide;
+            else if (name == "scalar")
+                outArguments.backend = scRenderBackend::Scalar;
+            else
+                return false;
+        } else if (arg == "--dispatch" && hasValue) {
+            std::string name = argv[++a];
+
+            if (name == "switch")
+                outArguments.dispatchMode = scDispatchMode::Switch;
+            else if (name == "threaded")
+                outArguments.dispatchMode = scDispatchMode::Threaded;
+            else if (name == "tailcall")
+                outArguments.dispatchMode = scDispatchMode::TailCall;
+            else if (name == "jit")
+                outArguments.dispatchMode = scDispatchMode::Jit;
+            else
+                return false;
+        } else if (arg == "--optimize") {
+            outArguments.optimize = true;
+        } else if (arg == "--no-hoist") {
+            outArguments.hoistUniforms = false;
+        } else if (arg == "--cache" && hasValue) {
+            outArguments.cacheDirectory = argv[++a];
+        } else if (arg == "--format" && hasValue) {
+            std::string name = argv[++a];
+            int f = 0;
+
+            while (f < (int)scPixelFormat::FORMAT_COUNT && name != scGetPixelFormatName((scPixelFormat)f))
+                f++;
+
+            if (f == (int)scPixelFormat::FORMAT_COUNT)
+                return false;
+
+            outArguments.rawFormat = (scPixelFormat)f;
+        } else if (arg == "--stream" && hasValue) {
+            outArguments.streamRows = std::max(1, std::atoi(argv[++a]));
+        } else if (arg == "--texture" && hasValue) {
+            if (outArguments.texturePaths.size() == SC_TEXTURE_SLOT_COUNT)
+                return false;
+
+            outArguments.texturePaths.push_back(argv[++a]);
+        } else if (!arg.empty() && arg[0] == '-') {
+            return false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 3)
+        return false;
+
+    outArguments.inputPath = positional[0];
+    outArguments.width = std::atoi(positional[1].c_str());
+    outArguments.height = std::atoi(positional[2].c_str());
+
+    return outArguments.width > 0 && outArguments.height > 0;
+}
+
+bool LoadModule(const scRenderArguments& arguments, scModule& outModule) {
+    if (EndsWith(arguments.inputPath, ".scsm")) {
+        scModuleState state = outModule.LoadFromFile(arguments.inputPath);
+
+        if (state != scModuleState::OK) {
+            std::fprintf(stderr, "[schism_render]: Failed to load module (%s)\n", arguments.inputPath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    scAssembler assembler;
+
+    if (arguments.optimize)
+        assembler.SetOptimizer(scOptimizerOptions {});
+
+    if (!arguments.cacheDirectory.empty())
+        assembler.SetCache(std::make_shared<const scCompileCache>(arguments.cacheDirectory));
+
+    if (assembler.CompileSourceFile(arguments.inputPath, outModule) != scAssemblerState::OK) {
+        std::fprintf(stderr, "[schism_render]: Failed to assemble (%s)\n", arguments.inputPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Reads a whitespace separated header token of a PPM / PFM file, skipping comments
+bool ReadHeaderToken(std::istream& file, std::string& outToken) {
+    outToken.clear();
+
+    int ch = file.get();
+
+    while (ch != EOF && (std::isspace(ch) || ch == '#')) {
+        if (ch == '#') {
+            while (ch != EOF && ch != '\n')
+                ch = file.get();
+        }
+
+        ch = file.get();
+    }
+
+    while (ch != EOF && !std::isspace(ch)) {
+        outToken.push_back((char)ch);
+        ch = file.get();
+    }
+
+    // The single whitespace character after the last token is consumed with it, the data starts right after
+    return !outToken.empty();
+}
+
+// Loads a binary 8 bit PPM or an RGB PFM as a mipmapped texture, alpha is 1
+bool LoadTexture(const std::string& path, scWorkerPool& pool, scTexture& outTexture) {
+    std::ifstream file(path, std::ifstream::binary);
+
+    std::string magic, widthToken, heightToken, rangeToken;
+
+    if (!ReadHeaderToken(file, magic) || !ReadHeaderToken(file, widthToken) || !ReadHeaderToken(file, heightToken) || !ReadHeaderToken(file, rangeToken))
+        return false;
+
+    bool pfm = magic == "PF";
+
+    if (!pfm && magic != "P6")
+        return false;
+
+    int width = std::atoi(widthToken.c_str());
+    int height = std::atoi(heightToken.c_str());
+
+    if (width <= 0 || height <= 0 || width > SC_TEXTURE_MAX_SIZE || height > SC_TEXTURE_MAX_SIZE)
+        return false;
+
+    // PFM stores rows bottom to top, a negative scale means little endian which is all that is supported
+    if (pfm && std::atof(rangeToken.c_str()) >= 0)
+        return false;
+
+    if (!pfm && std::atoi(rangeToken.c_str()) != 255)
+        return false;
+
+    size_t channelSize = pfm ? sizeof(float) : 1;
+    std::vector<uint8_t> row((size_t)width * 3 * channelSize);
+    std::vector<float> texels((size_t)width * height * 4);
+
+    for (int r = 0; r < height; r++) {
+        if (!file.read(reinterpret_cast<char*>(row.data()), row.size()))
+            return false;
+
+        float* pTexels = texels.data() + (size_t)(pfm ? height - 1 - r : r) * width * 4;
+
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                if (pfm)
+                    std::memcpy(&pTexels[x * 4 + c], row.data() + (x * 3 + c) * sizeof(float), sizeof(float));
+                else
+                    pTexels[x * 4 + c] = row[x * 3 + c] / 255.0f;
+            }
+
+            pTexels[x * 4 + 3] = 1.0f;
+        }
+    }
+
+    return outTexture.Create(width, height, texels.data(), (size_t)width * 4 * sizeof(float), true, &pool);
+}
+
+// Instructions a single invocation runs, everything up to the first EXIT or DISCARD. Returns 0 when branches or
+// conditional discards make the count depend on the pixel
+uint64_t CountInvocationInstructions(const scModule& module) {
+    uint64_t count = 0;
+
+    for (const scInstruction& instruction : module.GetInstructions()) {
+        if (scIsBranchOpcode(instruction.opcode) || instruction.opcode == scOpcode::DiscardNotZero)
+            return 0;
+
+        if (instruction.opcode == scOpcode::Exit || instruction.opcode == scOpcode::Discard)
+            break;
+
+        count++;
+    }
+
+    return count;
+}
+
+enum class scImageFormat {
+    PPM,
+    PFM,
+    Raw
+};
+
+// Writes an image a band of rows at a time, rows have to be handed over in the order the format stores them
+//   - PPM is binary with alpha dropped
+//   - PFM is little endian with alpha dropped, rows are stored bottom to top
+//   - Raw is the rows as rendered, without a header
+class scImageWriter {
+protected:
+    std::ofstream _file;
+    scImageFormat _format;
+    scPixelFormat _pixelFormat;
+
+    int _width;
+    std::vector<uint8_t> _row;
+
+public:
+    scImageWriter(const std::string& path, scImageFormat format, scPixelFormat pixelFormat, int width, int height)
+        : _file(path, std::ofstream::binary), _format(format), _pixelFormat(pixelFormat), _width(width) {
+        if (format == scImageFormat::PPM) {
+            _file << "P6\n" << width << " " << height << "\n255\n";
+            _row.resize((size_t)width * 3);
+        } else if (format == scImageFormat::PFM) {
+            _file << "PF\n" << width << " " << height << "\n-1.0\n";
+            _row.resize((size_t)width * 3 * sizeof(float));
+        }
+    }
+
+    // Writes rows [y0, y1) of a band whose first row is y0, PFM writes them last to first
+    bool WriteBand(int y0, int y1, const uint8_t* pPixels, size_t pitch) {
+        int rows = y1 - y0;
+
+        for (int r = 0; r < rows; r++) {
+            int row = _format == scImageFormat::PFM ? rows - 1 - r : r;
+            WriteRow(pPixels + (size_t)row * pitch);
+        }
+
+        return _file.good();
+    }
+
+    [[nodiscard]]
+    bool IsGood() const {
+        return _file.good();
+    }
+
+protected:
+    void WriteRow(const uint8_t* pRow) {
+        if (_format == scImageFormat::Raw) {
+            _file.write(reinterpret_cast<const char*>(pRow), (size_t)_width * scGetPixelSize(_pixelFormat));
+            return;
+        }
+
+        size_t channelSize = _format == scImageFormat::PFM ? sizeof(float) : 1;
+
+        for (int x = 0; x < _width; x++)
+            std::memcpy(_row.data() + x * 3 * channelSize, pRow + x * 4 * channelSize, 3 * channelSize);
+
+        _file.write(reinterpret_cast<const char*>(_row.data()), _row.size());
+    }
+};
+
+int main(int argc, char* argv[]) {
+    scRenderArguments arguments;
+
+    if (!ParseArguments(argc, argv, arguments)) {
+        PrintUsage();
+        return 1;
+    }
+
+    scImageFormat imageFormat = scImageFormat::PPM;
+
+    if (EndsWith(arguments.outputPath, ".pfm")) {
+        imageFormat = scImageFormat::PFM;
+    } else if (EndsWith(arguments.outputPath, ".raw")) {
+        imageFormat = scImageFormat::Raw;
+    } else if (!arguments.outputPath.empty() && !EndsWith(arguments.outputPath, ".ppm")) {
+        std::fprintf(stderr, "[schism_render]: Unknown output format (%s)\n", arguments.outputPath.c_str());
+        return 1;
+    }
+
+    scModule module;
+
+    if (!LoadModule(arguments, module))
+        return 1;
+
+    scVerifierResult verifierResult = module.Verify();
+
+    if (verifierResult.state != scVerifierState::OK) {
+        std::fprintf(
+            stderr,
+            "[schism_render]: Verification failed (%s at 0x%x), loads stay bound checked\n",
+            scGetVerifierStateName(verifierResult.state),
+            verifierResult.offset
+        );
+    }
+
+    scRenderer renderer(arguments.threads);
+
+    renderer.SetBackend(arguments.backend);
+    renderer.SetUniformHoisting(arguments.hoistUniforms);
+
+    scDispatchMode dispatchMode = renderer.SetDispatchMode(arguments.dispatchMode);
+
+    if (module.GetType() != scModuleType::Fragment) {
+        std::fprintf(stderr, "[schism_render]: Only fragment modules can be rendered\n");
+        return 1;
+    }
+
+    if (!renderer.LoadProgram(scShareModule(module))) {
+        std::fprintf(stderr, "[schism_render]: The module needs %llu bytes of memory\n", (unsigned long long)module.GetRequiredMemory());
+        return 1;
+    }
+
+    std::vector<std::shared_ptr<scTexture>> textures;
+
+    if (!arguments.texturePaths.empty()) {
+        // Only used to build the mip chains
+        scWorkerPool texturePool(arguments.threads);
+
+        for (const std::string& path : arguments.texturePaths) {
+            std::shared_ptr<scTexture> texture = std::make_shared<scTexture>();
+
+            if (!LoadTexture(path, texturePool, *texture)) {
+                std::fprintf(stderr, "[schism_render]: Failed to load texture (%s)\n", path.c_str());
+                return 1;
+            }
+
+            renderer.BindTexture((int)textures.size(), texture);
+            textures.push_back(std::move(texture));
+        }
+    }
+
+    int width = arguments.width;
+    int height = arguments.height;
+
+    scPixelFormat format = scPixelFormat::RGBA8;
+
+    if (imageFormat == scImageFormat::PFM)
+        format = scPixelFormat::RGBA32F;
+    else if (imageFormat == scImageFormat::Raw)
+        format = arguments.rawFormat;
+    size_t pitch = (size_t)width * scGetPixelSize(format);
+
+    std::unique_ptr<scImageWriter> writer;
+
+    if (!arguments.outputPath.empty())
+        writer = std::make_unique<scImageWriter>(arguments.outputPath, imageFormat, format, width, height);
+
+    if (writer != nullptr && !writer->IsGood()) {
+        std::fprintf(stderr, "[schism_render]: Failed to open (%s)\n", arguments.outputPath.c_str());
+        return 1;
+    }
+
+    double totalSeconds = 0;
+    double bestSeconds = 0;
+
+    bool written = true;
+
+    if (arguments.streamRows > 0) {
+        // Only a few bands are ever alive, so a single frame is rendered and writing is part of its time
+        arguments.frames = 1;
+
+        scBandRenderer bandRenderer(renderer);
+        bandRenderer.SetBandHeight(arguments.streamRows);
+
+        auto sink = [&](int y0, int y1, const uint8_t* pPixels, size_t bandPitch) {
+            return writer == nullptr || writer->WriteBand(y0, y1, pPixels, bandPitch);
+        };
+
+        auto start = std::chrono::steady_clock::now();
+
+        written = bandRenderer.Render(width, height, format, sink, imageFormat == scImageFormat::PFM);
+
+        totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bestSeconds = totalSeconds;
+    } else {
+        std::vector<uint8_t> pixels((size_t)height * pitch);
+
+        for (int f = 0; f < arguments.frames; f++) {
+            auto start = std::chrono::steady_clock::now();
+
+            renderer.Render(width, height, pixels.data(), pitch, format);
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            totalSeconds += seconds;
+
+            if (f == 0 || seconds < bestSeconds)
+                bestSeconds = seconds;
+        }
+
+        if (writer != nullptr)
+            written = writer->WriteBand(0, height, pixels.data(), pitch);
+    }
+
+    double frameSeconds = totalSeconds / arguments.frames;
+    double pixelCount = (double)width * height;
+
+    // Counted as if every invocation ran the whole program, hoisted instructions are included
+    double instructionCount = pixelCount * (double)CountInvocationInstructions(module);
+
+    std::printf("input         %s\n", arguments.inputPath.c_str());
+    std::printf("resolution    %dx%d\n", width, height);
+    std::printf("threads       %d\n", renderer.GetThreadCount());
+    std::printf("backend       %s\n", arguments.backend == scRenderBackend::Wide ? "Wide" : "Scalar");
+    std::printf("dispatch      %s\n", scGetDispatchModeName(dispatchMode));
+    std::printf("format        %s\n", scGetPixelFormatName(format));
+
+    for (size_t t = 0; t < textures.size(); t++)
+        std::printf("texture %zu     %s (%dx%d, %d levels)\n", t, arguments.texturePaths[t].c_str(), textures[t]->GetWidth(), textures[t]->GetHeight(), textures[t]->GetLevelCount());
+    std::printf("frames        %d\n", arguments.frames);
+
+    if (arguments.streamRows > 0)
+        std::printf("streaming     %d row bands\n", arguments.streamRows);
+
+    std::printf("wall time     %.3f ms (best %.3f ms)\n", frameSeconds * 1000.0, bestSeconds * 1000.0);
+    std::printf("pixels/s      %.0f\n", pixelCount / frameSeconds);
+
+    if (instructionCount > 0)
+        std::printf("instr/s       %.0f\n", instructionCount / frameSeconds);
+    else
+        std::printf("instr/s       n/a (data dependent control flow)\n");
+
+    if (!written) {
+        std::fprintf(stderr, "[schism_render]: Failed to write (%s)\n", arguments.outputPath.c_str());
+        return 1;
+    }
+
+    return 0;
+}